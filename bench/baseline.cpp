@@ -0,0 +1,127 @@
+/*!
+ * @file 		baseline.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		24.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "baseline.h"
+#include "bench_common.h"
+#include "Statistics.h"
+#include <unistd.h>
+
+namespace CAVE {
+namespace bench {
+
+namespace {
+struct reference_t {
+	size_t count	= 0;
+	double mean		= 0.0;
+	double stddev	= 0.0;
+};
+
+//! Baselines are per machine, so the host name is part of the file name
+std::string baseline_path(const std::string& dir, const std::string& name)
+{
+	char host[256] = {0};
+	gethostname(host, sizeof(host) - 1);
+	return dir + "/" + host + "-" + name + ".baseline";
+}
+
+std::map<std::string, reference_t> load(const std::string& path)
+{
+	std::map<std::string, reference_t> references;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line)) {
+		const size_t tab = line.find('\t');
+		if (line.empty() || line[0] == '#' || tab == std::string::npos) continue;
+		std::istringstream is(line.substr(tab + 1));
+		reference_t reference;
+		if (is >> reference.count >> reference.mean >> reference.stddev) {
+			references[line.substr(0, tab)] = reference;
+		}
+	}
+	return references;
+}
+
+bool store(const std::string& path, const measurements_t& results)
+{
+	std::ofstream file(path);
+	file << "# metric\truns mean stddev\n" << std::setprecision(9);
+	for (const auto& result: results) {
+		file << result.first << "\t" << result.second.size() << " "
+				<< mean(result.second) << " " << stddev(result.second) << "\n";
+	}
+	if (!file) {
+		std::cerr << "Failed to write baseline " << path << "\n";
+		return false;
+	}
+	std::cerr << "Baseline stored to " << path << "\n";
+	return true;
+}
+}
+
+bool parse_gate_option(const std::string& arg, gate_options_t& options)
+{
+	std::string value;
+	if (match_option(arg, "--runs", value)) options.runs = std::max<size_t>(1, std::stoul(value));
+	else if (match_option(arg, "--baseline-dir", value)) options.baseline_dir = value;
+	else if (arg == "--update-baseline") options.update = true;
+	else if (match_option(arg, "--threshold", value)) options.threshold = std::stod(value);
+	else if (match_option(arg, "--confidence", value)) options.confidence = std::stod(value);
+	else return false;
+	return true;
+}
+
+gate_result_t check_baseline(const std::string& name, const measurements_t& results, const gate_options_t& options)
+{
+	if (options.baseline_dir.empty()) return gate_result_t::passed;
+	const std::string path = baseline_path(options.baseline_dir, name);
+	if (options.update) return store(path, results) ? gate_result_t::passed : gate_result_t::failed;
+
+	const auto references = load(path);
+	if (references.empty()) {
+		std::cerr << "No baseline in " << path << ", run with --update-baseline first\n";
+		return gate_result_t::skipped;
+	}
+	if (options.runs < 2) {
+		std::cerr << "Single run can't be tested for significance, use --runs\n";
+		return gate_result_t::skipped;
+	}
+
+	bool passed = true;
+	std::cerr << std::fixed << std::setprecision(4);
+	for (const auto& result: results) {
+		const auto it = references.find(result.first);
+		if (it == references.end()) {
+			std::cerr << "  NEW        " << result.first << "\n";
+			continue;
+		}
+		const reference_t& reference = it->second;
+		const double current = mean(result.second);
+		const double change = reference.mean > 0.0 ? current / reference.mean - 1.0 : 0.0;
+		const t_test_t test = welch_t_test(reference.mean, reference.stddev, reference.count,
+				current, stddev(result.second), result.second.size(), options.confidence);
+		const bool regression = change > options.threshold && test.greater;
+		const bool improvement = change < -options.threshold && test.less;
+		if (regression) passed = false;
+		std::cerr << (regression ? "  REGRESSION " : improvement ? "  FASTER     " : "  ok         ")
+				<< result.first << ": " << reference.mean << " -> " << current
+				<< " +- " << confidence_interval(result.second, options.confidence)
+				<< " (" << std::showpos << change * 100.0 << std::noshowpos << " %, t = " << test.t << ")\n";
+	}
+	std::cerr << std::defaultfloat;
+	return passed ? gate_result_t::passed : gate_result_t::failed;
+}
+
+int exit_code(bool written, gate_result_t result)
+{
+	if (!written || result == gate_result_t::failed) return 1;
+	return result == gate_result_t::skipped ? skipped_exit_code : 0;
+}
+
+}
+}
@@ -0,0 +1,76 @@
+/*!
+ * @file 		baseline.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		24.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef BASELINE_H_
+#define BASELINE_H_
+#include <string>
+#include <vector>
+#include <map>
+
+namespace CAVE {
+namespace bench {
+
+/*!
+ * Settings of the regression gate, shared by all benchmarks.
+ */
+struct gate_options_t {
+	//! Number of repetitions of every measurement
+	size_t runs				= 1;
+	//! Directory with per-machine baselines, gating is disabled when empty
+	std::string baseline_dir;
+	//! Store the results as the new baseline instead of comparing
+	bool update				= false;
+	//! Relative slowdown that is still tolerated
+	double threshold		= 0.05;
+	//! Confidence level of the significance test
+	double confidence		= 0.99;
+};
+
+/*!
+ * Parses options --runs, --baseline-dir, --update-baseline,
+ * --threshold and --confidence.
+ * @return true if @em arg was one of them
+ */
+bool parse_gate_option(const std::string& arg, gate_options_t& options);
+
+//! Measured values of one metric, one value per run
+typedef std::map<std::string, std::vector<double>> measurements_t;
+
+enum class gate_result_t {
+	passed,
+	//! Some metric regressed (or the baseline couldn't be stored)
+	failed,
+	//! There is no baseline or too few runs to test the significance
+	skipped
+};
+
+//! Exit code of a benchmark skipped by the gate (SKIP_RETURN_CODE of the CTest tests)
+const int skipped_exit_code = 77;
+
+/*!
+ * Compares @em results with the stored baseline of benchmark @em name
+ * (or stores them, when updating).
+ *
+ * A metric fails when it is slower by more than the threshold and the
+ * difference is statistically significant (Welch's t-test), so noisy
+ * machines need more runs, not larger thresholds.
+ * Without a baseline directory the gate is disabled and always passes.
+ */
+gate_result_t check_baseline(const std::string& name, const measurements_t& results, const gate_options_t& options);
+
+//! Exit code of a benchmark, 1 if the output couldn't be written or the gate failed
+int exit_code(bool written, gate_result_t result);
+
+}
+}
+
+
+
+#endif /* BASELINE_H_ */
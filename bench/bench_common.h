@@ -0,0 +1,165 @@
+/*!
+ * @file 		bench_common.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		10.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef BENCH_COMMON_H_
+#define BENCH_COMMON_H_
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <utility>
+#include "Scene.h"
+
+namespace CAVE {
+namespace bench {
+
+typedef std::chrono::steady_clock bench_clock;
+
+inline double seconds_since(const bench_clock::time_point& start)
+{
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+//! Time step used to bring the scenes to steady state
+const float warmup_time_delta = 0.1f;
+
+//! Spawn rate giving a steady population of @em population particles
+inline size_t rate_for_population(size_t population)
+{
+	return static_cast<size_t>(population / Particle::default_life);
+}
+
+/*!
+ * Simulates the scene until its population is stable
+ */
+inline void warm_up(Scene& scene)
+{
+	for (float t = 0.0f; t < Particle::default_life + 1.0f; t += warmup_time_delta) {
+		scene.update(warmup_time_delta);
+	}
+}
+
+/*!
+ * Checks whether @em arg is option @em name (in form --name=value)
+ * and stores the value.
+ */
+inline bool match_option(const std::string& arg, const std::string& name, std::string& value)
+{
+	const std::string prefix = name + "=";
+	if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+	value = arg.substr(prefix.size());
+	return true;
+}
+
+inline std::vector<std::string> split(const std::string& text, char separator = ',')
+{
+	std::vector<std::string> parts;
+	std::istringstream is(text);
+	std::string part;
+	while (std::getline(is, part, separator)) {
+		if (!part.empty()) parts.push_back(part);
+	}
+	return parts;
+}
+
+template<typename T>
+std::vector<T> parse_list(const std::string& text)
+{
+	std::vector<T> values;
+	for (const auto& part: split(text)) {
+		std::istringstream is(part);
+		T value;
+		if (is >> value) values.push_back(value);
+	}
+	return values;
+}
+
+inline std::string json_escape(const std::string& text)
+{
+	std::string out;
+	for (char c: text) {
+		if (c == '"' || c == '\\') out += '\\';
+		if (static_cast<unsigned char>(c) < 0x20) continue;
+		out += c;
+	}
+	return out;
+}
+
+/*!
+ * One flat JSON object. Values are formatted when added, so the order of keys is preserved.
+ */
+class json_record {
+public:
+	json_record& add(const std::string& key, const std::string& value)
+	{
+		fields_.emplace_back(key, "\"" + json_escape(value) + "\"");
+		return *this;
+	}
+	json_record& add(const std::string& key, const char* value)
+	{
+		return add(key, std::string(value));
+	}
+	template<typename T>
+	json_record& add(const std::string& key, const T& value)
+	{
+		std::ostringstream os;
+		os << std::setprecision(9) << value;
+		fields_.emplace_back(key, os.str());
+		return *this;
+	}
+	std::string str() const
+	{
+		std::string out = "{";
+		for (size_t i = 0; i < fields_.size(); ++i) {
+			if (i) out += ", ";
+			out += "\"" + json_escape(fields_[i].first) + "\": " + fields_[i].second;
+		}
+		return out + "}";
+	}
+private:
+	std::vector<std::pair<std::string, std::string>> fields_;
+};
+
+/*!
+ * Writes @em header with an additional key "results" containing all @em records.
+ * @param output Path to the output file, standard output is used when empty
+ */
+inline bool write_json(const std::string& output, const json_record& header, const std::vector<json_record>& records)
+{
+	std::ostringstream os;
+	std::string head = header.str();
+	head.erase(head.size() - 1);
+	os << head << (head.size() > 1 ? ", " : "") << "\"results\": [\n";
+	for (size_t i = 0; i < records.size(); ++i) {
+		os << "  " << records[i].str() << (i + 1 < records.size() ? ",\n" : "\n");
+	}
+	os << "]}\n";
+	if (output.empty()) {
+		std::cout << os.str();
+		return true;
+	}
+	std::ofstream file(output);
+	file << os.str();
+	if (!file) {
+		std::cerr << "Failed to write " << output << "\n";
+		return false;
+	}
+	return true;
+}
+
+}
+}
+
+
+
+#endif /* BENCH_COMMON_H_ */
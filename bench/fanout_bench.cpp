@@ -0,0 +1,155 @@
+/*!
+ * @file 		fanout_bench.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		16.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ * Distribution of the per-frame state to the nodes of a cluster (RelayTree).
+ *
+ * Every node runs in a thread and gets the state over LocalTransport, the master
+ * then waits in a barrier for all the nodes, as in CAVEDisplayBarrier. Fan-out 0
+ * is the direct distribution (as CAVEDistribWrite), the others use relays.
+ * Reports time the master spends sending, time of the whole frame sync
+ * and the delivery latencies (for every node with --per-node).
+ *
+ * Usage: fanout_bench [--nodes=4,16,64] [--fanouts=0,2,4,8] [--frames=300]
+ *                     [--link-us=50] [--bytes=128] [--per-node] [--output=file.json]
+ */
+
+#include "bench_common.h"
+#include "RelayTree.h"
+#include "Statistics.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace CAVE;
+using namespace CAVE::bench;
+
+namespace {
+
+class barrier_t {
+public:
+	explicit barrier_t(size_t count): count_(count), waiting_(0), generation_(0) {}
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		const size_t generation = generation_;
+		if (++waiting_ == count_) {
+			waiting_ = 0;
+			++generation_;
+			released_.notify_all();
+			return;
+		}
+		released_.wait(lock, [this, generation](){return generation_ != generation;});
+	}
+private:
+	std::mutex mutex_;
+	std::condition_variable released_;
+	const size_t count_;
+	size_t waiting_;
+	size_t generation_;
+};
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<size_t> node_counts = {4, 16, 64};
+	std::vector<size_t> fanouts = {0, 2, 4, 8};
+	size_t frames = 300;
+	double link_us = 50.0;
+	size_t bytes = 128;
+	bool per_node = false;
+	std::string output;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		std::string value;
+		if (match_option(arg, "--nodes", value)) node_counts = parse_list<size_t>(value);
+		else if (match_option(arg, "--fanouts", value)) fanouts = parse_list<size_t>(value);
+		else if (match_option(arg, "--frames", value)) frames = std::stoul(value);
+		else if (match_option(arg, "--link-us", value)) link_us = std::stod(value);
+		else if (match_option(arg, "--bytes", value)) bytes = std::stoul(value);
+		else if (match_option(arg, "--output", value)) output = value;
+		else if (arg == "--per-node") per_node = true;
+		else {
+			std::cerr << "Unknown option " << arg << "\n";
+			return 1;
+		}
+	}
+
+	std::vector<json_record> records;
+	for (size_t nodes: node_counts) {
+		for (size_t fanout: fanouts) {
+			if (fanout >= nodes) continue;
+			const RelayTree tree(nodes, fanout);
+			LocalTransport transport(nodes, link_us / 1e6);
+			barrier_t barrier(nodes);
+			std::vector<std::unique_ptr<RelayNode>> relay_nodes;
+			for (size_t node = 0; node < nodes; ++node) {
+				relay_nodes.emplace_back(new RelayNode(transport, tree, node));
+			}
+			std::vector<std::thread> threads;
+			for (size_t node = 1; node < nodes; ++node) {
+				threads.emplace_back([&, node](){
+					std::vector<char> state(bytes);
+					for (size_t frame = 0; frame < frames; ++frame) {
+						relay_nodes[node]->receive(state.data(), state.size());
+						barrier.wait();
+					}
+				});
+			}
+			std::vector<double> send_times;
+			std::vector<double> sync_times;
+			std::vector<char> state(bytes);
+			for (size_t frame = 0; frame < frames; ++frame) {
+				state[0] = static_cast<char>(frame);
+				const auto start = bench_clock::now();
+				relay_nodes[0]->send(state.data(), state.size());
+				send_times.push_back(seconds_since(start) * 1000.0);
+				barrier.wait();
+				sync_times.push_back(seconds_since(start) * 1000.0);
+			}
+			for (auto& thread: threads) {
+				thread.join();
+			}
+
+			std::vector<double> latencies;
+			double slowest = 0.0;
+			for (size_t node = 1; node < nodes; ++node) {
+				std::vector<double> node_latencies;
+				for (double latency: relay_nodes[node]->get_latencies()) {
+					node_latencies.push_back(latency * 1000.0);
+				}
+				latencies.insert(latencies.end(), node_latencies.begin(), node_latencies.end());
+				slowest = std::max(slowest, mean(node_latencies));
+				if (per_node) {
+					records.push_back(json_record()
+							.add("nodes", nodes)
+							.add("fanout", tree.get_fanout())
+							.add("node", node)
+							.add("depth", tree.depth(node))
+							.add("latency_ms", mean(node_latencies))
+							.add("latency_ms_p99", percentile(node_latencies, 99.0)));
+				}
+			}
+			records.push_back(json_record()
+					.add("nodes", nodes)
+					.add("fanout", tree.get_fanout())
+					.add("height", tree.height())
+					.add("link_us", link_us)
+					.add("bytes", bytes)
+					.add("frames", frames)
+					.add("master_send_ms", mean(send_times))
+					.add("sync_ms_median", percentile(sync_times, 50.0))
+					.add("sync_ms_p99", percentile(sync_times, 99.0))
+					.add("latency_ms", mean(latencies))
+					.add("latency_ms_p99", percentile(latencies, 99.0))
+					.add("slowest_node_latency_ms", slowest));
+			std::cerr << records.back().str() << "\n";
+		}
+	}
+
+	return write_json(output, json_record().add("benchmark", "fanout"), records) ? 0 : 1;
+}
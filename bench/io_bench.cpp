@@ -0,0 +1,148 @@
+/*!
+ * @file 		io_bench.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		21.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ * Read throughput and latency of AsyncIO.
+ *
+ * Reads the whole file in blocks, mostly as prefetch, every visible_every-th block
+ * as visible, and reports throughput and latency of both priority classes.
+ * Without --file, a temporary file of --size MB is created. Unless --direct
+ * is used, the file is most likely in the page cache after the first run.
+ *
+ * Usage: io_bench [--file=path] [--size=256] [--block=1024] [--depths=1,8,32]
+ *                 [--backends=io_uring,thread_pool] [--direct] [--output=file.json]
+ */
+
+#include "bench_common.h"
+#include "AsyncIO.h"
+#include "Statistics.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+
+using namespace CAVE;
+using namespace CAVE::bench;
+
+namespace {
+//! Every n-th block is read as visible
+const size_t visible_every = 8;
+
+bool create_file(const std::string& path, size_t size)
+{
+	const int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) return false;
+	std::vector<char> block(1 << 20);
+	for (size_t i = 0; i < block.size(); ++i) {
+		block[i] = static_cast<char>(i * 31);
+	}
+	bool written = true;
+	for (size_t offset = 0; offset < size && written; offset += block.size()) {
+		written = ::write(fd, block.data(), std::min(block.size(), size - offset)) > 0;
+	}
+	close(fd);
+	return written;
+}
+}
+
+int main(int argc, char** argv)
+{
+	std::string path;
+	size_t size_mb = 256;
+	size_t block_kb = 1024;
+	std::vector<size_t> depths = {1, 8, 32};
+	std::vector<std::string> backends = {"io_uring", "thread_pool"};
+	bool direct = false;
+	std::string output;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		std::string value;
+		if (match_option(arg, "--file", value)) path = value;
+		else if (match_option(arg, "--size", value)) size_mb = std::stoul(value);
+		else if (match_option(arg, "--block", value)) block_kb = std::stoul(value);
+		else if (match_option(arg, "--depths", value)) depths = parse_list<size_t>(value);
+		else if (match_option(arg, "--backends", value)) backends = split(value);
+		else if (match_option(arg, "--output", value)) output = value;
+		else if (arg == "--direct") direct = true;
+		else {
+			std::cerr << "Unknown option " << arg << "\n";
+			return 1;
+		}
+	}
+
+	const bool temporary = path.empty();
+	if (temporary) {
+		char name[] = "/tmp/io_bench_XXXXXX";
+		const int fd = mkstemp(name);
+		if (fd < 0) return 1;
+		close(fd);
+		path = name;
+		if (!create_file(path, size_mb << 20)) {
+			std::cerr << "Failed to create " << path << "\n";
+			unlink(path.c_str());
+			return 1;
+		}
+	}
+	const int fd = open(path.c_str(), O_RDONLY | (direct ? O_DIRECT : 0));
+	if (fd < 0) {
+		std::cerr << "Failed to open " << path << "\n";
+		return 1;
+	}
+	const off_t file_size = lseek(fd, 0, SEEK_END);
+	const size_t block = block_kb << 10;
+
+	std::vector<json_record> records;
+	for (const auto& backend: backends) {
+		for (size_t depth: depths) {
+			// Twice as many buffers as the depth, so the requests wait in the queue
+			AsyncIO io(depth, depth * 2, block, backend == "io_uring");
+			if (to_string(io.get_backend()) != backend) {
+				std::cerr << backend << " not available\n";
+				break;
+			}
+			std::vector<double> latencies[2];
+			size_t bytes = 0;
+			size_t errors = 0;
+			size_t issued = 0;
+			const auto start = bench_clock::now();
+			for (off_t offset = 0; offset < file_size || io.outstanding(); ) {
+				while (offset < file_size) {
+					io_buffer_t* buffer = io.acquire_buffer();
+					if (!buffer) break;
+					const bool visible = issued++ % visible_every == 0;
+					const auto issue_time = bench_clock::now();
+					io.read(fd, buffer, block, offset, visible ? io_priority_t::visible : io_priority_t::prefetch,
+							[&, buffer, visible, issue_time](const io_result_t& result) {
+						latencies[visible ? 0 : 1].push_back(seconds_since(issue_time) * 1000.0);
+						bytes += result.bytes;
+						if (result.error) ++errors;
+						io.release_buffer(buffer);
+					});
+					offset += block;
+				}
+				io.poll(true);
+			}
+			const double elapsed = seconds_since(start);
+
+			records.push_back(json_record()
+					.add("backend", backend)
+					.add("depth", depth)
+					.add("block_kb", block_kb)
+					.add("direct", direct ? "yes" : "no")
+					.add("mb_per_s", bytes / elapsed / (1 << 20))
+					.add("errors", errors)
+					.add("visible_latency_ms", mean(latencies[0]))
+					.add("visible_latency_ms_p99", percentile(latencies[0], 99.0))
+					.add("prefetch_latency_ms", mean(latencies[1]))
+					.add("prefetch_latency_ms_p99", percentile(latencies[1], 99.0)));
+			std::cerr << records.back().str() << "\n";
+		}
+	}
+	close(fd);
+	if (temporary) unlink(path.c_str());
+
+	return write_json(output, json_record().add("benchmark", "io"), records) ? 0 : 1;
+}
@@ -0,0 +1,275 @@
+/*!
+ * @file 		render_bench.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		10.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ * Offscreen benchmark of Scene::render.
+ *
+ * Renders the particles into a framebuffer object for every combination
+ * of particle count, render backend, vertex format and resolution.
+ * Doesn't need a GPU, on a machine without one run it as
+ *
+ *   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a render_bench --output=render.json
+ *
+ * Usage: render_bench [--counts=4000,40000] [--backends=geometry_shader,point_sprite]
+ *                     [--formats=full,compact] [--resolutions=640x480,1920x1080]
+ *                     [--upload=orphan] [--gpu-culling] [--vertex-pulling] [--overdraw]
+ *                     [--frames=100] [--output=file.json]
+ *                     [--runs=5] [--baseline-dir=dir] [--update-baseline]
+ *                     [--threshold=0.05] [--confidence=0.99]
+ *        render_bench --verify-gpu-simulation
+ *
+ * With --verify-gpu-simulation the transform feedback simulation is compared
+ * with Particle::update and the benchmark fails when it differs. Run it on
+ * the software rasterizer too, as above.
+ *
+ * With --overdraw, one more frame of every combination counts fragments per pixel
+ * (OverdrawMeter), outside of the measured frames.
+ *
+ * When the RAPL counters are readable, energy of the CPU packages per frame
+ * is reported too (the GPU is not included).
+ */
+
+#include "bench_common.h"
+#include "baseline.h"
+#include "Statistics.h"
+#include "RenderTarget.h"
+#include "EnergyMeter.h"
+#include "OverdrawMeter.h"
+#include <GL/glut.h>
+#include <GL/glu.h>
+#include <cstdio>
+#include <cctype>
+
+using namespace CAVE;
+using namespace CAVE::bench;
+
+namespace {
+const unsigned int seed = 1;
+//! Frames rendered before the measurement starts
+const size_t warmup_frames = 5;
+const point3 camera_position = {-0.5f, -0.5f, -5.0f};
+
+struct resolution_t {
+	GLsizei width;
+	GLsizei height;
+};
+
+std::string gl_string(GLenum name)
+{
+	const GLubyte* str = glGetString(name);
+	return str?reinterpret_cast<const char*>(str):"unknown";
+}
+
+//! Makes @em text usable as a part of a file name
+std::string sanitize(std::string text)
+{
+	for (auto& c: text) {
+		if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+	}
+	return text;
+}
+
+template<typename T>
+bool parse_names(const std::string& text, std::vector<T>& values)
+{
+	values.clear();
+	for (const auto& name: split(text)) {
+		T value;
+		if (!from_string(name, value)) {
+			std::cerr << "Unknown name " << name << "\n";
+			return false;
+		}
+		values.push_back(value);
+	}
+	return true;
+}
+}
+
+int main(int argc, char** argv)
+{
+	glutInit(&argc, argv);
+
+	std::vector<size_t> counts = {4000, 40000, 400000};
+	std::vector<render_backend_t> backends = {render_backend_t::geometry_shader, render_backend_t::point_sprite};
+	std::vector<vertex_format_t> formats = {vertex_format_t::full, vertex_format_t::compact};
+	std::vector<resolution_t> resolutions = {{640, 480}, {1920, 1080}};
+	upload_strategy_t upload = upload_strategy_t::orphan;
+	bool gpu_culling = false;
+	bool vertex_pulling = false;
+	bool verify_gpu = false;
+	bool overdraw = false;
+	size_t frames = 100;
+	std::string output;
+	gate_options_t gate;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		std::string value;
+		bool valid = true;
+		if (match_option(arg, "--counts", value)) counts = parse_list<size_t>(value);
+		else if (match_option(arg, "--backends", value)) valid = parse_names(value, backends);
+		else if (match_option(arg, "--formats", value)) valid = parse_names(value, formats);
+		else if (match_option(arg, "--upload", value)) valid = from_string(value, upload);
+		else if (arg == "--gpu-culling") gpu_culling = true;
+		else if (arg == "--vertex-pulling") vertex_pulling = true;
+		else if (arg == "--verify-gpu-simulation") verify_gpu = true;
+		else if (arg == "--overdraw") overdraw = true;
+		else if (match_option(arg, "--frames", value)) frames = std::stoul(value);
+		else if (match_option(arg, "--output", value)) output = value;
+		else if (parse_gate_option(arg, gate)) continue;
+		else if (match_option(arg, "--resolutions", value)) {
+			resolutions.clear();
+			for (const auto& res: split(value)) {
+				resolution_t resolution;
+				if (std::sscanf(res.c_str(), "%dx%d", &resolution.width, &resolution.height) != 2) valid = false;
+				else resolutions.push_back(resolution);
+			}
+		} else valid = false;
+		if (!valid) {
+			std::cerr << "Invalid option " << arg << "\n";
+			return 1;
+		}
+	}
+
+	// The window is used only to get a context, everything is rendered offscreen
+	glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
+	glutInitWindowSize(64, 64);
+	glutCreateWindow("render_bench");
+	glewInit();
+	if (verify_gpu) {
+		if (!GpuSimulation::supported()) {
+			std::cerr << "GPU simulation needs OpenGL 3.1\n";
+			return 1;
+		}
+		const bool passed = verify_gpu_simulation();
+		std::cout << "gpu simulation (" << gl_string(GL_RENDERER) << "): " << (passed ? "matches" : "differs") << "\n";
+		return passed ? 0 : 1;
+	}
+	if (upload == upload_strategy_t::persistent && !GLEW_ARB_buffer_storage) {
+		std::cerr << "Persistent upload not supported, results will be for subdata\n";
+	}
+	if (gpu_culling && !GLEW_VERSION_4_3) {
+		std::cerr << "GPU culling needs OpenGL 4.3, results will be without culling\n";
+	}
+	if (vertex_pulling && !GLEW_VERSION_3_1) {
+		std::cerr << "Vertex pulling needs OpenGL 3.1, results will be with vertex arrays\n";
+	}
+
+	EnergyMeter energy;
+	if (!energy.available()) std::cerr << "Energy counters (RAPL) not readable, energy won't be reported\n";
+
+	std::vector<json_record> records;
+	measurements_t measurements;
+	RenderTarget target;
+	OverdrawMeter overdraw_meter(1, false);
+	for (size_t count: counts) {
+		Scene scene(rate_for_population(count));
+		scene.set_seed(seed);
+		warm_up(scene);
+		scene.prepare_details();
+
+		for (const auto& resolution: resolutions) {
+			if (!target.resize(resolution.width, resolution.height)) return 1;
+			target.bind();
+			glMatrixMode(GL_PROJECTION);
+			glLoadIdentity();
+			gluPerspective(45.0f, static_cast<float>(resolution.width) / resolution.height, 0.1f, 100.0f);
+			glMatrixMode(GL_MODELVIEW);
+
+			for (auto backend: backends) {
+				for (auto format: formats) {
+					scene_config_t config;
+					config.upload = upload;
+					config.backend = backend;
+					config.vertex_format = format;
+					config.gpu_culling = gpu_culling;
+					config.vertex_pulling = vertex_pulling;
+					scene.set_config(config);
+
+					auto render = [&](){
+						glLoadIdentity();
+						scene.render(camera_position, 0.0f);
+					};
+					for (size_t i = 0; i < warmup_frames; ++i) render();
+					glFinish();
+					scene.reset_render_stats();
+
+					std::vector<double> frame_times;
+					std::vector<double> submit_times;
+					std::vector<double> frame_energy;
+					for (size_t run = 0; run < gate.runs; ++run) {
+						double submit_time = 0.0;
+						const double energy_start = energy.read();
+						const auto start = bench_clock::now();
+						for (size_t i = 0; i < frames; ++i) {
+							const auto frame_start = bench_clock::now();
+							render();
+							submit_time += seconds_since(frame_start);
+							glFinish();
+						}
+						frame_times.push_back(seconds_since(start) / frames * 1000.0);
+						submit_times.push_back(submit_time / frames * 1000.0);
+						frame_energy.push_back((energy.read() - energy_start) / frames);
+					}
+					const render_stats_t stats = scene.get_render_stats();
+
+					std::ostringstream key;
+					key << "particles=" << count << "/" << to_string(backend) << "/" << to_string(format)
+							<< "/" << to_string(upload) << (gpu_culling ? "/culled" : "") << (vertex_pulling ? "/pulled" : "")
+							<< "/" << resolution.width << "x" << resolution.height;
+					measurements["frame_ms/" + key.str()] = frame_times;
+					measurements["submit_ms/" + key.str()] = submit_times;
+
+					json_record record;
+					record.add("particles", scene.get_particle_count())
+							.add("backend", to_string(backend))
+							.add("vertex_format", to_string(format))
+							.add("upload", to_string(upload))
+							.add("gpu_culling", gpu_culling ? "yes" : "no")
+							.add("vertex_pulling", vertex_pulling ? "yes" : "no")
+							.add("width", resolution.width)
+							.add("height", resolution.height)
+							.add("frames", frames)
+							.add("runs", gate.runs)
+							.add("fps", 1000.0 / mean(frame_times))
+							.add("frame_ms_ci", confidence_interval(frame_times, gate.confidence))
+							.add("cpu_submit_ms", mean(submit_times))
+							.add("cpu_submit_ms_ci", confidence_interval(submit_times, gate.confidence))
+							.add("gl_calls_per_frame", static_cast<double>(stats.gl_calls) / stats.frames)
+							.add("draw_calls_per_frame", static_cast<double>(stats.draw_calls) / stats.frames)
+							.add("upload_bytes_per_frame", static_cast<double>(stats.uploaded_bytes) / stats.frames);
+					if (energy.available()) record.add("cpu_joules_per_frame", mean(frame_energy));
+					if (overdraw) {
+						overdraw_meter.reset();
+						overdraw_meter.begin_frame();
+						overdraw_meter.begin_view();
+						render();
+						overdraw_meter.end_view();
+						overdraw_meter.begin_frame();
+						const overdraw_stats_t layers = overdraw_meter.get_stats()[0];
+						record.add("overdraw_mean", layers.mean)
+								.add("overdraw_covered_mean", layers.covered_mean)
+								.add("overdraw_p99", layers.p99)
+								.add("overdraw_max", layers.max);
+					}
+					records.push_back(record);
+					std::cerr << records.back().str() << "\n";
+				}
+			}
+			target.unbind();
+		}
+		scene.release_details();
+	}
+	target.release();
+	overdraw_meter.release();
+
+	const bool written = write_json(output, json_record()
+			.add("benchmark", "render")
+			.add("renderer", gl_string(GL_RENDERER))
+			.add("version", gl_string(GL_VERSION)), records);
+	// Different renderers on the same host get their own baselines
+	return exit_code(written, check_baseline("render-" + sanitize(gl_string(GL_RENDERER)), measurements, gate));
+}
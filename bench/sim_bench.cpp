@@ -0,0 +1,178 @@
+/*!
+ * @file 		sim_bench.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		10.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ * Headless benchmark of Scene::update.
+ *
+ * Usage: sim_bench [--counts=1000,10000] [--workers=1,2,4] [--chunk=4096]
+ *                  [--steps=200] [--output=file.json] [--deterministic]
+ *                  [--runs=5] [--baseline-dir=dir] [--update-baseline]
+ *                  [--threshold=0.05] [--confidence=0.99]
+ *                  [--behaviour=file [--native-behaviour[=cache_dir]]]
+ *        sim_bench --verify-kernels
+ *
+ * With --verify-kernels all update kernels supported by the CPU are compared
+ * with Particle::update and the benchmark fails when a deterministic one differs.
+ *
+ * With --behaviour the particles are updated by the behaviour from the file,
+ * interpreted, or with --native-behaviour compiled (waits for the compiler before measuring).
+ *
+ * When the RAPL counters are readable, every record contains also energy
+ * of the CPU packages per million particle updates.
+ */
+
+#include "bench_common.h"
+#include "baseline.h"
+#include "Statistics.h"
+#include "EnergyMeter.h"
+#include "Behaviour.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <chrono>
+
+using namespace CAVE;
+using namespace CAVE::bench;
+
+namespace {
+//! Time step of the measured updates (60 fps)
+const float time_delta = 1.0f / 60.0f;
+const unsigned int seed = 1;
+
+bool verify_kernels()
+{
+	bool passed = true;
+	for (auto isa: available_kernels()) {
+		const bool identical = verify_kernel(isa);
+		std::cout << to_string(isa) << ": " << (identical ? "identical" : "differs")
+				<< (is_deterministic(isa) ? "" : " (not used in deterministic mode)") << "\n";
+		if (!identical && is_deterministic(isa)) passed = false;
+	}
+	return passed;
+}
+
+//! Polls the behaviour until its native kernel is loaded (or failed)
+void wait_for_native(Behaviour& behaviour)
+{
+	behaviour.poll();
+	while (behaviour.is_compiling()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		behaviour.poll();
+	}
+	if (!behaviour.is_native()) std::cerr << "Native behaviour not available, measuring the interpreter\n";
+}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<size_t> counts = {4000, 40000, 400000};
+	std::vector<size_t> workers = {1, std::max<size_t>(1, std::thread::hardware_concurrency())};
+	size_t chunk_size = scene_config_t().chunk_size;
+	size_t steps = 200;
+	std::string output;
+	bool deterministic = scene_config_t().deterministic;
+	gate_options_t gate;
+	std::string behaviour_file;
+	bool native_behaviour = false;
+	std::string behaviour_cache;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		std::string value;
+		if (match_option(arg, "--counts", value)) counts = parse_list<size_t>(value);
+		else if (match_option(arg, "--workers", value)) workers = parse_list<size_t>(value);
+		else if (match_option(arg, "--chunk", value)) chunk_size = std::stoul(value);
+		else if (match_option(arg, "--steps", value)) steps = std::stoul(value);
+		else if (match_option(arg, "--output", value)) output = value;
+		else if (arg == "--deterministic") deterministic = true;
+		else if (arg == "--verify-kernels") return verify_kernels() ? 0 : 1;
+		else if (match_option(arg, "--behaviour", value)) behaviour_file = value;
+		else if (match_option(arg, "--native-behaviour", value)) {
+			native_behaviour = true;
+			behaviour_cache = value;
+		}
+		else if (parse_gate_option(arg, gate)) continue;
+		else {
+			std::cerr << "Unknown option " << arg << "\n";
+			return 1;
+		}
+	}
+
+	std::shared_ptr<Behaviour> behaviour;
+	if (!behaviour_file.empty()) {
+		try {
+			behaviour = Behaviour::load(behaviour_file);
+		} catch (std::exception& e) {
+			std::cerr << e.what() << "\n";
+			return 1;
+		}
+		if (native_behaviour) {
+			behaviour->compile(behaviour_cache);
+			wait_for_native(*behaviour);
+		}
+	}
+
+	EnergyMeter energy;
+	if (!energy.available()) std::cerr << "Energy counters (RAPL) not readable, energy won't be reported\n";
+
+	std::vector<json_record> records;
+	measurements_t measurements;
+	for (size_t count: counts) {
+		for (size_t worker_count: workers) {
+			Scene scene(rate_for_population(count));
+			scene_config_t config;
+			config.workers = worker_count;
+			config.chunk_size = chunk_size;
+			config.deterministic = deterministic;
+			scene.set_config(config);
+			scene.set_seed(seed);
+			scene.set_behaviour(behaviour);
+			warm_up(scene);
+
+			std::vector<double> medians;
+			std::vector<double> per_particle;
+			std::vector<double> joules_per_million;
+			for (size_t run = 0; run < gate.runs; ++run) {
+				std::vector<double> times;
+				size_t particle_updates = 0;
+				const double energy_start = energy.read();
+				for (size_t step = 0; step < steps; ++step) {
+					particle_updates += scene.get_particle_count();
+					const auto start = bench_clock::now();
+					scene.update(time_delta);
+					times.push_back(seconds_since(start));
+				}
+				const double total = std::accumulate(times.begin(), times.end(), 0.0);
+				joules_per_million.push_back((energy.read() - energy_start) / std::max<size_t>(particle_updates, 1) * 1e6);
+				medians.push_back(percentile(times, 50.0) * 1000.0);
+				per_particle.push_back(total / std::max<size_t>(particle_updates, 1) * 1e9);
+			}
+
+			std::ostringstream key;
+			key << "update_ms/particles=" << count << "/workers=" << worker_count << "/chunk=" << chunk_size;
+			if (behaviour) key << (behaviour->is_native() ? "/native_behaviour" : "/behaviour");
+			measurements[key.str()] = medians;
+
+			json_record record;
+			record.add("particles", scene.get_particle_count())
+					.add("workers", worker_count)
+					.add("chunk_size", chunk_size)
+					.add("kernel", behaviour ? (behaviour->is_native() ? "native behaviour" : "interpreted behaviour")
+							: to_string(scene.get_kernel()))
+					.add("steps", steps)
+					.add("runs", gate.runs)
+					.add("update_ms_median", mean(medians))
+					.add("update_ms_ci", confidence_interval(medians, gate.confidence))
+					.add("ns_per_particle", mean(per_particle));
+			if (energy.available()) record.add("joules_per_million_updates", mean(joules_per_million));
+			records.push_back(record);
+			std::cerr << records.back().str() << "\n";
+		}
+	}
+
+	const bool written = write_json(output, json_record().add("benchmark", "simulation"), records);
+	return exit_code(written, check_baseline("simulation", measurements, gate));
+}
@@ -0,0 +1,262 @@
+/*!
+ * @file 		soak_bench.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		10.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ * Long-run soak test of the scene.
+ *
+ * Simulates many hours of a running installation as fast as possible.
+ * The frames get a virtual clock advancing by a fixed time step, which goes
+ * through the same FrameClock as the application. Every sample interval
+ * (of simulated time) it records resident memory, GPU memory, size of the
+ * vertex buffer and frame time percentiles. At the end a line is fitted
+ * through every series and significant growth is reported as a failure.
+ *
+ * Rendering is done offscreen to a framebuffer object every n-th frame,
+ * with --render-every=0 the test is headless and doesn't need a display.
+ *
+ * Usage: soak_bench [--hours=12] [--start-hours=0] [--fps=60] [--count=40000]
+ *                   [--sample-minutes=10] [--render-every=60] [--upload=orphan]
+ *                   [--threshold=0.1] [--confidence=0.99] [--output=file.json]
+ */
+
+#include "bench_common.h"
+#include "Statistics.h"
+#include "RenderTarget.h"
+#include "FrameClock.h"
+#include <GL/glut.h>
+#include <GL/glu.h>
+#include <unistd.h>
+#include <fstream>
+#include <cmath>
+#include <map>
+
+using namespace CAVE;
+using namespace CAVE::bench;
+
+namespace {
+const unsigned int seed = 1;
+const point3 camera_position = {-0.5f, -0.5f, -5.0f};
+const GLsizei target_width = 1280;
+const GLsizei target_height = 720;
+//! First samples are not used for the trends, the allocations are still settling there
+const size_t settle_samples = 1;
+
+//! Resident set size of the process in kB, 0 when unknown
+double resident_kb()
+{
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0;
+	size_t resident = 0;
+	if (!(statm >> pages >> resident)) return 0.0;
+	return resident * (sysconf(_SC_PAGESIZE) / 1024.0);
+}
+
+/*!
+ * Memory used on the GPU in kB, negative when the driver doesn't tell.
+ * ATI_meminfo reports only free memory, so it's relative to the first query.
+ */
+double gpu_used_kb()
+{
+	if (GLEW_NVX_gpu_memory_info) {
+		GLint total = 0;
+		GLint available = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+		return total - available;
+	}
+	if (GLEW_ATI_meminfo) {
+		static GLint initial_free = -1;
+		GLint free_memory[4] = {0, 0, 0, 0};
+		glGetIntegerv(GL_VBO_FREE_MEMORY_ATI, free_memory);
+		if (initial_free < 0) initial_free = free_memory[0];
+		return initial_free - free_memory[0];
+	}
+	return -1.0;
+}
+
+struct sample_t {
+	double hours;
+	double rss_kb;
+	double gpu_kb;
+	double buffer_kb;
+	summary_t frame_ms;
+	size_t particles;
+	double delta_error_ms;
+	double float_delta_error_ms;
+};
+}
+
+int main(int argc, char** argv)
+{
+	double hours = 12.0;
+	double start_hours = 0.0;
+	double fps = 60.0;
+	size_t count = 40000;
+	double sample_minutes = 10.0;
+	size_t render_every = 60;
+	upload_strategy_t upload = upload_strategy_t::orphan;
+	double threshold = 0.1;
+	double confidence = 0.99;
+	std::string output;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		std::string value;
+		bool valid = true;
+		if (match_option(arg, "--hours", value)) hours = std::stod(value);
+		else if (match_option(arg, "--start-hours", value)) start_hours = std::stod(value);
+		else if (match_option(arg, "--fps", value)) fps = std::stod(value);
+		else if (match_option(arg, "--count", value)) count = std::stoul(value);
+		else if (match_option(arg, "--sample-minutes", value)) sample_minutes = std::stod(value);
+		else if (match_option(arg, "--render-every", value)) render_every = std::stoul(value);
+		else if (match_option(arg, "--upload", value)) valid = from_string(value, upload);
+		else if (match_option(arg, "--threshold", value)) threshold = std::stod(value);
+		else if (match_option(arg, "--confidence", value)) confidence = std::stod(value);
+		else if (match_option(arg, "--output", value)) output = value;
+		else valid = false;
+		if (!valid || fps <= 0.0 || sample_minutes <= 0.0) {
+			std::cerr << "Invalid option " << arg << "\n";
+			return 1;
+		}
+	}
+
+	RenderTarget target;
+	if (render_every) {
+		// The window is used only to get a context, everything is rendered offscreen
+		glutInit(&argc, argv);
+		glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
+		glutInitWindowSize(64, 64);
+		glutCreateWindow("soak_bench");
+		glewInit();
+		if (!target.resize(target_width, target_height)) return 1;
+		target.bind();
+		glMatrixMode(GL_PROJECTION);
+		glLoadIdentity();
+		gluPerspective(45.0f, static_cast<float>(target_width) / target_height, 0.1f, 100.0f);
+		glMatrixMode(GL_MODELVIEW);
+	}
+
+	Scene scene(rate_for_population(count));
+	scene_config_t config;
+	config.upload = upload;
+	scene.set_config(config);
+	scene.set_seed(seed);
+	warm_up(scene);
+	if (render_every) scene.prepare_details();
+
+	const double time_step = 1.0 / fps;
+	const size_t total_frames = static_cast<size_t>(hours * 3600.0 * fps);
+	const size_t frames_per_sample = std::max<size_t>(1, static_cast<size_t>(sample_minutes * 60.0 * fps));
+	const double start_time = start_hours * 3600.0;
+
+	FrameClock clock;
+	float last_float_time = 0.0f;
+	std::vector<double> frame_times;
+	double delta_error = 0.0;
+	double float_delta_error = 0.0;
+	std::vector<sample_t> samples;
+	const auto wall_start = bench_clock::now();
+
+	for (size_t frame = 0; frame <= total_frames; ++frame) {
+		// Time is computed from the frame number, so the virtual clock itself doesn't drift
+		const double now = start_time + frame * time_step;
+		const float time_delta = clock.tick(now);
+		// What the application would get with float time (as returned by CAVEGetTime)
+		const float float_time = static_cast<float>(now);
+		if (frame) {
+			delta_error = std::max(delta_error, std::abs(time_delta - time_step));
+			float_delta_error = std::max(float_delta_error, std::abs(static_cast<double>(float_time - last_float_time) - time_step));
+		}
+		last_float_time = float_time;
+
+		const auto frame_start = bench_clock::now();
+		scene.update(time_delta);
+		if (render_every && frame % render_every == 0) {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glLoadIdentity();
+			scene.render(camera_position, 0.0f);
+			glFinish();
+		}
+		frame_times.push_back(seconds_since(frame_start) * 1000.0);
+
+		if (frame && frame % frames_per_sample == 0) {
+			sample_t sample;
+			sample.hours = frame * time_step / 3600.0;
+			sample.rss_kb = resident_kb();
+			sample.gpu_kb = render_every ? gpu_used_kb() : -1.0;
+			sample.buffer_kb = render_every ? scene.get_buffer_bytes() / 1024.0 : 0.0;
+			sample.frame_ms = summarize(frame_times);
+			sample.particles = scene.get_particle_count();
+			sample.delta_error_ms = delta_error * 1000.0;
+			sample.float_delta_error_ms = float_delta_error * 1000.0;
+			samples.push_back(sample);
+			frame_times.clear();
+			delta_error = 0.0;
+			float_delta_error = 0.0;
+			std::cerr << "simulated " << std::fixed << std::setprecision(2) << sample.hours << " h in "
+					<< seconds_since(wall_start) << " s, rss " << sample.rss_kb << " kB, p99 "
+					<< sample.frame_ms.p99 << " ms\n" << std::defaultfloat;
+		}
+	}
+	if (render_every) {
+		scene.release_details();
+		target.unbind();
+		target.release();
+	}
+
+	std::vector<json_record> records;
+	std::map<std::string, std::vector<double>> series;
+	std::vector<double> times;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const sample_t& sample = samples[i];
+		records.push_back(json_record()
+				.add("hours", sample.hours)
+				.add("rss_kb", sample.rss_kb)
+				.add("gpu_used_kb", sample.gpu_kb)
+				.add("vertex_buffer_kb", sample.buffer_kb)
+				.add("particles", sample.particles)
+				.add("frame_ms_p50", sample.frame_ms.p50)
+				.add("frame_ms_p99", sample.frame_ms.p99)
+				.add("frame_ms_max", sample.frame_ms.max)
+				.add("time_delta_error_ms", sample.delta_error_ms)
+				.add("float_time_delta_error_ms", sample.float_delta_error_ms));
+		if (i < settle_samples) continue;
+		times.push_back(sample.hours);
+		series["rss_kb"].push_back(sample.rss_kb);
+		if (sample.gpu_kb >= 0.0) series["gpu_used_kb"].push_back(sample.gpu_kb);
+		series["vertex_buffer_kb"].push_back(sample.buffer_kb);
+		series["frame_ms_p50"].push_back(sample.frame_ms.p50);
+		series["frame_ms_p99"].push_back(sample.frame_ms.p99);
+		series["time_delta_error_ms"].push_back(sample.delta_error_ms);
+	}
+
+	// A series is growing, when the trend is significant and large enough to matter
+	json_record header;
+	header.add("benchmark", "soak")
+			.add("simulated_hours", hours)
+			.add("start_hours", start_hours)
+			.add("particles", count)
+			.add("upload", to_string(upload))
+			.add("render_every", render_every)
+			.add("wall_seconds", seconds_since(wall_start));
+	bool passed = true;
+	for (const auto& s: series) {
+		if (s.second.size() != times.size()) continue;
+		const trend_t trend = linear_trend(times, s.second, confidence);
+		const double growth = trend.slope * (times.empty() ? 0.0 : times.back() - times.front());
+		const double reference = std::max(std::abs(trend.intercept + trend.slope * times.front()), 1e-3);
+		const bool growing = trend.increasing && growth > threshold * reference;
+		header.add(s.first + "_slope_per_hour", trend.slope)
+				.add(s.first + "_growing", growing ? "yes" : "no");
+		if (growing) {
+			std::cerr << s.first << " grows by " << trend.slope << " per hour\n";
+			passed = false;
+		}
+	}
+
+	const bool written = write_json(output, header, records);
+	return written && passed ? 0 : 1;
+}
@@ -9,11 +9,17 @@
 
 #include <GL/glew.h>
 #include "Application.h"
+#include "Autotuner.h"
+#include "Statistics.h"
 #include <functional>
 #include <iostream>
+#include <fstream>
 #include <algorithm>
 #include <cmath>
+#include <sstream>
+#include <cstring>
 #include "platform.h"
+#include <unistd.h>
 
 
 namespace CAVE {
@@ -32,6 +38,9 @@ const size_t particles_per_second = 400;
 const float rotation_per_second = pi_constant/2.0f;
 //! Default position in the scene (for reset())
 const point3 default_position = {0.0f, 0.0f, -5.0f};
+//! Head movement smaller than this doesn't cause a redraw (tracker noise)
+const float head_position_tolerance = 0.003f;
+const float head_rotation_tolerance = 0.05f;
 
 #ifdef CAVE_VERSION
 //! Communication channel for CAVElib
@@ -58,11 +67,90 @@ void dispatcher(void* data) {
 }
 
 Application::Application(int argc, char** argv):
-last_time_(0.0),scene_(particles_per_second)
+startup_reported_(false),options_(parse_options(argc, argv)),shared_state_(nullptr),shared_config_(nullptr),scene_(particles_per_second),
+control_version_(0),last_frame_(0.0),ramp_reported_(false)
 {
+	state_.particles_per_second = particles_per_second;
+	if (options_.stress_ramp) {
+		ramp_.reset(new StressRamp(particles_per_second, options_.ramp_step,
+				options_.ramp_target_fps, options_.ramp_percentile));
+	}
+#ifdef CAVE_MULTIPROCESS
+	// The display processes are forked in CAVEInit, so everything they share has to exist already
+	arena_.reset(new SharedArena(options_.shared_arena_mb << 20));
+	scene_.set_shared_arena(arena_.get());
+	shared_state_ = new (arena_->allocate(sizeof(app_state))) app_state(state_);
+	shared_config_ = new (arena_->allocate(sizeof(scene_config_t))) scene_config_t();
+#endif
+	if (!options_.behaviour.empty()) {
+		try {
+			auto behaviour = Behaviour::load(options_.behaviour);
+			if (options_.native_behaviour) behaviour->compile(options_.behaviour_cache);
+			scene_.set_behaviour(behaviour);
+		} catch (std::exception& e) {
+			std::cerr << "Failed to load behaviour: " << e.what() << "\n";
+		}
+	}
+	if (options_.gpu_simulation && scene_.get_behaviour()) {
+		std::cerr << "GPU simulation runs only Particle::update, particles are simulated on the CPU\n";
+	} else if (options_.gpu_simulation) {
+#ifdef CAVE_MULTIPROCESS
+		// The other display processes render particles from the shared arena
+		std::cerr << "GPU simulation is not supported with multi-process CAVElib\n";
+#else
+		if (options_.deterministic) {
+			std::cerr << "GPU simulation is not bit-identical on all nodes, particles are simulated on the CPU"
+					" (--fast-kernels allows it)\n";
+		} else {
+			scene_.set_gpu_simulation(true);
+		}
+#endif
+	}
+	if (options_.reprojection_fps > 0.0) {
+		reprojection_.reset(new Reprojection(1.0 / options_.reprojection_fps));
+	}
+	if (options_.profile_frequency > 0.0) {
+#ifdef CAVE_MULTIPROCESS
+		// The collector thread wouldn't survive the fork of the display processes
+		std::cerr << "Sampling profiler is not supported with multi-process CAVElib\n";
+#else
+		profiler_.reset(new SamplingProfiler(options_.profile_frequency, options_.profile_wall_clock));
+#endif
+	}
+	if (options_.energy) {
+		energy_.reset(new EnergyMeter());
+		if (!energy_->available()) {
+			std::cerr << "Energy counters (RAPL) are not readable, energy won't be reported\n";
+		}
+	}
+	if (!options_.point_cloud.empty()) {
+#ifdef CAVE_MULTIPROCESS
+		// The I/O threads wouldn't survive the fork of the display processes
+		std::cerr << "Point clouds are not supported with multi-process CAVElib\n";
+#else
+		io_.reset(new AsyncIO());
+		cloud_.reset(new PointCloud(*io_, options_.point_cloud));
+		progressive_.reset(new ProgressiveRenderer(*cloud_, options_.cloud_points_per_frame));
+#endif
+	}
+	if (options_.on_demand) {
+		frame_cache_.reset(new FrameCache());
+	}
+	if (options_.overdraw_interval || options_.overdraw_heatmap) {
+		overdraw_.reset(new OverdrawMeter(options_.overdraw_interval, options_.overdraw_heatmap));
+	}
+	if (options_.hud_wall >= 0) {
+		hud_.reset(new Hud(options_.hud_wall, options_.frame_deadline_ms / 1000.0));
+	}
+	if (!options_.flight_recorder.empty()) {
+		recorder_.reset(new FlightRecorder(options_.flight_recorder, options_.frame_deadline_ms / 1000.0));
+		scene_.set_recorder(recorder_.get());
+	}
 #ifdef CAVE_VERSION
+	auto _ = timeline_.span("CAVEConfigure");
 	CAVEConfigure(&argc,argv,nullptr);
 #else
+	auto _ = timeline_.span("glutInit");
 	glutInit(&argc, argv);
 	instance = this;
 #endif
@@ -76,15 +164,43 @@ void Application::init_gl()
 	glEnable(GL_DEPTH_TEST);
 	glShadeModel(GL_SMOOTH);
 	glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+	if (GLEW_ARB_parallel_shader_compile) {
+		// Let the driver use as many compiler threads as it wants
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
 	scene_.prepare_details();
 }
 
+void Application::report_startup(int thread_id)
+{
+	if (startup_reported_) return;
+	startup_reported_ = true;
+	timeline_.mark("first synchronized frame", thread_id);
+	timeline_.report(std::cout);
+}
+
 #ifdef CAVE_VERSION
 void Application::init_cave()
 {
+	const int thread_id = get_thread_id();
+	SamplingProfiler::register_thread("display " + std::to_string(thread_id));
 	if (CAVEMasterDisplay()) {
+		auto _ = timeline_.span("glewInit", thread_id);
 		glewInit();
-		unsigned int seed;
+	}
+	{
+		auto _ = timeline_.span("barrier (GLEW ready)", thread_id);
+		CAVEDisplayBarrier();
+	}
+
+	/*
+	 * The seed exchange overlaps with GL setup of all the display threads.
+	 * Master writes the seed before its own setup and the others read it only after theirs,
+	 * when it has most likely arrived already.
+	 */
+	unsigned int seed = 0;
+	if (CAVEMasterDisplay()) {
+		auto _ = timeline_.span("seed send", thread_id);
 		// Open communication channel
 		CAVEDistribOpenConnection(comm_channel);
 		if (CAVEDistribMaster()) {
@@ -92,14 +208,57 @@ void Application::init_cave()
 			seed = rd();
 			buttons_.resize(CAVEController->num_buttons);
 			CAVEDistribWrite(comm_channel, &seed, sizeof(seed));
-		} else {
+		}
+	}
+	{
+		auto _ = timeline_.span("init_gl", thread_id);
+		init_gl();
+	}
+	if (CAVEMasterDisplay()) {
+		if (!CAVEDistribMaster()) {
+			auto _ = timeline_.span("seed receive", thread_id);
 			CAVEDistribRead(comm_channel, &seed, sizeof(seed));
 		}
 		scene_.set_seed(seed);
-
+		if (CAVEDistribMaster()) open_control();
+		// Every instance tunes itself for its own hardware
+		scene_config_t config;
+		{
+			auto _ = timeline_.span("tuning", thread_id);
+			config = tuned_config(options_.calibrate);
+		}
+		if (CAVEDistribMaster()) {
+			configure(config);
+			config = scene_.get_config();
+			CAVEDistribWrite(comm_channel, &config, sizeof(config));
+		} else {
+			auto _ = timeline_.span("config receive", thread_id);
+			scene_config_t master;
+			CAVEDistribRead(comm_channel, &master, sizeof(master));
+			// But the walls have to draw the same particles the same way
+			config.backend = master.backend;
+			config.vertex_format = master.vertex_format;
+			config.deterministic = master.deterministic;
+			configure(config);
+		}
+		if (shared_config_) *shared_config_ = scene_.get_config();
+	}
+	{
+		auto _ = timeline_.span("barrier (init done)", thread_id);
+		CAVEDisplayBarrier();
 	}
-	CAVEDisplayBarrier();
-	init_gl();
+	// Other display processes have their own copy of the scene, configured before the first frame
+	if (shared_config_ && !CAVEMasterDisplay()) configure(*shared_config_);
+}
+
+void Application::stop_cave()
+{
+	/*
+	 * Reported only after the rendering stopped and from the master display,
+	 * which has the statistics also in the multi-process mode.
+	 */
+	if (CAVEMasterDisplay()) report();
+	release_gl();
 }
 
 void Application::update_cave()
@@ -113,7 +272,15 @@ void Application::update_cave()
 	 *  - CAVEMasterDisplay() returns true in exactly one thread on every instance.
 	 */
 
+	// Called in every display thread, the scene then uploads the particles once for all its walls
+	scene_.begin_frame();
+	if (reprojection_) reprojection_->begin_frame();
+	if (progressive_) progressive_->begin_frame();
+	if (frame_cache_) frame_cache_->begin_frame();
+	if (overdraw_) overdraw_->begin_frame();
+
 	if (CAVEMasterDisplay()) { // Only one thread should update the scene
+		record_frame();
 
 		if (CAVEDistribMaster()) { // Only the master instance should compute the update
 			for (size_t i = 0; i < buttons_.size(); ++i) {
@@ -122,8 +289,8 @@ void Application::update_cave()
 
 			reset(buttons_[0].was_pressed);
 
-			const double current_time = CAVEGetTime();
-			update_time(current_time);
+			// CAVEGetTime() returns float, which loses precision during long runs
+			update_time(FrameClock::now());
 
 			const float joystick_x = CAVEController->valuator[0];
 			const float joystick_y = CAVEController->valuator[1];
@@ -135,28 +302,61 @@ void Application::update_cave()
 			if (std::abs(joystick_y) > 0.1f) {
 				state_.position = state_.position + joystick_y * state_.time_delta * move_vector;
 			}
+			control_ramp();
+			poll_control();
+			track_changes();
 
+			FlightRecorder::Span _(recorder_.get(), "distrib write", sizeof(state_));
 			CAVEDistribWrite(comm_channel, &state_, sizeof(state_));
 		} else { // Other instances should just receive updates from master
+			FlightRecorder::Span _(recorder_.get(), "distrib read", sizeof(state_));
 			CAVEDistribRead(comm_channel, &state_, sizeof(state_));
 		}
 
 		// And evaluate the update
 		update();
+		if (shared_state_) *shared_state_ = state_;
+	}
+	{
+		FlightRecorder::Span _(recorder_.get(), "barrier");
+		SamplingProfiler::Phase phase("barrier");
+		EnergyMeter::Scope energy(CAVEMasterDisplay() ? energy_.get() : nullptr, "barrier");
+		const double start = FrameClock::now();
+		CAVEDisplayBarrier();
+		if (CAVEMasterDisplay()) hud_frame_.barrier_time = FrameClock::now() - start;
 	}
-	CAVEDisplayBarrier();
+	// Other display processes render with the state of the master display
+	if (shared_state_ && !CAVEMasterDisplay()) {
+		state_ = *shared_state_;
+		// And with its configuration, they have their own copy of the scene
+		if (state_.control.version != control_version_) apply_control();
+	}
+	if (CAVEMasterDisplay()) report_startup(get_thread_id());
 }
 #else
 void Application::render_glut()
 {
 	if (!instance) return;
-	double current_time = glutGet(GLUT_ELAPSED_TIME) / 1000.0;
-	instance->update_time(current_time);
+	if (instance->calibration_requested_) {
+		instance->calibration_requested_ = false;
+		instance->tune(true);
+	}
+	instance->update_time(FrameClock::now());
+	instance->scene_.begin_frame();
+	if (instance->reprojection_) instance->reprojection_->begin_frame();
+	if (instance->progressive_) instance->progressive_->begin_frame();
+	if (instance->frame_cache_) instance->frame_cache_->begin_frame();
+	if (instance->overdraw_) instance->overdraw_->begin_frame();
+	instance->record_frame();
+	instance->control_ramp();
+	instance->poll_control();
+	instance->track_changes();
 
 	instance->update();
 	glLoadIdentity();
 	instance->render();
 	glutSwapBuffers();
+	instance->report_startup(StartupTimeline::main_thread);
 }
 
 void resize_glut(int w, int h)
@@ -173,6 +373,8 @@ void Application::keyboard_glut(unsigned char key, int /*x*/, int /*y*/)
 {
 	switch (key) {
 	case 27: //Escape
+		instance->report();
+		instance->release_gl();
 		exit(0);break;
 	case ' ':
 		instance->reset(true);
@@ -191,6 +393,12 @@ void Application::keyboard_glut(unsigned char key, int /*x*/, int /*y*/)
 	case 'd':
 		instance->state_.rotation_y -=rotation_per_second/20;
 		break;
+	case 'c':
+		instance->calibration_requested_ = true;
+		break;
+	case 'p':
+		instance->state_.paused = !instance->state_.paused;
+		break;
 	}
 }
 
@@ -198,17 +406,186 @@ void Application::keyboard_glut(unsigned char key, int /*x*/, int /*y*/)
 
 void Application::update()
 {
+	const double start = FrameClock::now();
+	FlightRecorder::Span _(recorder_.get(), "update");
+	EnergyMeter::Scope energy(energy_.get(), "update");
 	if (state_.reset_scene) {
 		scene_.reset();
 		reset(false);
 	}
-	scene_.update(state_.time_delta);
+	if (state_.control.version != control_version_) apply_control();
+	scene_.set_particles_per_second(state_.particles_per_second);
+	if (!state_.paused) scene_.update(state_.time_delta);
+	// Completions of the point cloud reads
+	if (io_) io_->poll();
+	hud_frame_.update_time = FrameClock::now() - start;
+
+	if (ramp_ && state_.ramp_done && !ramp_reported_) {
+		ramp_reported_ = true;
+		if (options_.ramp_report.empty()) {
+			ramp_->report(std::cout);
+		} else {
+			// Every node appends its own report
+			std::ofstream file(options_.ramp_report, std::ios::app);
+			ramp_->report(file);
+		}
+	}
+}
+
+void Application::record_frame()
+{
+	const double now = FrameClock::now();
+	if (recorder_ && last_frame_ > 0.0) recorder_->end_frame(last_frame_, now);
+	if (energy_) energy_->end_frame(scene_.get_particle_count());
+	if (ramp_ && last_frame_ > 0.0) {
+		ramp_->record_frame(state_.particles_per_second, state_.ramp_measuring,
+				now - last_frame_, scene_.get_particle_count());
+	}
+	if (hud_ && last_frame_ > 0.0) {
+		hud_frame_.frame_time = now - last_frame_;
+		hud_frame_.particles = scene_.get_particle_count();
+		hud_->add_frame(hud_frame_);
+	}
+	if (!config_stats_.empty() && last_frame_ > 0.0) config_stats_.back().frame_times.push_back(now - last_frame_);
+	hud_frame_ = hud_frame_t();
+	last_frame_ = now;
+}
+
+void Application::report() const
+{
+	if (reprojection_) reprojection_->report(std::cout);
+	if (energy_) energy_->report(std::cout);
+	if (hud_) hud_->report(std::cout);
+	if (frame_cache_) frame_cache_->report(std::cout);
+	if (overdraw_) overdraw_->report(std::cout);
+	for (const auto& stats: config_stats_) {
+		const summary_t summary = summarize(stats.frame_times);
+		std::cout << "[" << stats.label << "] " << summary.count << " frames, mean " << summary.mean * 1e3
+				<< " ms, p99 " << summary.p99 * 1e3 << " ms, max " << summary.max * 1e3 << " ms\n";
+	}
+	write_profile();
+}
+
+void Application::write_profile() const
+{
+	if (!profiler_) return;
+	profiler_->stop();
+	std::string path = options_.profile_output;
+	if (path.empty()) {
+		// Every node writes its own profile
+		char host[256] = {0};
+		gethostname(host, sizeof(host) - 1);
+		path = std::string("profile-") + host + ".folded";
+	}
+	if (profiler_->write(path)) {
+		std::cout << "Profile (" << profiler_->samples() << " samples, " << profiler_->dropped()
+				<< " dropped) written to " << path << "\n";
+	} else {
+		std::cerr << "Failed to write profile " << path << "\n";
+	}
+}
+
+void Application::control_ramp()
+{
+	if (!ramp_) return;
+	ramp_->control(FrameClock::now(), scene_.get_particle_count(),
+			state_.particles_per_second, state_.ramp_measuring, state_.ramp_done);
+}
+
+void Application::track_changes()
+{
+	if (!frame_cache_) return;
+	view_inputs_t inputs;
+	inputs.position = state_.position;
+	inputs.rotation_y = state_.rotation_y;
+	inputs.control = state_.control.version;
+#ifdef CAVE_VERSION
+	// The head determines the view matrices of all the walls
+	CAVEGetPosition(CAVE_HEAD, inputs.head);
+	CAVEGetOrientation(CAVE_HEAD, inputs.head + 3);
+#endif
+	bool head_moved = false;
+	for (int i = 0; i < 6; ++i) {
+		const float tolerance = i < 3 ? head_position_tolerance : head_rotation_tolerance;
+		head_moved = head_moved || std::abs(inputs.head[i] - last_inputs_.head[i]) > tolerance;
+	}
+	const view_inputs_t& last = last_inputs_;
+	const bool navigated = inputs.position.x != last.position.x || inputs.position.y != last.position.y ||
+			inputs.position.z != last.position.z || inputs.rotation_y != last.rotation_y;
+	const bool simulated = !state_.paused || state_.reset_scene || inputs.control != last.control;
+	const bool refining = progressive_ && !progressive_->converged();
+	const bool hud = hud_ && hud_->changed(FrameClock::now());
+	// The decision goes to all the instances with the rest of the state
+	state_.redraw = head_moved || navigated || simulated || refining || hud;
+	if (head_moved) std::copy(inputs.head, inputs.head + 6, last_inputs_.head);
+	last_inputs_.position = inputs.position;
+	last_inputs_.rotation_y = inputs.rotation_y;
+	last_inputs_.control = inputs.control;
+}
+
+void Application::open_control()
+{
+	if (options_.control.empty()) return;
+	try {
+		control_.reset(new ControlChannel(options_.control));
+		std::cout << "Accepting control commands on " << (options_.control == "-" ? "stdin" : options_.control) << "\n";
+	} catch (std::runtime_error& e) {
+		std::cerr << e.what() << "\n";
+	}
+}
+
+void Application::poll_control()
+{
+	if (!control_) return;
+	control_->poll();
+	control_command_t command;
+	while (control_->next(command)) {
+		std::istringstream words(command.line);
+		std::string verb;
+		std::string name;
+		std::string value;
+		words >> verb >> name >> value;
+		if (verb == "show") {
+			control_->reply(command.client, to_string(scene_.get_config()));
+		} else if (verb == "pause" || verb == "resume") {
+			state_.paused = verb == "pause";
+			control_->reply(command.client, "ok");
+		} else if (verb == "set") {
+			scene_config_t config = scene_.get_config();
+			control_change_t& change = state_.control;
+			if (name.size() >= sizeof(change.name) || value.size() >= sizeof(change.value) ||
+					!set_option(config, name, value)) {
+				control_->reply(command.client, "error: invalid option " + name + " " + value);
+				continue;
+			}
+			++change.version;
+			std::strcpy(change.name, name.c_str());
+			std::strcpy(change.value, value.c_str());
+			control_->reply(command.client, "ok, configuration " + std::to_string(change.version));
+			// Only one change fits into a frame, the others wait for the next ones
+			break;
+		} else {
+			control_->reply(command.client, "error: unknown command, use show, pause, resume or set <option> <value>");
+		}
+	}
+}
+
+void Application::apply_control()
+{
+	control_version_ = state_.control.version;
+	scene_config_t config = scene_.get_config();
+	// Validated on the master instance
+	if (!set_option(config, state_.control.name, state_.control.value)) return;
+	// Switched at the same frame on all instances, so the statistics of all nodes are comparable
+	configure(config);
+	if (!is_master_display()) return;
+	std::cout << "Configuration " << control_version_ << ": " << to_string(scene_.get_config()) << "\n";
+	if (recorder_) recorder_->counter("configuration", control_version_);
 }
 
 void Application::update_time(double current_time)
 {
-	state_.time_delta = current_time - last_time_;
-	last_time_ = current_time;
+	state_.time_delta = clock_.tick(current_time);
 	//state_.particles_to_create = static_cast<size_t>(particles_per_second * state_.time_delta);
 }
 void Application::reset(bool value)
@@ -219,9 +596,91 @@ void Application::reset(bool value)
 		state_.rotation_y = 0.0f;
 	}
 }
+void Application::tune(bool force)
+{
+	configure(tuned_config(force));
+}
+
+scene_config_t Application::tuned_config(bool force)
+{
+	scene_config_t config = scene_.get_config();
+	if (!options_.no_tuning || force) {
+		Autotuner tuner(options_.tuning_file, scene_.get_particles_per_second());
+		config = tuner.configure(force);
+	}
+	config.deterministic = options_.deterministic;
+	config.gpu_culling = options_.gpu_culling;
+	config.vertex_pulling = options_.vertex_pulling;
+	config.multi_viewport = options_.multi_viewport;
+	// The sprites only approximate the quads, so they are never chosen by speed
+	config.backend = options_.point_sprites ? render_backend_t::point_sprite : render_backend_t::geometry_shader;
+	return config;
+}
+
+bool Application::separate_views() const
+{
+	// The HUD would be cleared by the views drawn after it
+	return reprojection_ || progressive_ || frame_cache_ || overdraw_ || hud_;
+}
+
+void Application::configure(scene_config_t config)
+{
+	// The buffers of the GPU simulation are drawn as they are
+	if (scene_.get_gpu_simulation()) config.vertex_format = vertex_format_t::full;
+	config.multi_viewport = config.multi_viewport && !separate_views();
+	scene_.set_config(config);
+	if (!is_master_display()) return;
+	// Statistics per configuration, when it may change
+	if (!options_.control.empty() || control_version_) config_stats_.push_back(config_stats_t{to_string(config), {}});
+	if (config.deterministic) {
+		std::cout << "Deterministic update, kernel " << to_string(scene_.get_kernel()) << "\n";
+	} else if (scene_.get_gpu_simulation()) {
+		std::cout << "Particles simulated on the GPU\n";
+	}
+}
+
 void Application::render() const
 {
-	scene_.render(state_.position, state_.rotation_y);
+	const double start = FrameClock::now();
+	FlightRecorder::Span _(recorder_.get(), "render");
+	// Walls of the other display threads render at the same time
+	EnergyMeter::Scope energy(is_master_display() ? energy_.get() : nullptr, "render");
+	const auto navigation = [this](){Scene::apply_navigation(state_.position, state_.rotation_y);};
+	const auto render_view = [this, &navigation](){
+		if (overdraw_) overdraw_->begin_view();
+		scene_.render(state_.position, state_.rotation_y);
+		if (progressive_) progressive_->render(navigation);
+		if (overdraw_) overdraw_->end_view();
+	};
+	const auto draw = [this, &render_view, &navigation](){
+		if (reprojection_) {
+			reprojection_->render(render_view, navigation);
+		} else {
+			render_view();
+		}
+		if (hud_) {
+			// Drawn over the view, never reprojected
+			FlightRecorder::Span _(recorder_.get(), "hud");
+			hud_->render();
+		}
+	};
+	if (frame_cache_) {
+		// All the instances got the same decision with the state
+		frame_cache_->render(draw, state_.redraw);
+	} else {
+		draw();
+	}
+	if (is_master_display()) hud_frame_.render_time += FrameClock::now() - start;
+	if (ramp_) ramp_->record_render(get_thread_id(), FrameClock::now() - start);
+}
+
+void Application::release_gl()
+{
+	if (reprojection_) reprojection_->release();
+	if (progressive_) progressive_->release();
+	if (frame_cache_) frame_cache_->release();
+	if (overdraw_) overdraw_->release();
+	if (hud_) hud_->release();
 }
 
 int Application::run()
@@ -231,12 +690,18 @@ int Application::run()
 	dispatch_data_t dispatch_init{[&](){this->init_cave();}};
 	dispatch_data_t dispatch_update{[&](){this->update_cave();}};
 	dispatch_data_t dispatch_display{[&](){this->render();}};
+	dispatch_data_t dispatch_stop{[&](){this->stop_cave();}};
 
 	CAVEInitApplication(reinterpret_cast<CAVECALLBACK>(dispatcher), 1, static_cast<void*>(&dispatch_init));
 	CAVEDisplay(reinterpret_cast<CAVECALLBACK>(dispatcher), 1, static_cast<void*>(&dispatch_display));
 	CAVEFrameFunction(reinterpret_cast<CAVECALLBACK>(dispatcher), 1, static_cast<void*>(&dispatch_update));
+	// Called by CAVEExit in every display thread, with its context still current
+	CAVEStopApplication(reinterpret_cast<CAVECALLBACK>(dispatcher), 1, static_cast<void*>(&dispatch_stop));
 
-	CAVEInit();
+	{
+		auto _ = timeline_.span("CAVEInit");
+		CAVEInit();
+	}
 	std::cout << "Starting up main loop\n";
  	if (CAVEDistribMaster())
 		while (!CAVEgetbutton(CAVE_ESCKEY)) {
@@ -247,14 +712,28 @@ int Application::run()
 	CAVEExit();
 	return 0;
 #else
-	glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
+	glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA | (overdraw_ ? GLUT_STENCIL : 0));
 	glutInitWindowPosition(100,100);
 	glutInitWindowSize(800,600);
 	resize_glut(800,600);
-	glutCreateWindow("CAVElib example");
-
-	glewInit();
-	init_gl();
+	SamplingProfiler::register_thread("main");
+	{
+		auto _ = timeline_.span("glutCreateWindow");
+		glutCreateWindow("CAVElib example");
+	}
+	{
+		auto _ = timeline_.span("glewInit");
+		glewInit();
+	}
+	{
+		auto _ = timeline_.span("init_gl");
+		init_gl();
+	}
+	{
+		auto _ = timeline_.span("tuning");
+		tune(options_.calibrate);
+	}
+	open_control();
 	std::random_device rd;
 	scene_.set_seed(rd());
 	glutDisplayFunc(render_glut);
@@ -12,17 +12,50 @@
 #define APPLICATION_H_
 
 #include "Scene.h"
+#include "Options.h"
+#include "StressRamp.h"
+#include "StartupTimeline.h"
+#include "FrameClock.h"
+#include "Reprojection.h"
+#include "FlightRecorder.h"
+#include "SamplingProfiler.h"
+#include "EnergyMeter.h"
+#include "SharedArena.h"
+#include "AsyncIO.h"
+#include "PointCloud.h"
+#include "ProgressiveRenderer.h"
+#include "Hud.h"
+#include "ControlChannel.h"
+#include "FrameCache.h"
+#include "OverdrawMeter.h"
+#include <memory>
 
 
 
 namespace CAVE {
 
+//! Change of a scene option requested through the control channel
+struct control_change_t {
+	//! Incremented with every change
+	unsigned int version	= 0;
+	char name[32]			= {0};
+	char value[32]			= {0};
+};
+
 struct app_state {
 	float time_delta 	= 0.0f;
 	bool reset_scene 	= false;
 	point3 position 	= {0.0f, 0.0f, -5.0f};
 	float rotation_y	= 0.0f;
 //	size_t particles_to_create = 0;
+	size_t particles_per_second = 0;
+	bool ramp_measuring	= false;
+	bool ramp_done		= false;
+	//! The simulation doesn't advance
+	bool paused			= false;
+	//! Something changed since the last frame, so the views have to be rendered (not presented again)
+	bool redraw			= true;
+	control_change_t control;
 };
 
 class Application {
@@ -36,17 +69,67 @@ private:
 	void render() const;
 	void update_time(double current_time);
 	void reset(bool value);
+	/*!
+	 * Configures the scene from stored calibration results (or runs the calibration).
+	 * Requires current OpenGL context.
+	 * @param force Run the calibration even if there are stored results
+	 */
+	void tune(bool force);
+	//! Configuration from the calibration (as in tune()), without applying it
+	scene_config_t tuned_config(bool force);
+	//! Applies @em config to the scene (limited by the features enabled in this instance)
+	void configure(scene_config_t config);
+	//! Whether reprojection, progressive refinement, the frame cache, overdraw or the HUD need every view rendered separately
+	bool separate_views() const;
+	//! Prints the startup timeline (only once)
+	void report_startup(int thread_id);
+	//! Prints statistics collected during the run
+	void report() const;
+	//! Measures duration and energy of the previous frame
+	void record_frame();
+	//! Stops the sampling profiler and writes the collected stacks
+	void write_profile() const;
+	//! Lets the stress ramp decide about the next frame (master instance only)
+	void control_ramp();
+	//! Decides whether the frame has to be rendered (master instance only)
+	void track_changes();
+	//! Opens the control channel, if requested (master instance only)
+	void open_control();
+	//! Handles commands from the control channel (master instance only)
+	void poll_control();
+	//! Applies the last change from the control channel (every instance)
+	void apply_control();
+	//! Deletes GL objects of the per-context wrappers (in every display thread before its context goes away)
+	void release_gl();
 
 #ifdef CAVE_VERSION
 	void update_cave();
 	void init_cave();
+	//! Reports the statistics and releases GL objects (called by CAVEExit in every display thread)
+	void stop_cave();
 #else
 	static Application* instance; // This is UGLY and only for GLUT
 	static void render_glut();
 	static void keyboard_glut(unsigned char key, int x, int y);
+	bool calibration_requested_ = false;
 #endif
 
 
+	//! Frame times measured with one scene configuration
+	struct config_stats_t {
+		std::string label;
+		std::vector<double> frame_times;
+	};
+
+	//! Inputs of the views compared by track_changes()
+	struct view_inputs_t {
+		point3 position			= {0.0f, 0.0f, 0.0f};
+		float rotation_y		= 0.0f;
+		//! Head position and orientation
+		float head[6]			= {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+		unsigned int control	= 0;
+	};
+
 	/*!
 	 * Simple helper to catch changes of button value
 	 */
@@ -59,10 +142,42 @@ private:
 		}
 	};
 
-	double last_time_;
+	//! First member, so it is created as soon as possible
+	StartupTimeline timeline_;
+	bool startup_reported_;
+	options_t options_;
+	FrameClock clock_;
 	app_state state_;
 	std::vector<button_t> buttons_;
+	//! Has to outlive the scene, which may have its particles there
+	std::unique_ptr<SharedArena> arena_;
+	//! Copy of state_ for the display processes (multi-process mode only)
+	app_state* shared_state_;
+	//! Scene configuration of the master display for the other display processes (multi-process mode only)
+	scene_config_t* shared_config_;
 	Scene scene_;
+	std::unique_ptr<StressRamp> ramp_;
+	std::unique_ptr<Reprojection> reprojection_;
+	std::unique_ptr<FlightRecorder> recorder_;
+	std::unique_ptr<SamplingProfiler> profiler_;
+	std::unique_ptr<EnergyMeter> energy_;
+	//! Has to outlive the point cloud, which waits for its reads
+	std::unique_ptr<AsyncIO> io_;
+	std::unique_ptr<PointCloud> cloud_;
+	std::unique_ptr<ProgressiveRenderer> progressive_;
+	std::unique_ptr<Hud> hud_;
+	//! Phases of the current frame for the HUD (measured in the master display thread)
+	mutable hud_frame_t hud_frame_;
+	std::unique_ptr<FrameCache> frame_cache_;
+	std::unique_ptr<OverdrawMeter> overdraw_;
+	view_inputs_t last_inputs_;
+	std::unique_ptr<ControlChannel> control_;
+	//! Version of the last applied control change
+	unsigned int control_version_;
+	//! Statistics of all the configurations used (with the control channel only)
+	std::vector<config_stats_t> config_stats_;
+	double last_frame_;
+	bool ramp_reported_;
 };
 
 }
@@ -0,0 +1,407 @@
+/*!
+ * @file 		AsyncIO.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		21.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "AsyncIO.h"
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace CAVE {
+
+namespace {
+//! Threads of the fallback pool
+const size_t max_pool_threads = 4;
+//! Part of the queue usable by prefetch (in quarters)
+const size_t prefetch_quarters = 3;
+//! Alignment of the pool buffers, enough for O_DIRECT
+const size_t buffer_alignment = 4096;
+//! user_data of the request waking the completion thread at the end
+const unsigned long long wake_up_marker = 0;
+
+size_t index_of(io_priority_t priority)
+{
+	return priority == io_priority_t::visible ? 0 : 1;
+}
+}
+
+#ifdef HAVE_IO_URING
+/*!
+ * Mapping of the submission and completion rings of one io_uring instance.
+ * Only one thread submits (with mutex_ locked) and only the completion thread reaps.
+ */
+struct AsyncIO::ring_t {
+	ring_t():fd(-1),sq_ptr(MAP_FAILED),sq_size(0),cq_ptr(MAP_FAILED),cq_size(0),
+			sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),sqes_size(0),registered(false) {}
+	~ring_t() noexcept
+	{
+		if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+		if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+		if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+		if (fd >= 0) close(fd);
+	}
+
+	bool setup(unsigned entries)
+	{
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+		fd = syscall(__NR_io_uring_setup, entries, &params);
+		if (fd < 0) return false;
+		sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (single_mmap) sq_size = cq_size = std::max(sq_size, cq_size);
+		sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (sq_ptr == MAP_FAILED) return false;
+		cq_ptr = single_mmap ? sq_ptr :
+				mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED) return false;
+		sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+		if (sqes == MAP_FAILED) return false;
+
+		char* sq = static_cast<char*>(sq_ptr);
+		sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		char* cq = static_cast<char*>(cq_ptr);
+		cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		return true;
+	}
+
+	//! Registers the buffers, so the kernel doesn't have to map them for every read
+	bool register_buffers(const std::vector<io_buffer_t>& buffers)
+	{
+		std::vector<iovec> iovecs;
+		for (const auto& buffer: buffers) {
+			iovecs.push_back({buffer.data, buffer.size});
+		}
+		registered = !iovecs.empty() && syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+				iovecs.data(), static_cast<unsigned>(iovecs.size())) == 0;
+		return registered;
+	}
+
+	/*!
+	 * @return 0 when the kernel took the entry (it completes it later),
+	 * or errno and the entry is taken back from the ring
+	 */
+	int submit(unsigned char opcode, int file, const void* address, unsigned length,
+			off_t offset, int buffer_index, unsigned long long user_data)
+	{
+		const unsigned tail = *sq_tail;
+		const unsigned index = tail & sq_mask;
+		io_uring_sqe& sqe = sqes[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = opcode;
+		sqe.fd = file;
+		sqe.addr = reinterpret_cast<unsigned long long>(address);
+		sqe.len = length;
+		sqe.off = offset;
+		sqe.buf_index = buffer_index < 0 ? 0 : buffer_index;
+		sqe.user_data = user_data;
+		sq_array[index] = index;
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+		int error = 0;
+		while (syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0) < 0) {
+			if (errno == EINTR) continue;
+			error = errno;
+			break;
+		}
+		// Every entry is entered right away, so the head was at tail before this one
+		if (!error || __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) != tail) return 0;
+		// Not consumed, the next enter would submit a request already finished as failed
+		__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+		return error;
+	}
+
+	//! Blocks until there is at least one completion and moves all of them to @em out
+	void wait(std::vector<std::pair<unsigned long long, int>>& out)
+	{
+		unsigned head = *cq_head;
+		while (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+			syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+		}
+		for (; head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE); ++head) {
+			const io_uring_cqe& cqe = cqes[head & cq_mask];
+			out.push_back(std::make_pair(cqe.user_data, cqe.res));
+		}
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	int fd;
+	void* sq_ptr;
+	size_t sq_size;
+	void* cq_ptr;
+	size_t cq_size;
+	io_uring_sqe* sqes;
+	size_t sqes_size;
+	bool registered;
+
+	unsigned* sq_head;
+	unsigned* sq_tail;
+	unsigned sq_mask;
+	unsigned* sq_array;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned cq_mask;
+	io_uring_cqe* cqes;
+};
+#else
+struct AsyncIO::ring_t {};
+#endif
+
+std::string to_string(AsyncIO::backend_t backend)
+{
+	return backend == AsyncIO::backend_t::io_uring ? "io_uring" : "thread_pool";
+}
+
+AsyncIO::AsyncIO(size_t queue_depth, size_t buffer_count, size_t buffer_size, bool allow_uring):
+queue_depth_(std::max<size_t>(queue_depth, 1)),
+prefetch_depth_(std::max<size_t>(queue_depth_ * prefetch_quarters / 4, 1)),
+backend_(backend_t::thread_pool),in_flight_(0),prefetch_in_flight_(0),quit_(false)
+{
+	for (size_t i = 0; i < buffer_count; ++i) {
+		void* data = nullptr;
+		if (posix_memalign(&data, buffer_alignment, buffer_size) != 0) break;
+		buffers_.push_back({data, buffer_size, -1});
+	}
+	for (auto& buffer: buffers_) {
+		free_buffers_.push_back(&buffer);
+	}
+
+	if (allow_uring && setup_ring()) {
+		backend_ = backend_t::io_uring;
+		threads_.emplace_back([this](){ring_completions();});
+	} else {
+		ring_.reset();
+		const size_t threads = std::min(queue_depth_, max_pool_threads);
+		for (size_t i = 0; i < threads; ++i) {
+			threads_.emplace_back([this](){pool_worker();});
+		}
+	}
+}
+
+AsyncIO::~AsyncIO() noexcept
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		waiting_[0].clear();
+		waiting_[1].clear();
+		// The kernel (or the pool) may still write to the buffers
+		done_cond_.wait(lock, [this](){return in_flight_ == 0;});
+		quit_ = true;
+#ifdef HAVE_IO_URING
+		if (ring_) ring_->submit(IORING_OP_NOP, -1, nullptr, 0, 0, -1, wake_up_marker);
+#endif
+	}
+	ready_cond_.notify_all();
+	for (auto& thread: threads_) {
+		thread.join();
+	}
+	ring_.reset();
+	for (auto& buffer: buffers_) {
+		std::free(buffer.data);
+	}
+}
+
+bool AsyncIO::setup_ring()
+{
+#ifdef HAVE_IO_URING
+	ring_.reset(new ring_t());
+	if (!ring_->setup(static_cast<unsigned>(queue_depth_))) return false;
+	if (ring_->register_buffers(buffers_)) {
+		for (size_t i = 0; i < buffers_.size(); ++i) {
+			buffers_[i].index = static_cast<int>(i);
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+io_buffer_t* AsyncIO::acquire_buffer()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	if (free_buffers_.empty()) return nullptr;
+	io_buffer_t* buffer = free_buffers_.back();
+	free_buffers_.pop_back();
+	return buffer;
+}
+
+void AsyncIO::release_buffer(io_buffer_t* buffer)
+{
+	if (!buffer) return;
+	std::unique_lock<std::mutex> _(mutex_);
+	free_buffers_.push_back(buffer);
+}
+
+void AsyncIO::read(int fd, void* data, size_t size, off_t offset, io_priority_t priority,
+		const io_callback_t& callback)
+{
+	std::unique_ptr<request_t> request(new request_t{fd, {data, size}, offset, -1, priority, callback, {0, 0}});
+	enqueue(std::move(request));
+}
+
+void AsyncIO::read(int fd, io_buffer_t* buffer, size_t size, off_t offset, io_priority_t priority,
+		const io_callback_t& callback)
+{
+	std::unique_ptr<request_t> request(new request_t{fd, {buffer->data, std::min(size, buffer->size)},
+		offset, buffer->index, priority, callback, {0, 0}});
+	enqueue(std::move(request));
+}
+
+void AsyncIO::enqueue(std::unique_ptr<request_t> request)
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	waiting_[index_of(request->priority)].push_back(std::move(request));
+	schedule();
+}
+
+void AsyncIO::schedule()
+{
+	while (in_flight_ < queue_depth_) {
+		std::unique_ptr<request_t> request;
+		if (!waiting_[0].empty()) {
+			request = std::move(waiting_[0].front());
+			waiting_[0].pop_front();
+		} else if (!waiting_[1].empty() && prefetch_in_flight_ < prefetch_depth_) {
+			request = std::move(waiting_[1].front());
+			waiting_[1].pop_front();
+			++prefetch_in_flight_;
+		} else break;
+		++in_flight_;
+		submit(request.release());
+	}
+}
+
+void AsyncIO::submit(request_t* request)
+{
+#ifdef HAVE_IO_URING
+	if (ring_) {
+		const unsigned long long user_data = reinterpret_cast<unsigned long long>(request);
+		const int error = request->buffer_index >= 0 ?
+				ring_->submit(IORING_OP_READ_FIXED, request->fd, request->data.iov_base,
+						request->data.iov_len, request->offset, request->buffer_index, user_data) :
+				ring_->submit(IORING_OP_READV, request->fd, &request->data, 1, request->offset, -1, user_data);
+		if (error) finish(request, -error);
+		return;
+	}
+#endif
+	ready_.push_back(request);
+	ready_cond_.notify_one();
+}
+
+void AsyncIO::finish(request_t* request, ssize_t result)
+{
+	request->result.bytes = result < 0 ? 0 : result;
+	request->result.error = result < 0 ? -result : 0;
+	--in_flight_;
+	if (request->priority == io_priority_t::prefetch) --prefetch_in_flight_;
+	completed_.emplace_back(request);
+	done_cond_.notify_all();
+}
+
+void AsyncIO::complete(const std::vector<std::pair<request_t*, ssize_t>>& requests)
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	for (const auto& request: requests) {
+		finish(request.first, request.second);
+	}
+	schedule();
+}
+
+void AsyncIO::ring_completions()
+{
+#ifdef HAVE_IO_URING
+	std::vector<std::pair<unsigned long long, int>> completions;
+	std::vector<std::pair<request_t*, ssize_t>> requests;
+	bool quit = false;
+	while (!quit) {
+		completions.clear();
+		requests.clear();
+		ring_->wait(completions);
+		for (const auto& completion: completions) {
+			if (completion.first == wake_up_marker) quit = true;
+			else requests.push_back(std::make_pair(reinterpret_cast<request_t*>(completion.first), completion.second));
+		}
+		if (!requests.empty()) complete(requests);
+	}
+#endif
+}
+
+void AsyncIO::pool_worker()
+{
+	while (true) {
+		request_t* request = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			ready_cond_.wait(lock, [this](){return quit_ || !ready_.empty();});
+			if (ready_.empty()) return;
+			request = ready_.front();
+			ready_.pop_front();
+		}
+		char* data = static_cast<char*>(request->data.iov_base);
+		ssize_t total = 0;
+		while (total < static_cast<ssize_t>(request->data.iov_len)) {
+			const ssize_t bytes = pread(request->fd, data + total, request->data.iov_len - total, request->offset + total);
+			if (bytes < 0 && errno == EINTR) continue;
+			if (bytes < 0) total = -errno;
+			if (bytes <= 0) break;
+			total += bytes;
+		}
+		complete({std::make_pair(request, total)});
+	}
+}
+
+size_t AsyncIO::poll(bool block)
+{
+	std::vector<std::unique_ptr<request_t>> completed;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (block) done_cond_.wait(lock, [this](){
+			return !completed_.empty() || (in_flight_ == 0 && waiting_[0].empty() && waiting_[1].empty());
+		});
+		completed.swap(completed_);
+	}
+	for (const auto& request: completed) {
+		if (request->callback) request->callback(request->result);
+	}
+	return completed.size();
+}
+
+void AsyncIO::wait()
+{
+	do {
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_cond_.wait(lock, [this](){
+			return in_flight_ == 0 && waiting_[0].empty() && waiting_[1].empty();
+		});
+	// Callbacks may have issued new reads
+	} while (poll());
+}
+
+size_t AsyncIO::outstanding() const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	return in_flight_ + waiting_[0].size() + waiting_[1].size();
+}
+
+}
@@ -0,0 +1,162 @@
+/*!
+ * @file 		AsyncIO.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		21.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef ASYNCIO_H_
+#define ASYNCIO_H_
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace CAVE {
+
+//! Requests of higher priority are always submitted first
+enum class io_priority_t {
+	//! Data needed for the current frames
+	visible,
+	//! Data that will be needed later
+	prefetch
+};
+
+struct io_result_t {
+	//! Number of bytes read (may be less than requested at the end of file)
+	size_t bytes;
+	//! errno of a failed read, 0 on success
+	int error;
+};
+
+typedef std::function<void(const io_result_t&)> io_callback_t;
+
+//! Buffer from the pool of AsyncIO (registered with the kernel for io_uring)
+struct io_buffer_t {
+	void* data;
+	size_t size;
+	int index;
+};
+
+/*!
+ * Asynchronous reads for loaders that must not stall the frame threads.
+ *
+ * Reads are submitted to io_uring (using the raw system calls, no liburing needed).
+ * Where it is not available (no HAVE_IO_URING, older kernel, disabled by policy),
+ * the reads are done by a small pool of threads with pread, behind the same interface.
+ *
+ * At most queue_depth reads are in flight. Waiting visible requests are submitted
+ * before any prefetch and prefetches never take the whole queue, so a burst
+ * of prefetching can't delay data needed on screen by more than a few reads.
+ *
+ * Completion callbacks run in the thread calling poll() (e.g. once per frame
+ * in the update), so the loaders don't need any synchronization of their own.
+ * The buffers have to stay valid until the callback is called.
+ */
+class AsyncIO {
+public:
+	enum class backend_t {
+		io_uring,
+		thread_pool
+	};
+
+	/*!
+	 * @param queue_depth  Maximal number of reads in flight
+	 * @param buffer_count Number of buffers in the pool
+	 * @param buffer_size  Size of each buffer (aligned for O_DIRECT)
+	 * @param allow_uring  Use io_uring when available (false forces the thread pool)
+	 */
+	AsyncIO(size_t queue_depth = 32, size_t buffer_count = 16, size_t buffer_size = 1 << 20,
+			bool allow_uring = true);
+	//! Waits for the reads in flight, pending requests are dropped without callbacks
+	~AsyncIO() noexcept;
+	AsyncIO(const AsyncIO&) = delete;
+	AsyncIO& operator=(const AsyncIO&) = delete;
+
+	backend_t get_backend() const { return backend_; }
+
+	//! Returns a free buffer from the pool or nullptr if all are in use. Thread safe.
+	io_buffer_t* acquire_buffer();
+	void release_buffer(io_buffer_t* buffer);
+
+	//! Reads @em size bytes from @em offset of @em fd into @em data. Thread safe.
+	void read(int fd, void* data, size_t size, off_t offset, io_priority_t priority,
+			const io_callback_t& callback);
+	//! Reads into a buffer from the pool (without mapping it for every read)
+	void read(int fd, io_buffer_t* buffer, size_t size, off_t offset, io_priority_t priority,
+			const io_callback_t& callback);
+
+	/*!
+	 * Calls callbacks of the finished reads in the current thread
+	 * @param block Wait for at least one finished read (if there are any outstanding)
+	 * @return Number of callbacks called
+	 */
+	size_t poll(bool block = false);
+	//! Blocks until all requests are finished and calls their callbacks
+	void wait();
+	//! Number of requests not completed yet (waiting or in flight)
+	size_t outstanding() const;
+
+private:
+	struct request_t {
+		int fd;
+		iovec data;
+		off_t offset;
+		int buffer_index;
+		io_priority_t priority;
+		io_callback_t callback;
+		io_result_t result;
+	};
+	struct ring_t;
+
+	void enqueue(std::unique_ptr<request_t> request);
+	//! Submits waiting requests while the policy allows it (mutex_ locked)
+	void schedule();
+	void submit(request_t* request);
+	//! Moves a request from flight to completed_ (mutex_ locked)
+	void finish(request_t* request, ssize_t result);
+	//! Finishes requests (result is the number of bytes read or -errno) and submits the next ones
+	void complete(const std::vector<std::pair<request_t*, ssize_t>>& requests);
+	bool setup_ring();
+	void ring_completions();
+	void pool_worker();
+
+	const size_t queue_depth_;
+	const size_t prefetch_depth_;
+	backend_t backend_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable done_cond_;
+	std::deque<std::unique_ptr<request_t>> waiting_[2];
+	std::vector<std::unique_ptr<request_t>> completed_;
+	size_t in_flight_;
+	size_t prefetch_in_flight_;
+	bool quit_;
+
+	std::vector<io_buffer_t> buffers_;
+	std::vector<io_buffer_t*> free_buffers_;
+
+	std::unique_ptr<ring_t> ring_;
+	// Thread pool fallback
+	std::deque<request_t*> ready_;
+	std::condition_variable ready_cond_;
+
+	std::vector<std::thread> threads_;
+};
+
+std::string to_string(AsyncIO::backend_t backend);
+
+}
+
+
+
+#endif /* ASYNCIO_H_ */
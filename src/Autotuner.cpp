@@ -0,0 +1,208 @@
+/*!
+ * @file 		Autotuner.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "Autotuner.h"
+#include "Scene.h"
+#include <GL/glu.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <limits>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace CAVE {
+
+namespace {
+//! Version of the stored format. Changing it invalidates all stored results.
+const int format_version = 2;
+//! Time step used for all trials (60 fps)
+const float trial_time_delta = 1.0f / 60.0f;
+//! Simulated time before the trials, the population should be stable afterwards
+const float warmup_time = 12.0f;
+const size_t update_trials = 30;
+const size_t render_trials = 20;
+const unsigned int trial_seed = 1;
+const size_t chunk_sizes[] = {256, 1024, 4096, 16384};
+const point3 trial_position = {0.0f, 0.0f, -5.0f};
+
+/*!
+ * Runs @em fun @em trials times and returns median of the durations (in seconds)
+ */
+template<class F>
+double median_time(size_t trials, F fun)
+{
+	std::vector<double> times;
+	for (size_t i = 0; i < trials; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		fun();
+		times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+	return times[times.size() / 2];
+}
+
+std::string gl_string(GLenum name)
+{
+	const GLubyte* str = glGetString(name);
+	return str?reinterpret_cast<const char*>(str):"unknown";
+}
+}
+
+Autotuner::Autotuner(const std::string& file, size_t particles_per_second):
+file_(file),particles_per_second_(particles_per_second)
+{
+
+}
+
+std::string Autotuner::signature() const
+{
+	char host[256] = {0};
+	gethostname(host, sizeof(host) - 1);
+	std::ostringstream os;
+	os << "v" << format_version << "|" << host
+			<< "|" << gl_string(GL_VENDOR) << "|" << gl_string(GL_RENDERER) << "|" << gl_string(GL_VERSION)
+			<< "|" << std::thread::hardware_concurrency() << "|" << particles_per_second_;
+	return os.str();
+}
+
+scene_config_t Autotuner::configure(bool force)
+{
+	const std::string sig = signature();
+	scene_config_t config;
+	if (!force && load(sig, config)) {
+		std::cout << "Using stored tuning for " << sig << "\n";
+		return config;
+	}
+	std::cout << "Calibrating for " << sig << "\n";
+	config = calibrate();
+	store(sig, config);
+	return config;
+}
+
+scene_config_t Autotuner::calibrate() const
+{
+	Scene scene(particles_per_second_);
+	scene.set_seed(trial_seed);
+	for (float t = 0.0f; t < warmup_time; t += trial_time_delta) {
+		scene.update(trial_time_delta);
+	}
+
+	scene_config_t best;
+	double best_time = std::numeric_limits<double>::max();
+	const size_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+	// The population is the one of the application (same particles per second)
+	const size_t particles = scene.get_particle_count();
+	for (size_t workers = 1; workers <= max_workers; workers *= 2) {
+		for (size_t chunk_size: chunk_sizes) {
+			scene_config_t config = best;
+			config.workers = workers;
+			config.chunk_size = chunk_size;
+			scene.set_config(config);
+			const double time = median_time(update_trials, [&](){scene.update(trial_time_delta);});
+			if (time < best_time) {
+				best_time = time;
+				best = config;
+			}
+			// Chunks of all the particles or more run inline, so the larger ones would be the same trial
+			if (chunk_size >= particles) break;
+		}
+	}
+	std::cout << "Update: " << best.workers << " workers, chunks of " << best.chunk_size
+			<< " (" << best_time * 1000.0 << " ms for " << scene.get_particle_count() << " particles)\n";
+
+	scene.set_config(best);
+	scene.prepare_details();
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	gluPerspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+
+	best_time = std::numeric_limits<double>::max();
+	scene_config_t best_render = best;
+	for (auto upload: {upload_strategy_t::orphan, upload_strategy_t::subdata, upload_strategy_t::persistent}) {
+		if (upload == upload_strategy_t::persistent && !GLEW_ARB_buffer_storage) continue;
+		// Point sprites don't look the same as the quads, so only the user may choose them
+		scene_config_t config = best;
+		config.upload = upload;
+		config.backend = render_backend_t::geometry_shader;
+		scene.set_config(config);
+		auto render = [&](){
+			glLoadIdentity();
+			scene.render(trial_position, 0.0f);
+			glFinish();
+		};
+		// First frame allocates the buffers
+		render();
+		const double time = median_time(render_trials, render);
+		if (time < best_time) {
+			best_time = time;
+			best_render = config;
+		}
+	}
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	scene.release_details();
+
+	std::cout << "Render: " << to_string(best_render.upload) << " upload, " << to_string(best_render.backend)
+			<< " (" << best_time * 1000.0 << " ms)\n";
+	return best_render;
+}
+
+bool Autotuner::load(const std::string& signature, scene_config_t& config) const
+{
+	std::ifstream file(file_);
+	std::string line;
+	while (std::getline(file, line)) {
+		const size_t tab = line.find('\t');
+		if (tab == std::string::npos || line.substr(0, tab) != signature) continue;
+		std::istringstream is(line.substr(tab + 1));
+		std::string upload, backend;
+		scene_config_t loaded;
+		if (!(is >> loaded.workers >> loaded.chunk_size >> upload >> backend) ||
+				!from_string(upload, loaded.upload) || !from_string(backend, loaded.backend)) {
+			std::cerr << "Ignoring invalid tuning record in " << file_ << "\n";
+			return false;
+		}
+		config = loaded;
+		return true;
+	}
+	return false;
+}
+
+void Autotuner::store(const std::string& signature, const scene_config_t& config) const
+{
+	std::vector<std::string> lines;
+	{
+		std::ifstream file(file_);
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.compare(0, signature.size() + 1, signature + "\t") != 0) {
+				lines.push_back(line);
+			}
+		}
+	}
+	std::ofstream file(file_, std::ios::trunc);
+	for (const auto& line: lines) {
+		file << line << "\n";
+	}
+	file << signature << "\t" << config.workers << " " << config.chunk_size << " "
+			<< to_string(config.upload) << " " << to_string(config.backend) << "\n";
+	if (!file) {
+		std::cerr << "Failed to store tuning results to " << file_ << "\n";
+	}
+}
+
+}
@@ -0,0 +1,51 @@
+/*!
+ * @file 		Autotuner.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef AUTOTUNER_H_
+#define AUTOTUNER_H_
+#include "SceneConfig.h"
+#include <string>
+
+namespace CAVE {
+
+/*!
+ * Finds the fastest scene_config_t for the current machine.
+ *
+ * Short trials of Scene::update and Scene::render are run for every
+ * candidate configuration and the result is stored in a file,
+ * keyed by the host name and the GPU signature.
+ * All methods require current OpenGL context.
+ */
+class Autotuner {
+public:
+	Autotuner(const std::string& file, size_t particles_per_second);
+
+	/*!
+	 * Returns stored configuration for this machine or runs the calibration
+	 * if there's none (or if @em force is true).
+	 */
+	scene_config_t configure(bool force);
+	scene_config_t calibrate() const;
+
+	//! Identification of host and GPU the results are valid for
+	std::string signature() const;
+private:
+	bool load(const std::string& signature, scene_config_t& config) const;
+	void store(const std::string& signature, const scene_config_t& config) const;
+
+	std::string file_;
+	size_t particles_per_second_;
+};
+
+}
+
+
+
+#endif /* AUTOTUNER_H_ */
@@ -0,0 +1,424 @@
+/*!
+ * @file 		Behaviour.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		9.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "Behaviour.h"
+#include <algorithm>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+namespace CAVE {
+
+namespace {
+
+const struct {
+	const char* name;
+	size_t offset;
+} fields[] = {
+		{"position.x",	offsetof(Particle, position) + offsetof(point3, x)},
+		{"position.y",	offsetof(Particle, position) + offsetof(point3, y)},
+		{"position.z",	offsetof(Particle, position) + offsetof(point3, z)},
+		{"direction.x",	offsetof(Particle, direction) + offsetof(point3, x)},
+		{"direction.y",	offsetof(Particle, direction) + offsetof(point3, y)},
+		{"direction.z",	offsetof(Particle, direction) + offsetof(point3, z)},
+		{"life",		offsetof(Particle, life)},
+};
+
+//! Deepest stack of the interpreter
+const size_t max_stack = 32;
+
+const std::string update_symbol = "cave_behaviour_update";
+//! sizeof of the particle in the generated code, checked when it's loaded
+const std::string size_symbol = "cave_behaviour_particle_size";
+
+//! The layout has to match Particle
+const std::string native_header = R"XXX(// Generated from a particle behaviour definition
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+namespace {
+struct point3 {
+	float x;
+	float y;
+	float z;
+};
+struct particle_t {
+	point3 position;
+	point3 direction;
+	float life;
+};
+}
+
+extern "C" const std::size_t cave_behaviour_particle_size = sizeof(particle_t);
+
+extern "C" void cave_behaviour_update(void* particles, std::size_t count, float time_delta)
+{
+	particle_t* first = static_cast<particle_t*>(particles);
+	for (particle_t* p = first; p != first + count; ++p) {
+)XXX";
+
+const std::string native_footer = R"XXX(	}
+}
+)XXX";
+
+const unsigned int verification_seed = 1;
+
+inline float& field_at(Particle& particle, size_t offset)
+{
+	return *reinterpret_cast<float*>(reinterpret_cast<char*>(&particle) + offset);
+}
+
+//! C++ literal of exactly the same float
+std::string to_literal(float value)
+{
+	if (std::isinf(value)) return "HUGE_VALF";
+	char text[32];
+	std::snprintf(text, sizeof(text), "%.9g", value);
+	std::string literal = text;
+	if (literal.find_first_of(".e") == std::string::npos) literal += ".0";
+	return literal + "f";
+}
+}
+
+/*!
+ * Recursive descent parser of one line, emitting the bytecode
+ * and the equivalent C++ statement at once.
+ */
+class Behaviour::Parser {
+public:
+	Parser(Behaviour& behaviour, const std::string& line, size_t number):
+	behaviour_(behaviour),line_(line),number_(number),pos_(0),depth_(0) {}
+	void parse()
+	{
+		skip_space();
+		if (pos_ == line_.size()) return;
+		const std::string target = identifier();
+		const size_t offset = field(target);
+		const std::string native_target = "p->" + target;
+		std::string value;
+		if (accept("=")) {
+			value = expression();
+		} else {
+			static const struct {
+				const char* token;
+				op_t op;
+				const char* native;
+			} assignments[] = {
+					{"+=", op_t::add, " + "},
+					{"-=", op_t::subtract, " - "},
+					{"*=", op_t::multiply, " * "},
+					{"/=", op_t::divide, " / "},
+			};
+			const auto assignment = std::find_if(std::begin(assignments), std::end(assignments),
+					[this](decltype(assignments[0]) a){return accept(a.token);});
+			if (assignment == std::end(assignments)) error("expected assignment");
+			emit(op_t::load, offset);
+			const std::string operand = expression();
+			emit(assignment->op);
+			value = "(" + native_target + assignment->native + operand + ")";
+		}
+		if (pos_ != line_.size()) error("unexpected '" + line_.substr(pos_) + "'");
+		emit(op_t::store, offset);
+		behaviour_.statements_.push_back(native_target + " = " + value + ";");
+	}
+private:
+	std::string expression()
+	{
+		std::string value = term();
+		while (true) {
+			if (accept("+")) {
+				value = "(" + value + " + " + term() + ")";
+				emit(op_t::add);
+			} else if (accept("-")) {
+				value = "(" + value + " - " + term() + ")";
+				emit(op_t::subtract);
+			} else {
+				return value;
+			}
+		}
+	}
+
+	std::string term()
+	{
+		std::string value = unary();
+		while (true) {
+			if (accept("*")) {
+				value = "(" + value + " * " + unary() + ")";
+				emit(op_t::multiply);
+			} else if (accept("/")) {
+				value = "(" + value + " / " + unary() + ")";
+				emit(op_t::divide);
+			} else {
+				return value;
+			}
+		}
+	}
+
+	std::string unary()
+	{
+		if (!accept("-")) return primary();
+		const std::string value = "(-" + unary() + ")";
+		emit(op_t::negate);
+		return value;
+	}
+
+	std::string primary()
+	{
+		if (accept("(")) {
+			const std::string value = expression();
+			expect(")");
+			return value;
+		}
+		if (pos_ < line_.size() && (std::isdigit(line_[pos_]) || line_[pos_] == '.')) {
+			const char* begin = line_.c_str() + pos_;
+			char* end = nullptr;
+			const float value = std::strtof(begin, &end);
+			if (end == begin) error("invalid number");
+			pos_ += end - begin;
+			skip_space();
+			emit(op_t::constant, 0, value);
+			return to_literal(value);
+		}
+		const std::string name = identifier();
+		if (name == "time_delta") {
+			emit(op_t::time_delta);
+			return name;
+		}
+		static const struct {
+			const char* name;
+			op_t op;
+			size_t arguments;
+		} functions[] = {
+				{"sin", op_t::sin, 1},
+				{"cos", op_t::cos, 1},
+				{"sqrt", op_t::sqrt, 1},
+				{"abs", op_t::abs, 1},
+				{"min", op_t::min, 2},
+				{"max", op_t::max, 2},
+		};
+		for (const auto& function: functions) {
+			if (name != function.name) continue;
+			expect("(");
+			std::string value = "std::" + name + "(" + expression();
+			for (size_t i = 1; i < function.arguments; ++i) {
+				expect(",");
+				value += ", " + expression();
+			}
+			expect(")");
+			emit(function.op);
+			return value + ")";
+		}
+		emit(op_t::load, field(name));
+		return "p->" + name;
+	}
+
+	size_t field(const std::string& name) const
+	{
+		for (const auto& f: fields) {
+			if (name == f.name) return f.offset;
+		}
+		error("unknown name '" + name + "'");
+	}
+
+	std::string identifier()
+	{
+		const size_t begin = pos_;
+		while (pos_ < line_.size() && (std::isalnum(line_[pos_]) || line_[pos_] == '_' || line_[pos_] == '.')) {
+			++pos_;
+		}
+		if (begin == pos_) error("expected a name");
+		const std::string name = line_.substr(begin, pos_ - begin);
+		skip_space();
+		return name;
+	}
+
+	bool accept(const std::string& token)
+	{
+		if (line_.compare(pos_, token.size(), token) != 0) return false;
+		pos_ += token.size();
+		skip_space();
+		return true;
+	}
+
+	void expect(const std::string& token)
+	{
+		if (!accept(token)) error("expected '" + token + "'");
+	}
+
+	void skip_space()
+	{
+		while (pos_ < line_.size() && std::isspace(line_[pos_])) ++pos_;
+	}
+
+	void emit(op_t op, size_t offset = 0, float value = 0.0f)
+	{
+		switch (op) {
+			case op_t::load:
+			case op_t::time_delta:
+			case op_t::constant:
+				if (++depth_ > max_stack) error("expression is too deep");
+				break;
+			case op_t::store:
+			case op_t::add:
+			case op_t::subtract:
+			case op_t::multiply:
+			case op_t::divide:
+			case op_t::min:
+			case op_t::max:
+				--depth_;
+				break;
+			default:
+				break;
+		}
+		behaviour_.code_.push_back({op, offset, value});
+	}
+
+	[[noreturn]] void error(const std::string& message) const
+	{
+		throw std::runtime_error("Behaviour line " + std::to_string(number_) + ": " + message);
+	}
+
+	Behaviour& behaviour_;
+	const std::string line_;
+	const size_t number_;
+	size_t pos_;
+	//! Depth of the interpreter stack after the emitted code
+	size_t depth_;
+};
+
+Behaviour::Behaviour(const std::string& definition):
+native_(nullptr)
+{
+	std::istringstream is(definition);
+	std::string line;
+	for (size_t number = 1; std::getline(is, line); ++number) {
+		Parser(*this, line.substr(0, line.find('#')), number).parse();
+	}
+}
+
+std::shared_ptr<Behaviour> Behaviour::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file) throw std::runtime_error("Failed to open behaviour " + path);
+	std::ostringstream definition;
+	definition << file.rdbuf();
+	return std::make_shared<Behaviour>(definition.str());
+}
+
+void Behaviour::update(Particle* particles, size_t count, float time_delta) const
+{
+	if (native_) native_(particles, count, time_delta);
+	else interpret(particles, count, time_delta);
+}
+
+void Behaviour::interpret(Particle* particles, size_t count, float time_delta) const
+{
+	float stack[max_stack];
+	for (Particle* p = particles; p != particles + count; ++p) {
+		// top points to the next free slot
+		float* top = stack;
+		for (const auto& instruction: code_) {
+			switch (instruction.op) {
+				case op_t::load: *top++ = field_at(*p, instruction.field); break;
+				case op_t::time_delta: *top++ = time_delta; break;
+				case op_t::constant: *top++ = instruction.value; break;
+				case op_t::store: field_at(*p, instruction.field) = *--top; break;
+				case op_t::add: --top; top[-1] = top[-1] + top[0]; break;
+				case op_t::subtract: --top; top[-1] = top[-1] - top[0]; break;
+				case op_t::multiply: --top; top[-1] = top[-1] * top[0]; break;
+				case op_t::divide: --top; top[-1] = top[-1] / top[0]; break;
+				case op_t::negate: top[-1] = -top[-1]; break;
+				case op_t::sin: top[-1] = std::sin(top[-1]); break;
+				case op_t::cos: top[-1] = std::cos(top[-1]); break;
+				case op_t::sqrt: top[-1] = std::sqrt(top[-1]); break;
+				case op_t::abs: top[-1] = std::abs(top[-1]); break;
+				case op_t::min: --top; top[-1] = std::min(top[-1], top[0]); break;
+				case op_t::max: --top; top[-1] = std::max(top[-1], top[0]); break;
+			}
+		}
+	}
+}
+
+std::string Behaviour::to_cpp() const
+{
+	std::string source = native_header;
+	for (const auto& statement: statements_) {
+		source += "\t\t" + statement + "\n";
+	}
+	return source + native_footer;
+}
+
+void Behaviour::compile(const std::string& cache_dir)
+{
+	cache_dir_ = cache_dir.empty() ? NativeKernel::default_cache_dir() : cache_dir;
+}
+
+void Behaviour::poll()
+{
+	if (cache_dir_.empty()) return;
+	if (!kernel_) {
+		kernel_.reset(new NativeKernel(to_cpp(), cache_dir_));
+		return;
+	}
+	if (kernel_->failed()) {
+		cache_dir_.clear();
+		return;
+	}
+	if (!kernel_->ready()) return;
+	cache_dir_.clear();
+	const size_t* size = static_cast<const size_t*>(kernel_->load(size_symbol));
+	native_kernel_t kernel = reinterpret_cast<native_kernel_t>(kernel_->load(update_symbol));
+	if (!size || *size != sizeof(Particle) || !kernel) {
+		std::cerr << "Native behaviour " << kernel_->get_path() << " doesn't match the particles\n";
+		return;
+	}
+	if (!verify(kernel)) {
+		std::cerr << "Native behaviour " << kernel_->get_path() << " differs from the interpreter, not using it\n";
+		return;
+	}
+	native_ = kernel;
+	std::cout << "Native behaviour loaded from " << kernel_->get_path() << "\n";
+}
+
+bool Behaviour::is_compiling() const
+{
+	return !cache_dir_.empty();
+}
+
+bool Behaviour::verify(native_kernel_t kernel) const
+{
+	std::mt19937 generator(verification_seed);
+	std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> direction(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> time_delta(0.0f, 0.1f);
+	const size_t count = 4096;
+	const size_t steps = 10;
+	std::vector<Particle> reference;
+	for (size_t i = 0; i < count; ++i) {
+		reference.emplace_back(point3{position(generator), position(generator), position(generator)},
+				point3{direction(generator), direction(generator), direction(generator)});
+	}
+	std::vector<Particle> tested = reference;
+	for (size_t step = 0; step < steps; ++step) {
+		const float delta = time_delta(generator);
+		interpret(reference.data(), count, delta);
+		kernel(tested.data(), count, delta);
+	}
+	return std::memcmp(reference.data(), tested.data(), count * sizeof(Particle)) == 0;
+}
+
+}
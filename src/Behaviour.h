@@ -0,0 +1,116 @@
+/*!
+ * @file 		Behaviour.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		9.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef BEHAVIOUR_H_
+#define BEHAVIOUR_H_
+#include "Particle.h"
+#include "NativeKernel.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+namespace CAVE {
+
+/*!
+ * Particle update defined by data instead of Particle::update.
+ *
+ * The definition has one assignment per line, executed in order for every particle.
+ * The fields are position.x, position.y, position.z, direction.x, direction.y,
+ * direction.z and life, the expressions may use them, time_delta, numbers,
+ * + - * / and the functions sin, cos, sqrt, abs, min and max. Everything after # is a comment.
+ * Particle::update is then:
+ * @code
+ * position.x += time_delta * direction.x
+ * position.y += time_delta * direction.y
+ * position.z += time_delta * direction.z
+ * direction.x = (1 - time_delta * 0.2) * direction.x + time_delta * 0
+ * direction.y = (1 - time_delta * 0.2) * direction.y + time_delta * -1
+ * direction.z = (1 - time_delta * 0.2) * direction.z + time_delta * 0
+ * life -= time_delta
+ * @endcode
+ *
+ * The definition runs in a bytecode interpreter until a native kernel,
+ * generated from it as C++ and compiled in the background (NativeKernel), is ready.
+ * The generated code keeps the order of the operations and it is compiled without FMA
+ * contraction, so both give bit-identical results. It is checked against the interpreter
+ * before it is used.
+ */
+class Behaviour {
+public:
+	//! Parses the definition, throws std::runtime_error with the line on errors
+	explicit Behaviour(const std::string& definition);
+	static std::shared_ptr<Behaviour> load(const std::string& path);
+	/*!
+	 * Updates the particles, with the native kernel if it is loaded.
+	 * Can be called from more threads at once (with distinct particles).
+	 */
+	void update(Particle* particles, size_t count, float time_delta) const;
+	//! Updates the particles with the interpreter
+	void interpret(Particle* particles, size_t count, float time_delta) const;
+	//! Standalone C++ source of the native kernel
+	std::string to_cpp() const;
+	/*!
+	 * Requests the native kernel, compiled into @em cache_dir.
+	 * The compiler starts with the first poll(), so it runs in the process that updates the scene.
+	 */
+	void compile(const std::string& cache_dir);
+	/*!
+	 * Starts the compilation, or switches to the native kernel when it's ready.
+	 * Called at the frame boundary, not concurrently with update().
+	 */
+	void poll();
+	bool is_native() const { return native_ != nullptr; }
+	//! Native kernel was requested and it can't be used (yet)
+	bool is_compiling() const;
+private:
+	enum class op_t {
+		load,
+		time_delta,
+		constant,
+		store,
+		add,
+		subtract,
+		multiply,
+		divide,
+		negate,
+		sin,
+		cos,
+		sqrt,
+		abs,
+		min,
+		max
+	};
+	struct instruction_t {
+		op_t op;
+		//! Field for load and store
+		size_t field;
+		float value;
+	};
+	typedef void (*native_kernel_t)(void* particles, size_t count, float time_delta);
+	class Parser;
+
+	//! Compares the native kernel with the interpreter on random particles
+	bool verify(native_kernel_t kernel) const;
+
+	std::vector<instruction_t> code_;
+	//! Statements of the native kernel
+	std::vector<std::string> statements_;
+	//! Cache of the requested native kernel, cleared once it's loaded or failed
+	std::string cache_dir_;
+	std::unique_ptr<NativeKernel> kernel_;
+	native_kernel_t native_;
+};
+
+}
+
+
+
+#endif /* BEHAVIOUR_H_ */
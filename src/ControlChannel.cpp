@@ -0,0 +1,130 @@
+/*!
+ * @file 		ControlChannel.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		19.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "ControlChannel.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+namespace CAVE {
+
+namespace {
+//! Longer lines are dropped, so a broken client can't exhaust memory
+const size_t max_line = 4096;
+}
+
+ControlChannel::ControlChannel(const std::string& path):
+path_(path),socket_(-1),stdin_flags_(-1)
+{
+	if (path_ == "-") {
+		stdin_flags_ = fcntl(STDIN_FILENO, F_GETFL);
+		fcntl(STDIN_FILENO, F_SETFL, stdin_flags_ | O_NONBLOCK);
+		clients_[STDIN_FILENO];
+		return;
+	}
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path_.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error("Control socket path too long: " + path_);
+	}
+	std::strcpy(address.sun_path, path_.c_str());
+	socket_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (socket_ < 0) {
+		throw std::runtime_error(std::string("Failed to create control socket: ") + std::strerror(errno));
+	}
+	unlink(path_.c_str());
+	if (bind(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 ||
+			listen(socket_, 4) < 0) {
+		const std::string error = std::strerror(errno);
+		close(socket_);
+		throw std::runtime_error("Failed to listen on " + path_ + ": " + error);
+	}
+}
+
+ControlChannel::~ControlChannel() noexcept
+{
+	if (socket_ < 0) {
+		fcntl(STDIN_FILENO, F_SETFL, stdin_flags_);
+		return;
+	}
+	for (const auto& client: clients_) {
+		close(client.first);
+	}
+	close(socket_);
+	unlink(path_.c_str());
+}
+
+void ControlChannel::poll()
+{
+	if (socket_ >= 0) {
+		int fd;
+		while ((fd = accept4(socket_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+			clients_[fd];
+		}
+	}
+	// read_client() may remove the client
+	std::vector<int> fds;
+	for (const auto& client: clients_) {
+		fds.push_back(client.first);
+	}
+	for (int fd: fds) {
+		read_client(fd);
+	}
+}
+
+void ControlChannel::read_client(int fd)
+{
+	std::string& pending = clients_[fd];
+	char buffer[1024];
+	ssize_t bytes;
+	while ((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+		pending.append(buffer, bytes);
+		size_t end;
+		while ((end = pending.find('\n')) != std::string::npos) {
+			std::string line = pending.substr(0, end);
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty()) commands_.push_back(control_command_t{fd, line});
+			pending.erase(0, end + 1);
+		}
+		if (pending.size() > max_line) pending.clear();
+	}
+	const bool closed = bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+	if (closed && fd != STDIN_FILENO) {
+		close(fd);
+		clients_.erase(fd);
+	}
+}
+
+bool ControlChannel::next(control_command_t& command)
+{
+	if (commands_.empty()) return false;
+	command = commands_.front();
+	commands_.pop_front();
+	return true;
+}
+
+void ControlChannel::reply(int client, const std::string& text)
+{
+	if (client == STDIN_FILENO) {
+		std::cout << text << std::endl;
+		return;
+	}
+	// The client may be gone already
+	if (!clients_.count(client)) return;
+	const std::string line = text + "\n";
+	send(client, line.data(), line.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+}
@@ -0,0 +1,69 @@
+/*!
+ * @file 		ControlChannel.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		19.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef CONTROLCHANNEL_H_
+#define CONTROLCHANNEL_H_
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+namespace CAVE {
+
+//! A line received from a client
+struct control_command_t {
+	//! Client to reply to
+	int client;
+	std::string line;
+};
+
+/*!
+ * Local line based control interface, either a UNIX domain socket
+ * (e.g. used with socat - UNIX-CONNECT:path) or stdin.
+ *
+ * Never blocks, the commands are collected in poll() (once per frame)
+ * and taken one by one with next(), so the caller decides how many
+ * of them it handles in a frame.
+ */
+class ControlChannel {
+public:
+	/*!
+	 * @param path Socket to create (an existing file is replaced), "-" reads stdin instead.
+	 * Throws std::runtime_error if the socket can't be created.
+	 */
+	ControlChannel(const std::string& path);
+	~ControlChannel() noexcept;
+	ControlChannel(const ControlChannel&) = delete;
+	ControlChannel& operator=(const ControlChannel&) = delete;
+
+	//! Accepts new clients and reads all available input
+	void poll();
+	//! Takes the oldest received command, returns false if there is none
+	bool next(control_command_t& command);
+	//! Sends a line to @em client (stdout for stdin)
+	void reply(int client, const std::string& text);
+private:
+	void read_client(int fd);
+
+	const std::string path_;
+	//! Listening socket, -1 when reading stdin
+	int socket_;
+	//! Original flags of stdin, restored in the destructor
+	int stdin_flags_;
+	//! Connected clients (or stdin) and their incomplete lines
+	std::map<int, std::string> clients_;
+	std::deque<control_command_t> commands_;
+};
+
+}
+
+
+
+#endif /* CONTROLCHANNEL_H_ */
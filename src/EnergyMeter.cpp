@@ -0,0 +1,173 @@
+/*!
+ * @file 		EnergyMeter.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		14.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "EnergyMeter.h"
+#include "FrameClock.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <cstdlib>
+#include <iomanip>
+
+namespace CAVE {
+
+namespace {
+//! Top level domains only (intel-rapl:0, not intel-rapl:0:1)
+bool is_top_level_domain(const std::string& entry)
+{
+	const std::string prefix = "intel-rapl:";
+	return entry.compare(0, prefix.size(), prefix) == 0 &&
+			entry.find(':', prefix.size()) == std::string::npos;
+}
+
+std::string read_line(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+}
+
+EnergyMeter::EnergyMeter(const std::string& powercap_dir):
+start_time_(FrameClock::now()),frame_started_(false),frame_start_(0.0),frames_(0),frame_energy_(0.0),particle_updates_(0)
+{
+	DIR* dir = opendir(powercap_dir.c_str());
+	if (!dir) return;
+	while (dirent* entry = readdir(dir)) {
+		const std::string name = entry->d_name;
+		if (!is_top_level_domain(name)) continue;
+		const std::string path = powercap_dir + "/" + name + "/";
+		domain_t domain;
+		domain.name = read_line(path + "name");
+		// psys covers the packages as well
+		if (domain.name.compare(0, 7, "package") != 0) continue;
+		domain.max_range = std::strtoull(read_line(path + "max_energy_range_uj").c_str(), nullptr, 10);
+		domain.fd = open((path + "energy_uj").c_str(), O_RDONLY);
+		if (domain.fd < 0) continue;
+		if (!read_counter(domain.fd, domain.last)) {
+			close(domain.fd);
+			continue;
+		}
+		domain.total = 0.0;
+		domains_.push_back(domain);
+	}
+	closedir(dir);
+}
+
+EnergyMeter::~EnergyMeter() noexcept
+{
+	for (const auto& domain: domains_) {
+		close(domain.fd);
+	}
+}
+
+std::vector<std::string> EnergyMeter::domains() const
+{
+	std::vector<std::string> names;
+	for (const auto& domain: domains_) {
+		names.push_back(domain.name);
+	}
+	return names;
+}
+
+bool EnergyMeter::read_counter(int fd, unsigned long long& value) const
+{
+	char buffer[32];
+	// sysfs generates the content again on every read from the start
+	const ssize_t size = pread(fd, buffer, sizeof(buffer) - 1, 0);
+	if (size <= 0) return false;
+	buffer[size] = 0;
+	value = std::strtoull(buffer, nullptr, 10);
+	return true;
+}
+
+double EnergyMeter::read()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	double total = 0.0;
+	for (auto& domain: domains_) {
+		unsigned long long value = 0;
+		if (read_counter(domain.fd, value)) {
+			const unsigned long long delta = value >= domain.last ?
+					value - domain.last : domain.max_range - domain.last + value;
+			domain.total += delta * 1e-6;
+			domain.last = value;
+		}
+		total += domain.total;
+	}
+	return total;
+}
+
+void EnergyMeter::end_frame(size_t particle_updates)
+{
+	if (!available()) return;
+	const double energy = read();
+	std::unique_lock<std::mutex> _(mutex_);
+	// The first call only starts the first frame
+	if (frame_started_) {
+		++frames_;
+		frame_energy_ += energy - frame_start_;
+		particle_updates_ += particle_updates;
+	} else {
+		frame_started_ = true;
+		start_time_ = FrameClock::now();
+		phases_.clear();
+	}
+	frame_start_ = energy;
+}
+
+void EnergyMeter::add_phase(const std::string& phase, double energy)
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	phases_[phase] += energy;
+}
+
+void EnergyMeter::report(std::ostream& os) const
+{
+	if (!available()) {
+		os << "Energy counters (RAPL) not available\n";
+		return;
+	}
+	std::unique_lock<std::mutex> _(mutex_);
+	if (!frames_) return;
+	const std::streamsize precision = os.precision();
+	const double elapsed = FrameClock::now() - start_time_;
+	os << "Energy of";
+	for (const auto& domain: domains_) {
+		os << " " << domain.name;
+	}
+	os << ": " << std::fixed << std::setprecision(3) << frame_energy_ / frames_ * 1000.0 << " mJ per frame";
+	if (elapsed > 0.0) os << " (" << std::setprecision(1) << frame_energy_ / elapsed << " W)";
+	if (particle_updates_) {
+		os << ", " << std::setprecision(3) << frame_energy_ / particle_updates_ * 1e6
+				<< " J per million particle updates";
+	}
+	os << "\n";
+	for (const auto& phase: phases_) {
+		os << "  " << phase.first << ": " << std::setprecision(3) << phase.second / frames_ * 1000.0
+				<< " mJ per frame (" << std::setprecision(1) << 100.0 * phase.second / frame_energy_ << " %)\n";
+	}
+	os.unsetf(std::ios::floatfield);
+	os.precision(precision);
+}
+
+EnergyMeter::Scope::Scope(EnergyMeter* meter, const char* phase):
+meter_(meter && meter->available() ? meter : nullptr),phase_(phase),start_(meter_ ? meter_->read() : 0.0)
+{
+
+}
+
+EnergyMeter::Scope::~Scope() noexcept
+{
+	if (meter_) meter_->add_phase(phase_, meter_->read() - start_);
+}
+
+}
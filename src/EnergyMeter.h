@@ -0,0 +1,105 @@
+/*!
+ * @file 		EnergyMeter.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		14.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef ENERGYMETER_H_
+#define ENERGYMETER_H_
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+namespace CAVE {
+
+/*!
+ * Energy accounting from the RAPL counters exposed by Linux powercap
+ * (/sys/class/powercap/intel-rapl:N/energy_uj, also used for AMD CPUs).
+ *
+ * Only the package domains are summed, their subdomains (cores, uncore, dram)
+ * and psys would count the same energy twice. The counters cover the whole
+ * package, not just this process, and they are updated roughly every
+ * millisecond, so energy of short phases is meaningful only as an average
+ * over many frames.
+ *
+ * When no counter is readable (no RAPL, or energy_uj readable only by root),
+ * available() returns false, all the readings are zero and report()
+ * says so. Nothing else changes.
+ */
+class EnergyMeter {
+public:
+	EnergyMeter(const std::string& powercap_dir = "/sys/class/powercap");
+	~EnergyMeter() noexcept;
+	EnergyMeter(const EnergyMeter&) = delete;
+	EnergyMeter& operator=(const EnergyMeter&) = delete;
+
+	bool available() const { return !domains_.empty(); }
+	//! Names of the measured domains (e.g. package-0)
+	std::vector<std::string> domains() const;
+	//! Energy consumed since construction (J). Thread safe.
+	double read();
+
+	/*!
+	 * Accounts the energy of the frame that just ended (call once per frame, from one thread)
+	 * @param particle_updates Number of particles updated in the frame
+	 */
+	void end_frame(size_t particle_updates);
+	//! Adds energy to a phase of the frame
+	void add_phase(const std::string& phase, double energy);
+	//! Prints energy per frame, per phase and per million particle updates
+	void report(std::ostream& os) const;
+
+	/*!
+	 * Accounts the energy from construction to destruction to a phase.
+	 * Does nothing when constructed with null meter.
+	 * Scopes running concurrently in several threads would count the same energy
+	 * several times, so the phases should be measured in one thread only.
+	 */
+	class Scope {
+	public:
+		Scope(EnergyMeter* meter, const char* phase);
+		~Scope() noexcept;
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		EnergyMeter* meter_;
+		const char* phase_;
+		double start_;
+	};
+
+private:
+	struct domain_t {
+		std::string name;
+		int fd;
+		//! The counter wraps around at this value (in uJ)
+		unsigned long long max_range;
+		unsigned long long last;
+		double total;
+	};
+	bool read_counter(int fd, unsigned long long& value) const;
+
+	mutable std::mutex mutex_;
+	std::vector<domain_t> domains_;
+	double start_time_;
+
+	// Frame accounting
+	bool frame_started_;
+	//! Value of read() at the end of the last frame
+	double frame_start_;
+	size_t frames_;
+	double frame_energy_;
+	size_t particle_updates_;
+	std::map<std::string, double> phases_;
+};
+
+}
+
+
+
+#endif /* ENERGYMETER_H_ */
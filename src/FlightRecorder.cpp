@@ -0,0 +1,167 @@
+/*!
+ * @file 		FlightRecorder.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		31.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "FlightRecorder.h"
+#include "FrameClock.h"
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <ctime>
+
+namespace CAVE {
+
+namespace {
+//! Minimal time between two dumps (s), so a bad minute doesn't fill the disk
+const double min_dump_interval = 30.0;
+/*!
+ * Part of every ring skipped in the dump. Writers don't stop during the copy,
+ * so the oldest events may be overwritten while being read.
+ */
+const size_t unsafe_fraction = 8;
+
+std::atomic<size_t> recorder_ids(0);
+
+//! Ring of the current thread in the most recently used recorder
+struct ring_cache_t {
+	size_t recorder;
+	void* ring;
+};
+thread_local ring_cache_t ring_cache = {0, nullptr};
+
+struct dumped_event_t {
+	const char* name;
+	double start;
+	float duration;
+	bool is_counter;
+	long long value;
+	size_t thread;
+};
+}
+
+FlightRecorder::Span::Span(FlightRecorder* recorder, const char* name, long long value):
+recorder_(recorder),name_(name),value_(value),start_(recorder ? FrameClock::now() : 0.0)
+{
+
+}
+
+FlightRecorder::Span::~Span() noexcept
+{
+	if (recorder_) recorder_->record(name_, start_, FrameClock::now(), value_);
+}
+
+FlightRecorder::FlightRecorder(const std::string& directory, double deadline, double window, size_t events_per_thread):
+directory_(directory),deadline_(deadline),window_(window),events_per_thread_(std::max<size_t>(events_per_thread, 16)),
+id_(++recorder_ids),trigger_(0.0),last_dump_(-min_dump_interval),dumps_(0)
+{
+
+}
+
+FlightRecorder::~FlightRecorder() noexcept
+{
+	if (writer_.joinable()) writer_.join();
+}
+
+void FlightRecorder::record(const char* name, double start, double end, long long value)
+{
+	push({name, start, static_cast<float>(end - start), false, value});
+}
+
+void FlightRecorder::counter(const char* name, long long value)
+{
+	push({name, FrameClock::now(), 0.0f, true, value});
+}
+
+void FlightRecorder::push(const event_t& event)
+{
+	ring_t& ring = get_ring();
+	const size_t index = ring.next.load(std::memory_order_relaxed);
+	ring.events[index % ring.events.size()] = event;
+	ring.next.store(index + 1, std::memory_order_release);
+}
+
+FlightRecorder::ring_t& FlightRecorder::get_ring()
+{
+	if (ring_cache.recorder == id_) return *static_cast<ring_t*>(ring_cache.ring);
+	std::unique_lock<std::mutex> _(mutex_);
+	auto& ring = rings_[std::this_thread::get_id()];
+	if (!ring) ring.reset(new ring_t(events_per_thread_, rings_.size() - 1));
+	ring_cache = {id_, ring.get()};
+	return *ring;
+}
+
+void FlightRecorder::end_frame(double start, double end)
+{
+	record("frame", start, end);
+	if (!trigger_ && end - start > deadline_ && end - last_dump_ > min_dump_interval) {
+		trigger_ = end;
+	}
+	// The second half of the window is recorded after the miss
+	if (trigger_ && end >= trigger_ + window_ / 2.0) {
+		dump(trigger_ - window_ / 2.0, end);
+		last_dump_ = end;
+		trigger_ = 0.0;
+	}
+}
+
+void FlightRecorder::dump(double from, double to)
+{
+	// Copy of the rings is quick, formatting and writing is left to the background thread
+	auto events = std::make_shared<std::vector<dumped_event_t>>();
+	{
+		std::unique_lock<std::mutex> _(mutex_);
+		for (const auto& it: rings_) {
+			const ring_t& ring = *it.second;
+			const size_t size = ring.events.size();
+			const size_t next = ring.next.load(std::memory_order_acquire);
+			const size_t first = next > size ? next - size + size / unsafe_fraction : 0;
+			for (size_t i = first; i < next; ++i) {
+				const event_t& e = ring.events[i % size];
+				if (e.start + e.duration < from || e.start > to) continue;
+				events->push_back({e.name, e.start, e.duration, e.is_counter, e.value, ring.index});
+			}
+		}
+	}
+	std::ostringstream name;
+	char host[256] = {0};
+	gethostname(host, sizeof(host) - 1);
+	// Display processes of one host (multi-process CAVElib) may dump in the same second
+	name << directory_ << "/flight-" << host << "-" << ::getpid() << "-" << std::time(nullptr) << ".json";
+	const std::string path = name.str();
+	const double origin = from;
+
+	if (writer_.joinable()) writer_.join();
+	writer_ = std::thread([this, events, path, origin](){
+		std::ofstream file(path);
+		file << "{\"traceEvents\": [\n" << std::fixed << std::setprecision(1);
+		for (size_t i = 0; i < events->size(); ++i) {
+			const dumped_event_t& e = (*events)[i];
+			file << "  {\"name\": \"" << e.name << "\", \"pid\": 0, \"tid\": " << e.thread
+					<< ", \"ts\": " << (e.start - origin) * 1e6;
+			if (e.is_counter) {
+				file << ", \"ph\": \"C\", \"args\": {\"value\": " << e.value << "}}";
+			} else {
+				file << ", \"ph\": \"X\", \"dur\": " << e.duration * 1e6
+						<< ", \"args\": {\"value\": " << e.value << "}}";
+			}
+			file << (i + 1 < events->size() ? ",\n" : "\n");
+		}
+		file << "]}\n";
+		if (!file) {
+			std::cerr << "Failed to write flight recorder dump " << path << "\n";
+			return;
+		}
+		++dumps_;
+		std::cerr << "Deadline missed, flight recorder dump written to " << path << "\n";
+	});
+}
+
+}
@@ -0,0 +1,120 @@
+/*!
+ * @file 		FlightRecorder.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		31.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef FLIGHTRECORDER_H_
+#define FLIGHTRECORDER_H_
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+namespace CAVE {
+
+/*!
+ * Always-on recorder of the last few seconds of events of every thread.
+ *
+ * Every thread writes into its own ring of fixed size, so recording
+ * is just a few stores (no locks, no allocations). When a frame misses
+ * its deadline, the recorder waits for the second half of the window
+ * and writes all rings to a file in Chrome trace format (chrome://tracing).
+ * The file is written by a background thread.
+ *
+ * Event names have to be string literals (only the pointers are stored).
+ */
+class FlightRecorder {
+public:
+	/*!
+	 * @param directory Where to write the dumps
+	 * @param deadline  Frame time considered a miss (s)
+	 * @param window    Length of the dumped window around the miss (s)
+	 * @param events_per_thread Size of the ring of every thread
+	 */
+	FlightRecorder(const std::string& directory, double deadline, double window = 4.0,
+			size_t events_per_thread = 16384);
+	~FlightRecorder() noexcept;
+	FlightRecorder(const FlightRecorder&) = delete;
+	FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+	//! Records a span (@em end == @em start for instant events)
+	void record(const char* name, double start, double end, long long value = 0);
+	//! Records a value at the current time
+	void counter(const char* name, long long value);
+	/*!
+	 * Records the frame and checks its deadline (call once per frame, from one thread)
+	 * @param start Start of the frame
+	 * @param end   End of the frame
+	 */
+	void end_frame(double start, double end);
+	//! Number of dumps written so far
+	size_t dumps() const { return dumps_; }
+
+	/*!
+	 * Records the time from construction to destruction.
+	 * Does nothing when constructed with null recorder.
+	 */
+	class Span {
+	public:
+		Span(FlightRecorder* recorder, const char* name, long long value = 0);
+		~Span() noexcept;
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+		void set_value(long long value) { value_ = value; }
+	private:
+		FlightRecorder* recorder_;
+		const char* name_;
+		long long value_;
+		double start_;
+	};
+
+private:
+	struct event_t {
+		const char* name;
+		double start;
+		float duration;
+		bool is_counter;
+		long long value;
+	};
+	struct ring_t {
+		ring_t(size_t size, size_t index):events(size),next(0),index(index) {}
+		std::vector<event_t> events;
+		//! Total number of events written (the ring index is next % size)
+		std::atomic<size_t> next;
+		//! Order of registration, used as thread id in the dumps
+		const size_t index;
+	};
+
+	ring_t& get_ring();
+	void push(const event_t& event);
+	void dump(double from, double to);
+
+	const std::string directory_;
+	const double deadline_;
+	const double window_;
+	const size_t events_per_thread_;
+	//! Unique id of the recorder, used to validate the per-thread cache
+	const size_t id_;
+
+	std::mutex mutex_;
+	std::map<std::thread::id, std::unique_ptr<ring_t>> rings_;
+	//! Time of the deadline miss waiting for its dump (0 if none)
+	double trigger_;
+	double last_dump_;
+	std::atomic<size_t> dumps_;
+	std::thread writer_;
+};
+
+}
+
+
+
+#endif /* FLIGHTRECORDER_H_ */
@@ -0,0 +1,83 @@
+/*!
+ * @file 		FrameCache.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		26.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "FrameCache.h"
+#include "platform.h"
+
+namespace CAVE {
+
+FrameCache::FrameCache()
+{
+
+}
+
+void FrameCache::begin_frame()
+{
+	get_thread().view_index = 0;
+}
+
+bool FrameCache::render(const std::function<void()>& render_fun, bool redraw)
+{
+	thread_t& thread = get_thread();
+	if (thread.views.size() <= thread.view_index) thread.views.resize(thread.view_index + 1);
+	view_t& view = thread.views[thread.view_index++];
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	const bool same_size = view.target.width() == viewport[2] && view.target.height() == viewport[3];
+	if (!redraw && view.valid && same_size) {
+		view.target.blit(viewport[0], viewport[1], viewport[2], viewport[3]);
+		++thread.presented;
+		return false;
+	}
+	render_fun();
+	++thread.rendered;
+	view.valid = view.target.resize(viewport[2], viewport[3]);
+	if (!view.valid) return true;
+	// Reads the buffer the view was rendered to (e.g. the back buffer of one eye)
+	GLint draw_buffer = GL_BACK;
+	GLint read_buffer = GL_BACK;
+	glGetIntegerv(GL_DRAW_BUFFER, &draw_buffer);
+	glGetIntegerv(GL_READ_BUFFER, &read_buffer);
+	glReadBuffer(draw_buffer);
+	view.target.capture(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glReadBuffer(read_buffer);
+	return true;
+}
+
+void FrameCache::release()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	auto it = threads_.find(get_thread_id());
+	if (it == threads_.end()) return;
+	for (auto& view: it->second.views) {
+		view.target.release();
+	}
+	threads_.erase(it);
+}
+
+void FrameCache::report(std::ostream& os) const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	for (const auto& thread: threads_) {
+		const size_t total = thread.second.rendered + thread.second.presented;
+		os << "Thread " << thread.first << ": " << thread.second.rendered << " views rendered, "
+				<< thread.second.presented << " presented again";
+		if (total) os << " (" << 100.0 * thread.second.presented / total << " %)";
+		os << "\n";
+	}
+}
+
+FrameCache::thread_t& FrameCache::get_thread()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	return threads_[get_thread_id()];
+}
+
+}
@@ -0,0 +1,72 @@
+/*!
+ * @file 		FrameCache.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		26.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef FRAMECACHE_H_
+#define FRAMECACHE_H_
+#include "RenderTarget.h"
+#include <functional>
+#include <ostream>
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace CAVE {
+
+/*!
+ * Keeps the last rendered frame of every view (wall and eye), so a frame
+ * without any change can be presented again instead of rendered.
+ *
+ * The views are rendered to the screen as usual and copied to their
+ * RenderTarget afterwards. A cached view is copied back to the screen,
+ * which costs a single blit. The back buffer is undefined after a swap,
+ * so the view can't simply be left untouched.
+ *
+ * Like the other GL wrappers, it holds per-context data
+ * and release() has to be called from every thread.
+ */
+class FrameCache {
+public:
+	FrameCache();
+	//! Starts a new frame in the current thread
+	void begin_frame();
+	/*!
+	 * Renders the current view with @em render_fun and stores it, or presents
+	 * its stored frame, if @em redraw is false and the view didn't change its size.
+	 * @return true if the view was rendered
+	 */
+	bool render(const std::function<void()>& render_fun, bool redraw);
+	//! Deletes GL objects of the current thread
+	void release();
+	//! Prints numbers of rendered and presented views of all threads
+	void report(std::ostream& os) const;
+private:
+	struct view_t {
+		RenderTarget target;
+		bool valid = false;
+	};
+	struct thread_t {
+		thread_t(): view_index(0), rendered(0), presented(0) {}
+		size_t view_index;
+		std::vector<view_t> views;
+		size_t rendered;
+		size_t presented;
+	};
+
+	thread_t& get_thread();
+
+	mutable std::mutex mutex_;
+	std::map<int, thread_t> threads_;
+};
+
+}
+
+
+
+#endif /* FRAMECACHE_H_ */
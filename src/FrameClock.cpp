@@ -0,0 +1,20 @@
+/*!
+ * @file 		FrameClock.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		10.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "FrameClock.h"
+#include <chrono>
+
+namespace CAVE {
+
+double FrameClock::now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
@@ -0,0 +1,47 @@
+/*!
+ * @file 		FrameClock.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		10.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef FRAMECLOCK_H_
+#define FRAMECLOCK_H_
+
+namespace CAVE {
+
+/*!
+ * Turns absolute time into time deltas between frames.
+ *
+ * The time is kept in double. Float seconds have only ~4 ms resolution
+ * after 12 hours, which is a quarter of a frame at 60 fps.
+ */
+class FrameClock {
+public:
+	FrameClock():last_(0.0),started_(false) {}
+	/*!
+	 * @param now Current time in seconds
+	 * @return Time since the previous call (0 for the first call)
+	 */
+	float tick(double now)
+	{
+		const double delta = started_ ? now - last_ : 0.0;
+		last_ = now;
+		started_ = true;
+		return static_cast<float>(delta);
+	}
+	//! Monotonic time in seconds
+	static double now();
+private:
+	double last_;
+	bool started_;
+};
+
+}
+
+
+
+#endif /* FRAMECLOCK_H_ */
@@ -0,0 +1,250 @@
+/*!
+ * @file 		GpuSimulation.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		2.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "GpuSimulation.h"
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+namespace CAVE {
+
+namespace {
+
+//! Particle::update, the outputs are captured in the layout of Particle
+const std::string update_shader = R"XXX(
+		#version 150
+		uniform float time_delta;
+		uniform float slowdown_per_second;
+		uniform vec3 gravity;
+		in vec3 position;
+		in vec3 direction;
+		in float life;
+		out vec3 next_position;
+		out vec3 next_direction;
+		out float next_life;
+		void main() {
+			next_position = position + (time_delta * direction);
+			next_direction = (1.0 - time_delta * slowdown_per_second) * direction + time_delta * gravity;
+			next_life = life - time_delta;
+		}
+)XXX";
+
+const GLuint index_position = 0;
+const GLuint index_direction = 1;
+const GLuint index_life = 2;
+
+//! Smallest capacity of the buffers (in particles)
+const size_t min_capacity = 1024;
+
+const unsigned int verification_seed = 1;
+
+bool close(float reference, float tested, float tolerance)
+{
+	return std::abs(reference - tested) <= tolerance * std::max(1.0f, std::abs(reference));
+}
+
+bool close(const point3& reference, const point3& tested, float tolerance)
+{
+	return close(reference.x, tested.x, tolerance) && close(reference.y, tested.y, tolerance) &&
+			close(reference.z, tested.z, tolerance);
+}
+}
+
+GpuPopulation::GpuPopulation():
+count_(0)
+{
+
+}
+
+gpu_step_t GpuPopulation::update(std::vector<Particle> spawned, float time_delta)
+{
+	gpu_step_t step;
+	step.time_delta = time_delta;
+	if (!spawned.empty()) {
+		batches_.push_back({spawned.size(), Particle::default_life});
+		count_ += spawned.size();
+	}
+	step.spawned = std::move(spawned);
+	// The same arithmetic as Particle::update, so the particles die exactly as on the CPU
+	for (auto& batch: batches_) {
+		batch.life -= time_delta;
+	}
+	while (!batches_.empty() && batches_.front().life < 0) {
+		step.dead += batches_.front().count;
+		count_ -= batches_.front().count;
+		batches_.pop_front();
+	}
+	return step;
+}
+
+gpu_step_t GpuPopulation::clear()
+{
+	gpu_step_t step;
+	step.dead = count_;
+	batches_.clear();
+	count_ = 0;
+	return step;
+}
+
+GpuSimulation::GpuSimulation():
+program_(GL_VERTEX_SHADER, update_shader),current_(0),count_(0),capacity_(0)
+{
+	program_.bind_attrib(index_position, "position");
+	program_.bind_attrib(index_direction, "direction");
+	program_.bind_attrib(index_life, "life");
+	program_.set_feedback_varyings({"next_position", "next_direction", "next_life"});
+	program_.link();
+
+	glGenBuffers(2, buffers_);
+	glGenVertexArrays(2, vaos_);
+	for (int i = 0; i < 2; ++i) {
+		glBindVertexArray(vaos_[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers_[i]);
+		glEnableVertexAttribArray(index_position);
+		glVertexAttribPointer(index_position, 3, GL_FLOAT, GL_FALSE, sizeof(Particle),
+				reinterpret_cast<const GLvoid*>(offsetof(Particle, position)));
+		glEnableVertexAttribArray(index_direction);
+		glVertexAttribPointer(index_direction, 3, GL_FLOAT, GL_FALSE, sizeof(Particle),
+				reinterpret_cast<const GLvoid*>(offsetof(Particle, direction)));
+		glEnableVertexAttribArray(index_life);
+		glVertexAttribPointer(index_life, 1, GL_FLOAT, GL_FALSE, sizeof(Particle),
+				reinterpret_cast<const GLvoid*>(offsetof(Particle, life)));
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GpuSimulation::step(const gpu_step_t& step)
+{
+	const size_t total = count_ + step.spawned.size();
+	reserve(total);
+	if (!step.spawned.empty()) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffers_[current_]);
+		glBufferSubData(GL_ARRAY_BUFFER, count_ * sizeof(Particle),
+				step.spawned.size() * sizeof(Particle), step.spawned.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	const size_t dead = std::min(step.dead, total);
+	count_ = total - dead;
+	if (!count_) return;
+
+	const size_t target = 1 - current_;
+	program_.bind();
+	program_.set_uniform_float("time_delta", step.time_delta);
+	program_.set_uniform_float("slowdown_per_second", Particle::slowdown_per_second);
+	program_.set_uniform_float3("gravity", Particle::gravity.x, Particle::gravity.y, Particle::gravity.z);
+	glBindVertexArray(vaos_[current_]);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers_[target]);
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBeginTransformFeedback(GL_POINTS);
+	// The dying particles are skipped, so the target starts with the oldest living one
+	glDrawArrays(GL_POINTS, static_cast<GLint>(dead), static_cast<GLsizei>(count_));
+	glEndTransformFeedback();
+	glDisable(GL_RASTERIZER_DISCARD);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	program_.unbind();
+	current_ = target;
+}
+
+void GpuSimulation::reserve(size_t count)
+{
+	if (count <= capacity_) return;
+	capacity_ = std::max(std::max(count, 2 * capacity_), min_capacity);
+	const GLsizeiptr bytes = capacity_ * sizeof(Particle);
+	const size_t other = 1 - current_;
+	// The other buffer gets the particles, the current one is then only reallocated
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers_[other]);
+	glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_DYNAMIC_COPY);
+	if (count_) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffers_[current_]);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, count_ * sizeof(Particle));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers_[current_]);
+	glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	current_ = other;
+}
+
+std::vector<Particle> GpuSimulation::read() const
+{
+	std::vector<Particle> particles(count_, Particle({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}));
+	if (!count_) return particles;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer());
+	glGetBufferSubData(GL_ARRAY_BUFFER, 0, count_ * sizeof(Particle), particles.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return particles;
+}
+
+void GpuSimulation::release()
+{
+	program_.release();
+	glDeleteBuffers(2, buffers_);
+	glDeleteVertexArrays(2, vaos_);
+	count_ = 0;
+	capacity_ = 0;
+}
+
+bool GpuSimulation::supported()
+{
+	// Transform feedback is core in 3.0, glCopyBufferSubData in 3.1
+	return GLEW_VERSION_3_1;
+}
+
+bool verify_gpu_simulation(size_t count, size_t steps, float tolerance)
+{
+	std::mt19937 generator(verification_seed);
+	std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> direction(-2.0f, 2.0f);
+	// Long enough steps for the first batches to die
+	std::uniform_real_distribution<float> time_delta(0.05f, 0.25f);
+	const size_t batches = 10;
+	GpuPopulation population;
+	GpuSimulation simulation;
+	std::vector<Particle> reference;
+	bool passed = true;
+	for (size_t step = 0; step < steps && passed; ++step) {
+		std::vector<Particle> spawned;
+		if (step % std::max<size_t>(steps / batches, 1) == 0) {
+			for (size_t i = 0; i < count / batches; ++i) {
+				spawned.emplace_back(point3{position(generator), position(generator), position(generator)},
+						point3{direction(generator), direction(generator), direction(generator)});
+			}
+		}
+		const float delta = time_delta(generator);
+		reference.insert(reference.end(), spawned.begin(), spawned.end());
+		for (auto& p: reference) {
+			p.update(delta);
+		}
+		reference.erase(std::remove_if(reference.begin(), reference.end(),
+				[](Particle& p){return p.dead();}), reference.end());
+		simulation.step(population.update(std::move(spawned), delta));
+		if (population.size() != reference.size() || simulation.size() != reference.size()) {
+			std::cerr << "GPU simulation has " << simulation.size() << " particles after step " << step
+					<< ", expected " << reference.size() << "\n";
+			passed = false;
+		}
+	}
+	const std::vector<Particle> tested = simulation.read();
+	for (size_t i = 0; i < tested.size() && passed; ++i) {
+		if (!close(reference[i].position, tested[i].position, tolerance) ||
+				!close(reference[i].direction, tested[i].direction, tolerance) ||
+				!close(reference[i].life, tested[i].life, tolerance)) {
+			std::cerr << "GPU simulation differs from the CPU at particle " << i << "\n";
+			passed = false;
+		}
+	}
+	simulation.release();
+	return passed;
+}
+
+}
@@ -0,0 +1,107 @@
+/*!
+ * @file 		GpuSimulation.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		2.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef GPUSIMULATION_H_
+#define GPUSIMULATION_H_
+#include "Particle.h"
+#include "Shader.h"
+#include <vector>
+#include <deque>
+#include <cstddef>
+
+namespace CAVE {
+
+//! One update of the particles, the same as Scene::update does on the CPU
+struct gpu_step_t {
+	float time_delta	= 0.0f;
+	//! Particles dead after the update, they are always the oldest ones (front of the buffer)
+	size_t dead			= 0;
+	//! Particles spawned before the update, appended to the end of the buffer
+	std::vector<Particle> spawned;
+};
+
+/*!
+ * Lifetimes of the particles tracked on the CPU, per spawned batch.
+ *
+ * All particles start with the same life and lose the same time in every update,
+ * so they die in the order they were spawned. The batches are then enough
+ * to tell how many particles die in an update, without reading anything back from the GPU.
+ */
+class GpuPopulation {
+public:
+	GpuPopulation();
+	//! Records an update with particles @em spawned before it
+	gpu_step_t update(std::vector<Particle> spawned, float time_delta);
+	//! Records removal of all particles
+	gpu_step_t clear();
+	size_t size() const { return count_; }
+private:
+	struct batch_t {
+		size_t count;
+		float life;
+	};
+	std::deque<batch_t> batches_;
+	size_t count_;
+};
+
+/*!
+ * Particle update running in a vertex shader with transform feedback,
+ * for GPUs without compute shaders (OpenGL 3.1).
+ *
+ * The particles stay in two buffers used in turns, every step reads one of them
+ * and writes the other, leaving out the particles dying in the step. Spawned particles
+ * are appended to the source buffer before the step. The buffers have the layout
+ * of Particle, so they can be drawn directly.
+ *
+ * The shader computes the same expression as Particle::update, but the GPU may
+ * contract it into FMA, so the results are close to the CPU, not bit-identical.
+ *
+ * Holds GL objects of the context it was created in and it has to be released there.
+ */
+class GpuSimulation {
+public:
+	GpuSimulation();
+	void step(const gpu_step_t& step);
+	//! Buffer with the current particles
+	GLuint buffer() const { return buffers_[current_]; }
+	size_t size() const { return count_; }
+	//! Reads the particles back (slow, for verification only)
+	std::vector<Particle> read() const;
+	//! Deletes the GL objects, the object can't be used afterwards
+	void release();
+	//! Whether the current context supports it
+	static bool supported();
+private:
+	//! Makes room for @em count particles, keeping the current ones
+	void reserve(size_t count);
+
+	ShaderProgram program_;
+	GLuint buffers_[2];
+	//! Vertex arrays reading from the respective buffers
+	GLuint vaos_[2];
+	size_t current_;
+	size_t count_;
+	size_t capacity_;
+};
+
+/*!
+ * Compares GpuSimulation with Particle::update on random particles,
+ * spawned in batches and dying during the steps. Needs a current context.
+ * @param count Number of particles spawned in total
+ * @param steps Number of updates (with varying time deltas)
+ * @param tolerance Largest allowed relative difference of a value
+ */
+bool verify_gpu_simulation(size_t count = 4096, size_t steps = 100, float tolerance = 1e-4f);
+
+}
+
+
+
+#endif /* GPUSIMULATION_H_ */
@@ -0,0 +1,346 @@
+/*!
+ * @file 		Hud.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		12.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "Hud.h"
+#include "hud_font.h"
+#include "FrameClock.h"
+#include "platform.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstddef>
+
+namespace CAVE {
+
+namespace {
+
+//! Vertices are in pixels from the top left corner of the view
+const std::string hud_vertex_shader = R"XXX(
+		#version 150
+		uniform ivec2 viewport_size;
+		in vec2 position;
+		in vec2 texcoords;
+		in vec4 color;
+		out vec2 glyph_texcoords;
+		out vec4 glyph_color;
+		void main() {
+			vec2 ndc = position / vec2(viewport_size) * 2.0 - 1.0;
+			gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+			glyph_texcoords = texcoords;
+			glyph_color = color;
+		}
+)XXX";
+
+const std::string hud_fragment_shader = R"XXX(
+		#version 150
+		uniform sampler2D atlas;
+		in vec2 glyph_texcoords;
+		in vec4 glyph_color;
+		out vec4 color;
+		void main() {
+			color = glyph_color * vec4(1.0, 1.0, 1.0, texture(atlas, glyph_texcoords).r);
+		}
+)XXX";
+
+//! Glyphs per row of the atlas
+const int atlas_columns = 16;
+const int atlas_rows = (hud_font::glyph_count + atlas_columns - 1) / atlas_columns;
+const int atlas_width = atlas_columns * hud_font::glyph_width;
+const int atlas_height = atlas_rows * hud_font::glyph_height;
+//! Size of a font pixel on the screen (the walls are far away)
+const float scale = 2.0f;
+const float line_height = hud_font::glyph_height * scale;
+const float margin = 8.0f * scale;
+//! Characters in the text column
+const int text_columns = 20;
+const int text_lines = 6;
+//! Frames shown in the graphs
+const size_t history_size = 120;
+const float bar_width = 1.0f * scale;
+//! Interval of HUD refreshes, when nothing else changes (s)
+const double idle_refresh = 0.5;
+
+const unsigned char background_color[4] = {0, 0, 0, 160};
+const unsigned char text_color[4] = {255, 255, 255, 255};
+const unsigned char bar_color[4] = {64, 200, 64, 255};
+const unsigned char late_bar_color[4] = {230, 64, 64, 255};
+}
+
+Hud::Hud(int wall, double frame_budget):
+wall_(wall),frame_budget_(frame_budget),history_(history_size),frames_(0),
+last_cost_(0.0),last_build_(0.0),total_cost_(0.0),max_cost_(0.0),cost_frames_(0),
+total_gpu_cost_(0.0),max_gpu_cost_(0.0),gpu_draws_(0)
+{
+
+}
+
+void Hud::add_frame(const hud_frame_t& frame)
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	history_[frames_ % history_.size()] = frame;
+	++frames_;
+}
+
+void Hud::render()
+{
+#ifdef CAVE_VERSION
+	if (get_wall_id() != wall_) return;
+#endif
+	const double start = FrameClock::now();
+	thread_t& thread = get_thread();
+	if (!thread.shader) prepare(thread);
+	bool rebuilt = false;
+	{
+		std::unique_lock<std::mutex> _(mutex_);
+		if (thread.built_frame != frames_) {
+			// Both eyes share one build, the cost is counted per frame
+			if (thread.built_frame) {
+				last_cost_ = thread.cost;
+				total_cost_ += thread.cost;
+				max_cost_ = std::max(max_cost_, thread.cost);
+				++cost_frames_;
+			}
+			thread.cost = 0.0;
+			thread.built_frame = frames_;
+			last_build_ = start;
+			build(thread.vertices);
+			rebuilt = true;
+		}
+	}
+	if (thread.vertices.empty()) return;
+
+	if (thread.query_pending) {
+		GLint available = 0;
+		glGetQueryObjectiv(thread.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(thread.query, GL_QUERY_RESULT, &elapsed);
+			thread.query_pending = false;
+			std::unique_lock<std::mutex> _(mutex_);
+			total_gpu_cost_ += elapsed * 1e-9;
+			max_gpu_cost_ = std::max(max_gpu_cost_, elapsed * 1e-9);
+			++gpu_draws_;
+		}
+	}
+	const bool timed = GLEW_ARB_timer_query && !thread.query_pending;
+	if (timed) {
+		if (!thread.query) glGenQueries(1, &thread.query);
+		glBeginQuery(GL_TIME_ELAPSED, thread.query);
+	}
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glBindBuffer(GL_ARRAY_BUFFER, thread.vbo);
+	if (rebuilt) {
+		glBufferData(GL_ARRAY_BUFFER, thread.vertices.size() * sizeof(vertex_t),
+				thread.vertices.data(), GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLint blend_src = GL_ONE;
+	GLint blend_dst = GL_ZERO;
+	glGetIntegerv(GL_BLEND_SRC_RGB, &blend_src);
+	glGetIntegerv(GL_BLEND_DST_RGB, &blend_dst);
+	const bool blend = glIsEnabled(GL_BLEND);
+	const bool depth_test = glIsEnabled(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+	thread.shader->bind();
+	thread.shader->set_uniform_int2("viewport_size", viewport[2], viewport[3]);
+	thread.shader->set_uniform_int("atlas", 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, thread.texture);
+	glBindVertexArray(thread.vao);
+	glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(thread.vertices.size()));
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	thread.shader->unbind();
+	glBlendFunc(blend_src, blend_dst);
+	if (!blend) glDisable(GL_BLEND);
+	if (depth_test) glEnable(GL_DEPTH_TEST);
+	if (timed) {
+		glEndQuery(GL_TIME_ELAPSED);
+		thread.query_pending = true;
+	}
+	thread.cost += FrameClock::now() - start;
+}
+
+void Hud::prepare(thread_t& thread)
+{
+	std::vector<GLubyte> atlas(atlas_width * atlas_height, 0);
+	for (int glyph = 0; glyph < hud_font::glyph_count; ++glyph) {
+		const int x0 = (glyph % atlas_columns) * hud_font::glyph_width;
+		const int y0 = (glyph / atlas_columns) * hud_font::glyph_height;
+		for (int y = 0; y < hud_font::glyph_height; ++y) {
+			for (int x = 0; x < hud_font::glyph_width; ++x) {
+				const bool set = hud_font::glyphs[glyph][y] & (0x80 >> x);
+				atlas[(y0 + y) * atlas_width + x0 + x] = set ? 255 : 0;
+			}
+		}
+	}
+	glGenTextures(1, &thread.texture);
+	glBindTexture(GL_TEXTURE_2D, thread.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas_width, atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenBuffers(1, &thread.vbo);
+	glGenVertexArrays(1, &thread.vao);
+	glBindVertexArray(thread.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, thread.vbo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_t),
+			reinterpret_cast<const GLvoid*>(offsetof(vertex_t, position)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_t),
+			reinterpret_cast<const GLvoid*>(offsetof(vertex_t, texcoords)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vertex_t),
+			reinterpret_cast<const GLvoid*>(offsetof(vertex_t, color)));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	thread.shader.reset(new ShaderProgram(hud_vertex_shader, hud_fragment_shader));
+	thread.shader->bind_attrib(0, "position");
+	thread.shader->bind_attrib(1, "texcoords");
+	thread.shader->bind_attrib(2, "color");
+	thread.shader->bind_frag_data(0, "color");
+	thread.shader->link();
+}
+
+void Hud::build(std::vector<vertex_t>& vertices) const
+{
+	vertices.clear();
+	const size_t count = std::min(frames_, history_.size());
+	if (!count) return;
+	hud_frame_t mean;
+	for (size_t i = 0; i < count; ++i) {
+		mean.frame_time += history_[i].frame_time / count;
+		mean.update_time += history_[i].update_time / count;
+		mean.render_time += history_[i].render_time / count;
+		mean.barrier_time += history_[i].barrier_time / count;
+	}
+	const hud_frame_t& last = history_[(frames_ - 1) % history_.size()];
+
+	const float text_width = text_columns * hud_font::glyph_width * scale;
+	const float graph_width = history_.size() * bar_width;
+	add_quad(vertices, margin, margin, text_width + graph_width + 3 * margin,
+			text_lines * line_height + 2 * margin, hud_font::solid_glyph, background_color);
+
+	char lines[text_lines][32];
+	std::snprintf(lines[0], sizeof(lines[0]), "frame    %7.2f ms", mean.frame_time * 1e3);
+	std::snprintf(lines[1], sizeof(lines[1]), "update   %7.2f ms", mean.update_time * 1e3);
+	std::snprintf(lines[2], sizeof(lines[2]), "render   %7.2f ms", mean.render_time * 1e3);
+	std::snprintf(lines[3], sizeof(lines[3]), "barrier  %7.2f ms", mean.barrier_time * 1e3);
+	std::snprintf(lines[4], sizeof(lines[4]), "particles %8lu", static_cast<unsigned long>(last.particles));
+	std::snprintf(lines[5], sizeof(lines[5]), "hud      %7.3f ms", last_cost_ * 1e3);
+	for (int i = 0; i < text_lines; ++i) {
+		add_text(vertices, 2 * margin, 2 * margin + i * line_height, lines[i], text_color);
+	}
+	const float graph_x = 3 * margin + text_width;
+	add_graph(vertices, graph_x, 2 * margin, &hud_frame_t::frame_time);
+	add_graph(vertices, graph_x, 2 * margin + 3 * line_height, &hud_frame_t::barrier_time);
+}
+
+void Hud::add_quad(std::vector<vertex_t>& vertices, float x, float y, float width, float height,
+		int glyph, const unsigned char* color) const
+{
+	float u0 = static_cast<float>((glyph % atlas_columns) * hud_font::glyph_width) / atlas_width;
+	float v0 = static_cast<float>((glyph / atlas_columns) * hud_font::glyph_height) / atlas_height;
+	float u1 = u0 + static_cast<float>(hud_font::glyph_width) / atlas_width;
+	float v1 = v0 + static_cast<float>(hud_font::glyph_height) / atlas_height;
+	if (glyph == hud_font::solid_glyph) {
+		// Stretched, so it samples just the center of one texel (away from the neighbouring glyphs)
+		u0 = u1 = u0 + 0.5f / atlas_width;
+		v0 = v1 = v0 + 0.5f / atlas_height;
+	}
+	const float corners[6][4] = {
+			{x, y, u0, v0}, {x + width, y, u1, v0}, {x, y + height, u0, v1},
+			{x, y + height, u0, v1}, {x + width, y, u1, v0}, {x + width, y + height, u1, v1}};
+	for (const auto& corner: corners) {
+		vertex_t vertex;
+		std::copy(corner, corner + 2, vertex.position);
+		std::copy(corner + 2, corner + 4, vertex.texcoords);
+		std::copy(color, color + 4, vertex.color);
+		vertices.push_back(vertex);
+	}
+}
+
+void Hud::add_text(std::vector<vertex_t>& vertices, float x, float y, const char* text,
+		const unsigned char* color) const
+{
+	for (; *text; ++text, x += hud_font::glyph_width * scale) {
+		const int glyph = *text - hud_font::first_char;
+		if (glyph <= 0 || glyph >= hud_font::solid_glyph) continue;
+		add_quad(vertices, x, y, hud_font::glyph_width * scale, line_height, glyph, color);
+	}
+}
+
+void Hud::add_graph(std::vector<vertex_t>& vertices, float x, float y, double hud_frame_t::* value) const
+{
+	const size_t count = std::min(frames_, history_.size());
+	double max_value = frame_budget_;
+	for (size_t i = 0; i < count; ++i) {
+		max_value = std::max(max_value, history_[i].*value);
+	}
+	if (max_value <= 0.0) return;
+	// Oldest frame on the left
+	for (size_t i = 0; i < count; ++i) {
+		const hud_frame_t& frame = history_[(frames_ - count + i) % history_.size()];
+		const float height = static_cast<float>(frame.*value / max_value) * line_height;
+		const unsigned char* color = frame.*value > frame_budget_ ? late_bar_color : bar_color;
+		add_quad(vertices, x + i * bar_width, y + line_height - height, bar_width, height,
+				hud_font::solid_glyph, color);
+	}
+}
+
+void Hud::release()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	auto it = threads_.find(get_thread_id());
+	if (it == threads_.end()) return;
+	thread_t& thread = it->second;
+	if (thread.shader) thread.shader->release();
+	if (thread.texture) glDeleteTextures(1, &thread.texture);
+	if (thread.vbo) glDeleteBuffers(1, &thread.vbo);
+	if (thread.vao) glDeleteVertexArrays(1, &thread.vao);
+	if (thread.query) glDeleteQueries(1, &thread.query);
+	threads_.erase(it);
+}
+
+bool Hud::changed(double now) const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	return now - last_build_ >= idle_refresh;
+}
+
+void Hud::report(std::ostream& os) const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	if (!cost_frames_) return;
+	os << "HUD cost: " << total_cost_ / cost_frames_ * 1e3 << " ms mean, "
+			<< max_cost_ * 1e3 << " ms max per frame on the CPU";
+	if (gpu_draws_) {
+		os << ", " << total_gpu_cost_ / gpu_draws_ * 1e3 << " ms mean, "
+				<< max_gpu_cost_ * 1e3 << " ms max per draw on the GPU";
+	}
+	os << "\n";
+}
+
+Hud::thread_t& Hud::get_thread()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	return threads_[get_thread_id()];
+}
+
+}
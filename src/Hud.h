@@ -0,0 +1,119 @@
+/*!
+ * @file 		Hud.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		12.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef HUD_H_
+#define HUD_H_
+#include "Shader.h"
+#include <ostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+
+namespace CAVE {
+
+//! Statistics of one frame shown by the HUD (times in seconds)
+struct hud_frame_t {
+	double frame_time	= 0.0;
+	double update_time	= 0.0;
+	double render_time	= 0.0;
+	double barrier_time	= 0.0;
+	size_t particles	= 0;
+};
+
+/*!
+ * On-screen performance HUD.
+ *
+ * Shows frame time, phases, particle count and its own cost, with graphs
+ * of the recent frame and barrier times, on one chosen wall.
+ * Text and graphs are built once per frame into a single vertex buffer
+ * of quads textured from a prebaked glyph atlas (hud_font.h) and drawn with one call.
+ *
+ * Like the other GL wrappers, it holds per-context data
+ * and release() has to be called from every thread.
+ */
+class Hud {
+public:
+	/*!
+	 * @param wall Wall to draw on (CAVElib wall id, ignored with GLUT)
+	 * @param frame_budget Frame time drawn as over budget in the graph (s)
+	 */
+	Hud(int wall, double frame_budget);
+	//! Adds statistics of a finished frame
+	void add_frame(const hud_frame_t& frame);
+	//! Draws the HUD over the current view, if it is on the chosen wall
+	void render();
+	//! Deletes GL objects of the current thread
+	void release();
+	//! Prints the cost of the HUD (CPU per frame and GPU per draw)
+	void report(std::ostream& os) const;
+	/*!
+	 * Whether the HUD should be redrawn to stay current (for rendering on demand).
+	 * It is rebuilt with every frame otherwise, so it allows a refresh only every idle_refresh seconds.
+	 */
+	bool changed(double now) const;
+private:
+	struct vertex_t {
+		float position[2];
+		float texcoords[2];
+		unsigned char color[4];
+	};
+	struct thread_t {
+		thread_t(): texture(0), vbo(0), vao(0), query(0), query_pending(false), built_frame(0), cost(0.0) {}
+		//! Created on first use (in the context of the thread)
+		std::unique_ptr<ShaderProgram> shader;
+		GLuint texture;
+		GLuint vbo;
+		GLuint vao;
+		//! Query measuring the GPU time of a draw (GL_TIME_ELAPSED)
+		GLuint query;
+		bool query_pending;
+		//! Frame the vertex buffer was built for
+		size_t built_frame;
+		std::vector<vertex_t> vertices;
+		//! Time spent in render() during the current frame (s)
+		double cost;
+	};
+
+	thread_t& get_thread();
+	void prepare(thread_t& thread);
+	//! Builds the vertices from the history (mutex_ locked)
+	void build(std::vector<vertex_t>& vertices) const;
+	void add_quad(std::vector<vertex_t>& vertices, float x, float y, float width, float height,
+			int glyph, const unsigned char* color) const;
+	void add_text(std::vector<vertex_t>& vertices, float x, float y, const char* text,
+			const unsigned char* color) const;
+	void add_graph(std::vector<vertex_t>& vertices, float x, float y, double hud_frame_t::* value) const;
+
+	const int wall_;
+	const double frame_budget_;
+	mutable std::mutex mutex_;
+	//! Ring of recent frames, frames_ is the total count
+	std::vector<hud_frame_t> history_;
+	size_t frames_;
+	//! Own cost of the previous frame, shown in the HUD
+	double last_cost_;
+	//! Time of the last build
+	double last_build_;
+	double total_cost_;
+	double max_cost_;
+	size_t cost_frames_;
+	//! GPU time of the timed draws (only some are timed, the queries are not waited for)
+	double total_gpu_cost_;
+	double max_gpu_cost_;
+	size_t gpu_draws_;
+	std::map<int, thread_t> threads_;
+};
+
+}
+
+
+
+#endif /* HUD_H_ */
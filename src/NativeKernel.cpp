@@ -0,0 +1,137 @@
+/*!
+ * @file 		NativeKernel.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		9.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "NativeKernel.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace CAVE {
+
+namespace {
+
+/*
+ * No -march=native, so the objects in a shared cache run on all the nodes,
+ * and no contraction to FMA, so the kernel rounds exactly as the interpreter.
+ */
+const std::string compiler_flags = "-std=c++11 -O3 -fPIC -shared -ffp-contract=off";
+
+std::string compiler_command()
+{
+	const char* compiler = std::getenv("CXX");
+	return std::string(compiler && *compiler ? compiler : "c++") + " " + compiler_flags;
+}
+
+//! FNV-1a, stable across runs and builds (unlike std::hash)
+uint64_t content_hash(const std::string& text)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c: text) {
+		hash = (hash ^ c) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+//! Quotes @em text for the shell
+std::string quote(const std::string& text)
+{
+	std::string quoted = "'";
+	for (char c: text) {
+		if (c == '\'') quoted += "'\\''";
+		else quoted += c;
+	}
+	return quoted + "'";
+}
+
+//! Creates the directory with all its parents
+bool make_directories(const std::string& path)
+{
+	for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+		const std::string part = path.substr(0, pos);
+		if (::mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) return false;
+		if (pos == std::string::npos) return true;
+	}
+}
+}
+
+NativeKernel::NativeKernel(const std::string& source, const std::string& cache_dir):
+source_(source),cache_dir_(cache_dir),command_(compiler_command()),state_(state_t::compiling),handle_(nullptr)
+{
+	std::ostringstream name;
+	name << cache_dir_ << "/kernel-" << std::hex << std::setw(16) << std::setfill('0')
+			<< content_hash(command_ + "\n" + source_) << ".so";
+	path_ = name.str();
+	thread_ = std::thread([this](){build();});
+}
+
+NativeKernel::~NativeKernel()
+{
+	if (thread_.joinable()) thread_.join();
+	if (handle_) dlclose(handle_);
+}
+
+void NativeKernel::build()
+{
+	if (::access(path_.c_str(), R_OK) == 0) {
+		state_ = state_t::compiled;
+		return;
+	}
+	if (!make_directories(cache_dir_)) {
+		std::cerr << "Can't create kernel cache " << cache_dir_ << "\n";
+		state_ = state_t::failed;
+		return;
+	}
+	// Other processes may build the same kernel at the same time, only the result is shared
+	const std::string base = path_.substr(0, path_.size() - 3) + "." + std::to_string(::getpid());
+	const std::string source_path = base + ".cpp";
+	const std::string log_path = base + ".log";
+	const std::string temporary = base + ".tmp";
+	std::ofstream(source_path) << source_;
+	const std::string command = command_ + " -o " + quote(temporary) + " " + quote(source_path)
+			+ " > " + quote(log_path) + " 2>&1";
+	if (std::system(command.c_str()) != 0 || std::rename(temporary.c_str(), path_.c_str()) != 0) {
+		// The source and the log are kept for inspection
+		std::cerr << "Failed to compile native kernel, see " << log_path << "\n";
+		std::remove(temporary.c_str());
+		state_ = state_t::failed;
+		return;
+	}
+	std::remove(source_path.c_str());
+	std::remove(log_path.c_str());
+	state_ = state_t::compiled;
+}
+
+void* NativeKernel::load(const std::string& symbol)
+{
+	if (!ready()) return nullptr;
+	if (!handle_) handle_ = dlopen(path_.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (!handle_) {
+		std::cerr << "Failed to load native kernel: " << dlerror() << "\n";
+		state_ = state_t::failed;
+		return nullptr;
+	}
+	return dlsym(handle_, symbol.c_str());
+}
+
+std::string NativeKernel::default_cache_dir()
+{
+	const char* cache = std::getenv("XDG_CACHE_HOME");
+	if (cache && *cache) return std::string(cache) + "/cave_tests";
+	const char* home = std::getenv("HOME");
+	return std::string(home && *home ? home : "/tmp") + "/.cache/cave_tests";
+}
+
+}
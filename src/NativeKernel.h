@@ -0,0 +1,68 @@
+/*!
+ * @file 		NativeKernel.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		9.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef NATIVEKERNEL_H_
+#define NATIVEKERNEL_H_
+#include <string>
+#include <thread>
+#include <atomic>
+
+namespace CAVE {
+
+/*!
+ * C++ source compiled in a background thread with the system compiler
+ * ($CXX or c++) into a shared object, loaded with dlopen.
+ *
+ * The objects are cached in a directory by a hash of the source and the compiler
+ * command, so a kernel is compiled only once (once for all the nodes,
+ * if the directory is shared). The object is renamed into place only after
+ * the compiler succeeded, so concurrent compilations don't see partial files.
+ */
+class NativeKernel {
+public:
+	NativeKernel(const std::string& source, const std::string& cache_dir);
+	//! Waits for the compiler and unloads the object
+	~NativeKernel();
+	NativeKernel(const NativeKernel&) = delete;
+	NativeKernel& operator=(const NativeKernel&) = delete;
+	//! The compilation finished (or the object was found in the cache)
+	bool ready() const { return state_ == state_t::compiled; }
+	bool failed() const { return state_ == state_t::failed; }
+	/*!
+	 * Loads the object (once ready()) and returns address of @em symbol,
+	 * nullptr if it can't be loaded.
+	 */
+	void* load(const std::string& symbol);
+	const std::string& get_path() const { return path_; }
+	//! $XDG_CACHE_HOME/cave_tests, or ~/.cache/cave_tests
+	static std::string default_cache_dir();
+private:
+	enum class state_t {
+		compiling,
+		compiled,
+		failed
+	};
+
+	void build();
+
+	const std::string source_;
+	const std::string cache_dir_;
+	const std::string command_;
+	std::string path_;
+	std::atomic<state_t> state_;
+	void* handle_;
+	std::thread thread_;
+};
+
+}
+
+
+
+#endif /* NATIVEKERNEL_H_ */
@@ -0,0 +1,135 @@
+/*!
+ * @file 		Options.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "Options.h"
+#include <cstdlib>
+#include <iostream>
+
+namespace CAVE {
+
+namespace {
+/*!
+ * Checks whether @em arg is option @em name and stores its value (if any)
+ * @param arg   Argument to check
+ * @param name  Name of the option (including the leading dashes)
+ * @param value Output parameter for the value
+ * @return true if the argument matches
+ */
+bool match_option(const std::string& arg, const std::string& name, std::string& value)
+{
+	if (arg.compare(0, name.size(), name) != 0) return false;
+	if (arg.size() == name.size()) {
+		value.clear();
+		return true;
+	}
+	if (arg[name.size()] != '=') return false;
+	value = arg.substr(name.size() + 1);
+	return true;
+}
+
+//! Ends the program when option @em name was given without a value
+void require_value(const std::string& name, const std::string& value)
+{
+	if (!value.empty()) return;
+	std::cerr << "Option " << name << " needs a value (" << name << "=...)\n";
+	std::exit(1);
+}
+
+std::string default_tuning_file()
+{
+	const char* home = std::getenv("HOME");
+	return std::string(home?home:".") + "/.cave_tests_tuning";
+}
+}
+
+options_t parse_options(int& argc, char** argv)
+{
+	options_t options;
+	options.tuning_file = default_tuning_file();
+	int out = 1;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		std::string value;
+		if (match_option(arg, "--calibrate", value)) {
+			options.calibrate = true;
+		} else if (match_option(arg, "--no-tuning", value)) {
+			options.no_tuning = true;
+		} else if (match_option(arg, "--tuning-file", value)) {
+			require_value("--tuning-file", value);
+			options.tuning_file = value;
+		} else if (match_option(arg, "--deterministic", value)) {
+			options.deterministic = true;
+		} else if (match_option(arg, "--fast-kernels", value)) {
+			options.deterministic = false;
+		} else if (match_option(arg, "--gpu-culling", value)) {
+			options.gpu_culling = true;
+		} else if (match_option(arg, "--vertex-pulling", value)) {
+			options.vertex_pulling = true;
+		} else if (match_option(arg, "--point-sprites", value)) {
+			options.point_sprites = true;
+		} else if (match_option(arg, "--gpu-simulation", value)) {
+			options.gpu_simulation = true;
+		} else if (match_option(arg, "--behaviour", value)) {
+			options.behaviour = value;
+		} else if (match_option(arg, "--native-behaviour", value)) {
+			options.native_behaviour = true;
+			options.behaviour_cache = value;
+		} else if (match_option(arg, "--multi-viewport", value)) {
+			options.multi_viewport = true;
+		} else if (match_option(arg, "--reprojection", value)) {
+			options.reprojection_fps = value.empty() ? 60.0 : std::atof(value.c_str());
+		} else if (match_option(arg, "--flight-recorder", value)) {
+			options.flight_recorder = value.empty() ? "." : value;
+		} else if (match_option(arg, "--frame-deadline", value)) {
+			options.frame_deadline_ms = std::atof(value.c_str());
+		} else if (match_option(arg, "--profile-wall", value)) {
+			options.profile_wall_clock = true;
+		} else if (match_option(arg, "--profile-output", value)) {
+			options.profile_output = value;
+		} else if (match_option(arg, "--profile", value)) {
+			options.profile_frequency = value.empty() ? 99.0 : std::atof(value.c_str());
+		} else if (match_option(arg, "--energy", value)) {
+			options.energy = true;
+		} else if (match_option(arg, "--shared-arena", value)) {
+			options.shared_arena_mb = std::strtoul(value.c_str(), nullptr, 10);
+		} else if (match_option(arg, "--point-cloud", value)) {
+			options.point_cloud = value;
+		} else if (match_option(arg, "--cloud-points-per-frame", value)) {
+			options.cloud_points_per_frame = std::strtoul(value.c_str(), nullptr, 10);
+		} else if (match_option(arg, "--hud", value)) {
+			// CAVE_FRONT_WALL by default
+			options.hud_wall = value.empty() ? 1 : std::atoi(value.c_str());
+		} else if (match_option(arg, "--on-demand", value)) {
+			options.on_demand = true;
+		} else if (match_option(arg, "--overdraw-heatmap", value)) {
+			options.overdraw_heatmap = true;
+		} else if (match_option(arg, "--overdraw", value)) {
+			options.overdraw_interval = value.empty() ? 30 : std::strtoul(value.c_str(), nullptr, 10);
+		} else if (match_option(arg, "--control", value)) {
+			options.control = value.empty() ? "-" : value;
+		} else if (match_option(arg, "--stress-ramp", value)) {
+			options.stress_ramp = true;
+		} else if (match_option(arg, "--ramp-target-fps", value)) {
+			options.ramp_target_fps = std::atof(value.c_str());
+		} else if (match_option(arg, "--ramp-percentile", value)) {
+			options.ramp_percentile = std::atof(value.c_str());
+		} else if (match_option(arg, "--ramp-step", value)) {
+			options.ramp_step = std::strtoul(value.c_str(), nullptr, 10);
+		} else if (match_option(arg, "--ramp-report", value)) {
+			options.ramp_report = value;
+		} else {
+			argv[out++] = argv[i];
+		}
+	}
+	argc = out;
+	argv[argc] = nullptr;
+	return options;
+}
+
+}
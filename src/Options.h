@@ -0,0 +1,98 @@
+/*!
+ * @file 		Options.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef OPTIONS_H_
+#define OPTIONS_H_
+#include <string>
+#include "SceneConfig.h"
+
+namespace CAVE {
+
+/*!
+ * Options of the application itself.
+ *
+ * All of them are in form --name or --name=value and they are removed
+ * from the argument list, so CAVElib or GLUT never sees them.
+ */
+struct options_t {
+	//! Run the calibration even if there is a stored result
+	bool calibrate			= false;
+	//! Skip the calibration completely and use the defaults
+	bool no_tuning			= false;
+	//! File with stored calibration results
+	std::string tuning_file;
+	//! Use only update kernels giving identical results on all nodes (--fast-kernels disables it)
+	bool deterministic		= scene_config_t().deterministic;
+	//! Cull particles on the GPU (if supported)
+	bool gpu_culling		= false;
+	//! Fetch the particles in the vertex shader instead of the vertex array (if supported)
+	bool vertex_pulling		= false;
+	//! Draw the particles as point sprites instead of quads from the geometry shader (faster, not the same image)
+	bool point_sprites		= false;
+	//! Simulate the particles on the GPU with transform feedback (not in deterministic mode)
+	bool gpu_simulation		= false;
+	//! File with a data-driven particle behaviour (Behaviour) replacing Particle::update
+	std::string behaviour;
+	//! Compile the behaviour into a native kernel
+	bool native_behaviour	= false;
+	//! Cache of the compiled behaviours, NativeKernel::default_cache_dir() if empty
+	std::string behaviour_cache;
+	//! Render all walls of a display thread with a single draw (if supported)
+	bool multi_viewport		= false;
+	//! Frame rate for reprojection of late frames, 0 disables it
+	double reprojection_fps	= 0.0;
+	//! Directory for flight recorder dumps, empty disables the recorder
+	std::string flight_recorder;
+	//! Frame time considered a missed deadline (ms)
+	double frame_deadline_ms	= 20.0;
+	//! Samples per second of the sampling profiler, 0 disables it
+	double profile_frequency	= 0.0;
+	//! Sample by wall clock instead of CPU time (shows waiting in barriers)
+	bool profile_wall_clock		= false;
+	//! File for the folded stacks, profile-<hostname>.folded if empty
+	std::string profile_output;
+	//! Account energy per frame and phase from the RAPL counters
+	bool energy				= false;
+	//! Size of the arena shared by display processes (MB, multi-process CAVElib only)
+	size_t shared_arena_mb	= 512;
+	//! Static point cloud (binary PLY) rendered with progressive refinement, empty disables it
+	std::string point_cloud;
+	//! Points of the cloud drawn in every frame until the view converges
+	size_t cloud_points_per_frame	= 1000000;
+	//! Wall showing the performance HUD (CAVElib wall id, any value shows it with GLUT), -1 disables it
+	int hud_wall			= -1;
+	//! Present the previous frame again when nothing changed, instead of rendering it
+	bool on_demand			= false;
+	//! Frames between readbacks of the overdraw counts, 0 disables the measurement (needs a stencil buffer)
+	size_t overdraw_interval	= 0;
+	//! Show the overdraw heatmap instead of the scene
+	bool overdraw_heatmap	= false;
+	//! UNIX domain socket for runtime control commands ("-" for stdin), empty disables it
+	std::string control;
+
+	//! Run the stress ramp to find the maximal sustainable population
+	bool stress_ramp			= false;
+	//! Frame rate that has to be sustained
+	double ramp_target_fps		= 60.0;
+	//! Percentile of frame times compared to the target
+	double ramp_percentile		= 99.0;
+	//! Increase of spawn rate (particles per second) in every step
+	size_t ramp_step			= 1000;
+	//! File for the report, standard output is used if empty
+	std::string ramp_report;
+};
+
+options_t parse_options(int& argc, char** argv);
+
+}
+
+
+
+#endif /* OPTIONS_H_ */
@@ -0,0 +1,242 @@
+/*!
+ * @file 		OverdrawMeter.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		23.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "OverdrawMeter.h"
+#include "platform.h"
+#include <iostream>
+
+namespace CAVE {
+
+namespace {
+
+const size_t max_count = 255;
+
+//! Colors of the heatmap, every level covers pixels with at least its layers
+const struct {
+	GLuint layers;
+	GLubyte color[3];
+} heat_levels[] = {
+		{0,		{0, 0, 0}},
+		{1,		{0, 0, 96}},
+		{2,		{0, 0, 255}},
+		{4,		{0, 255, 255}},
+		{8,		{0, 255, 0}},
+		{16,	{255, 255, 0}},
+		{32,	{255, 128, 0}},
+		{64,	{255, 0, 0}},
+		{128,	{255, 0, 255}},
+		{255,	{255, 255, 255}},
+};
+
+overdraw_stats_t summarize(size_t views, const std::vector<uint64_t>& histogram)
+{
+	overdraw_stats_t stats;
+	stats.views = views;
+	uint64_t pixels = 0;
+	uint64_t fragments = 0;
+	for (size_t count = 0; count < histogram.size(); ++count) {
+		pixels += histogram[count];
+		fragments += count * histogram[count];
+		if (histogram[count]) stats.max = count;
+	}
+	if (!pixels) return stats;
+	const uint64_t covered = pixels - histogram[0];
+	stats.mean = static_cast<double>(fragments) / pixels;
+	stats.coverage = static_cast<double>(covered) / pixels;
+	stats.saturated = static_cast<double>(histogram[max_count]) / pixels;
+	if (!covered) return stats;
+	stats.covered_mean = static_cast<double>(fragments) / covered;
+	uint64_t below = 0;
+	for (size_t count = 1; count < histogram.size(); ++count) {
+		below += histogram[count];
+		if (below >= 0.99 * covered) {
+			stats.p99 = count;
+			break;
+		}
+	}
+	return stats;
+}
+}
+
+OverdrawMeter::OverdrawMeter(size_t sample_interval, bool heatmap):
+sample_interval_(sample_interval),heatmap_(heatmap)
+{
+
+}
+
+void OverdrawMeter::begin_frame()
+{
+	thread_t& thread = get_thread();
+	for (auto& view: thread.views) {
+		if (view.pending) collect(view);
+	}
+	++thread.frame;
+	thread.view_index = 0;
+}
+
+void OverdrawMeter::begin_view()
+{
+	thread_t& thread = get_thread();
+	if (!thread.checked) {
+		thread.checked = true;
+		GLint bits = 0;
+		glGetIntegerv(GL_STENCIL_BITS, &bits);
+		thread.supported = bits >= 8;
+		if (!thread.supported) std::cerr << "Overdraw needs an 8-bit stencil buffer, it has " << bits << " bits\n";
+	}
+	if (!thread.supported || (!sampling(thread) && !heatmap_)) return;
+	thread.counting = true;
+	glClearStencil(0);
+	glStencilMask(0xFF);
+	glClear(GL_STENCIL_BUFFER_BIT);
+	glEnable(GL_STENCIL_TEST);
+	glStencilFunc(GL_ALWAYS, 0, 0xFF);
+	// Without depth test every fragment passes, with it the hidden ones are counted too
+	glStencilOp(GL_KEEP, GL_INCR, GL_INCR);
+}
+
+void OverdrawMeter::end_view()
+{
+	thread_t& thread = get_thread();
+	if (!thread.counting) return;
+	thread.counting = false;
+	if (thread.views.size() <= thread.view_index) thread.views.resize(thread.view_index + 1);
+	view_t& view = thread.views[thread.view_index++];
+	if (sampling(thread)) read_counts(view);
+	if (heatmap_) draw_heatmap();
+	glDisable(GL_STENCIL_TEST);
+}
+
+std::map<int, overdraw_stats_t> OverdrawMeter::get_stats() const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	std::map<int, overdraw_stats_t> stats;
+	for (const auto& wall: walls_) {
+		stats[wall.first] = summarize(wall.second.first, wall.second.second);
+	}
+	return stats;
+}
+
+void OverdrawMeter::reset()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	walls_.clear();
+}
+
+void OverdrawMeter::release()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	auto it = threads_.find(get_thread_id());
+	if (it == threads_.end()) return;
+	for (auto& view: it->second.views) {
+		if (view.pbo) glDeleteBuffers(1, &view.pbo);
+	}
+	threads_.erase(it);
+}
+
+void OverdrawMeter::report(std::ostream& os) const
+{
+	for (const auto& wall: get_stats()) {
+		const overdraw_stats_t& stats = wall.second;
+		os << "Overdraw of wall " << wall.first << " (" << stats.views << " views): mean " << stats.mean
+				<< " layers, " << stats.covered_mean << " on covered pixels (" << stats.coverage * 100.0
+				<< " %), p99 " << stats.p99 << ", max " << stats.max;
+		if (stats.saturated > 0.0) os << ", " << stats.saturated * 100.0 << " % of pixels saturated";
+		os << "\n";
+	}
+}
+
+OverdrawMeter::thread_t& OverdrawMeter::get_thread()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	return threads_[get_thread_id()];
+}
+
+bool OverdrawMeter::sampling(const thread_t& thread) const
+{
+	return sample_interval_ && thread.frame % sample_interval_ == 0;
+}
+
+void OverdrawMeter::read_counts(view_t& view)
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	view.width = viewport[2];
+	view.height = viewport[3];
+	view.wall = get_wall_id();
+	const size_t size = static_cast<size_t>(view.width) * view.height;
+	if (!view.pbo) glGenBuffers(1, &view.pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, view.pbo);
+	if (view.capacity < size) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		view.capacity = size;
+	}
+	GLint alignment = 4;
+	glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	// Only queued here, the transfer finishes while the next views render
+	glReadPixels(viewport[0], viewport[1], view.width, view.height, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, nullptr);
+	glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	view.pending = true;
+}
+
+void OverdrawMeter::collect(view_t& view)
+{
+	view.pending = false;
+	histogram_t histogram(max_count + 1, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, view.pbo);
+	const GLubyte* counts = static_cast<const GLubyte*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+	if (counts) {
+		const size_t size = static_cast<size_t>(view.width) * view.height;
+		for (size_t i = 0; i < size; ++i) {
+			++histogram[counts[i]];
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (!counts) return;
+	std::unique_lock<std::mutex> _(mutex_);
+	auto& wall = walls_[view.wall];
+	if (wall.second.empty()) wall.second.resize(max_count + 1, 0);
+	++wall.first;
+	for (size_t count = 0; count <= max_count; ++count) {
+		wall.second[count] += histogram[count];
+	}
+}
+
+void OverdrawMeter::draw_heatmap() const
+{
+	const bool blend = glIsEnabled(GL_BLEND);
+	const bool depth_test = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	// Higher levels are drawn over the lower ones
+	for (const auto& level: heat_levels) {
+		glStencilFunc(GL_LEQUAL, level.layers, 0xFF);
+		glColor3ubv(level.color);
+		glRectf(-1.0f, -1.0f, 1.0f, 1.0f);
+	}
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glColor3f(1.0f, 1.0f, 1.0f);
+	if (blend) glEnable(GL_BLEND);
+	if (depth_test) glEnable(GL_DEPTH_TEST);
+}
+
+}
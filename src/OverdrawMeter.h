@@ -0,0 +1,116 @@
+/*!
+ * @file 		OverdrawMeter.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		23.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef OVERDRAWMETER_H_
+#define OVERDRAWMETER_H_
+#include <GL/glew.h>
+#include <ostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+namespace CAVE {
+
+//! Overdraw of the sampled views of one wall, in layers (fragments per pixel)
+struct overdraw_stats_t {
+	size_t views		= 0;
+	//! Mean over all the pixels
+	double mean			= 0.0;
+	//! Fraction of the pixels with at least one fragment
+	double coverage		= 0.0;
+	//! Mean over the covered pixels
+	double covered_mean	= 0.0;
+	//! 99th percentile over the covered pixels
+	unsigned int p99	= 0;
+	unsigned int max	= 0;
+	//! Fraction of the pixels at the limit of the stencil buffer (their count is a lower bound)
+	double saturated	= 0.0;
+};
+
+/*!
+ * Counts fragments per pixel to tell whether the fill rate limits the rendering.
+ *
+ * Every fragment of the scene increments the stencil buffer. In every sample_interval-th frame
+ * the stencil of all views is read into pixel buffers, which are mapped only
+ * at the start of the next frame, so the readback doesn't stall the pipeline.
+ * The heatmap replaces the view with colors of the counts (drawn with stencil tests).
+ *
+ * Needs a stencil buffer and as the scene doesn't clear it, nothing else
+ * may use it during the view. The 8-bit counts saturate at 255 layers.
+ *
+ * Like the other GL wrappers, it holds per-context data
+ * and release() has to be called from every thread.
+ */
+class OverdrawMeter {
+public:
+	/*!
+	 * @param sample_interval Frames between readbacks (0 for the heatmap only)
+	 * @param heatmap Show the counts instead of the views
+	 */
+	OverdrawMeter(size_t sample_interval, bool heatmap);
+	//! Starts a new frame in the current thread, collects the samples of the previous one
+	void begin_frame();
+	//! Starts counting fragments of the current view
+	void begin_view();
+	//! Stops counting, reads back the counts and draws the heatmap (as needed)
+	void end_view();
+	//! Statistics of the walls (CAVElib wall id, 0 with GLUT)
+	std::map<int, overdraw_stats_t> get_stats() const;
+	//! Forgets all the samples
+	void reset();
+	//! Deletes GL objects of the current thread
+	void release();
+	//! Prints the statistics of all walls
+	void report(std::ostream& os) const;
+private:
+	struct view_t {
+		view_t(): pbo(0), capacity(0), width(0), height(0), wall(0), pending(false) {}
+		GLuint pbo;
+		size_t capacity;
+		GLsizei width;
+		GLsizei height;
+		int wall;
+		//! The pbo has a readback not collected yet
+		bool pending;
+	};
+	struct thread_t {
+		thread_t(): frame(0), view_index(0), checked(false), supported(false), counting(false) {}
+		size_t frame;
+		size_t view_index;
+		std::vector<view_t> views;
+		//! Stencil buffer was checked (in the first view)
+		bool checked;
+		bool supported;
+		//! Between begin_view and end_view
+		bool counting;
+	};
+	//! Pixels per count, with 256 bins
+	typedef std::vector<uint64_t> histogram_t;
+
+	thread_t& get_thread();
+	bool sampling(const thread_t& thread) const;
+	void read_counts(view_t& view);
+	void collect(view_t& view);
+	void draw_heatmap() const;
+
+	const size_t sample_interval_;
+	const bool heatmap_;
+	mutable std::mutex mutex_;
+	std::map<int, thread_t> threads_;
+	//! Accumulated samples per wall, with the number of views (guarded by mutex_)
+	std::map<int, std::pair<size_t, histogram_t>> walls_;
+};
+
+}
+
+
+
+#endif /* OVERDRAWMETER_H_ */
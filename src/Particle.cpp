@@ -10,11 +10,9 @@
 #include "Particle.h"
 namespace CAVE {
 
-namespace {
-const point3 gravity {0.0f, -1.0f, 0.0f};
-const float default_life = 10.0f;
-const float slowdown_per_second = 0.2f;
-}
+const float Particle::default_life = 10.0f;
+const point3 Particle::gravity {0.0f, -1.0f, 0.0f};
+const float Particle::slowdown_per_second = 0.2f;
 
 Particle::Particle(const point3& position, const point3& direction):
 position(position), direction(direction),life(default_life)
@@ -22,13 +20,6 @@ position(position), direction(direction),life(default_life)
 
 }
 
-void Particle::update(float time_delta)
-{
-	position = position + (time_delta*direction);
-	direction = (1.0f - time_delta * slowdown_per_second) * direction + time_delta * gravity;
-	life -= time_delta;
-}
-
 }
 
 
@@ -19,6 +19,10 @@ public:
 	~Particle() noexcept = default;
 	bool dead() const { return life < 0;}
 	void update(float time_delta);
+	//! Initial life of new particles (in seconds)
+	static const float default_life;
+	static const point3 gravity;
+	static const float slowdown_per_second;
 
 	point3 position;
 	point3 direction;
@@ -26,6 +30,17 @@ public:
 
 };
 
+/*
+ * Defined here, so the ISA variants of the update kernels (ParticleKernels.cpp)
+ * can inline it. The expression must not be reordered, all nodes of the cluster
+ * have to compute bit-identical results.
+ */
+inline void Particle::update(float time_delta)
+{
+	position = position + (time_delta*direction);
+	direction = (1.0f - time_delta * slowdown_per_second) * direction + time_delta * gravity;
+	life -= time_delta;
+}
 
 }
 
@@ -0,0 +1,156 @@
+/*!
+ * @file 		ParticleKernels.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		17.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "ParticleKernels.h"
+#include <random>
+#include <cstring>
+#include <iostream>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KERNELS_X86
+#endif
+
+namespace CAVE {
+
+namespace {
+const unsigned int verification_seed = 7;
+
+void update_scalar(Particle* particles, size_t count, float time_delta)
+{
+	for (size_t i = 0; i < count; ++i) {
+		particles[i].update(time_delta);
+	}
+}
+
+#ifdef KERNELS_X86
+__attribute__((target("avx2")))
+void update_avx2(Particle* particles, size_t count, float time_delta)
+{
+	for (size_t i = 0; i < count; ++i) {
+		particles[i].update(time_delta);
+	}
+}
+
+__attribute__((target("avx512f")))
+void update_avx512(Particle* particles, size_t count, float time_delta)
+{
+	for (size_t i = 0; i < count; ++i) {
+		particles[i].update(time_delta);
+	}
+}
+
+#ifndef STRICT_DETERMINISM
+// Without -ffp-contract=off the multiply-adds are contracted to FMA
+__attribute__((target("avx2,fma")))
+void update_avx2_fma(Particle* particles, size_t count, float time_delta)
+{
+	for (size_t i = 0; i < count; ++i) {
+		particles[i].update(time_delta);
+	}
+}
+#endif
+#endif
+
+kernel_isa_t pick_kernel(bool deterministic)
+{
+	for (auto isa: available_kernels()) {
+		if (!deterministic) return isa;
+		if (!is_deterministic(isa)) continue;
+		if (verify_kernel(isa)) return isa;
+		std::cerr << "Update kernel " << to_string(isa) << " differs from Particle::update, not using it\n";
+	}
+	return kernel_isa_t::scalar;
+}
+}
+
+std::string to_string(kernel_isa_t isa)
+{
+	switch (isa) {
+		case kernel_isa_t::avx2: return "avx2";
+		case kernel_isa_t::avx2_fma: return "avx2_fma";
+		case kernel_isa_t::avx512: return "avx512";
+		default: return "scalar";
+	}
+}
+
+std::vector<kernel_isa_t> available_kernels()
+{
+	std::vector<kernel_isa_t> kernels;
+#ifdef KERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) kernels.push_back(kernel_isa_t::avx512);
+#ifndef STRICT_DETERMINISM
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) kernels.push_back(kernel_isa_t::avx2_fma);
+#endif
+	if (__builtin_cpu_supports("avx2")) kernels.push_back(kernel_isa_t::avx2);
+#endif
+	kernels.push_back(kernel_isa_t::scalar);
+	return kernels;
+}
+
+update_kernel_t get_kernel(kernel_isa_t isa)
+{
+	switch (isa) {
+#ifdef KERNELS_X86
+		case kernel_isa_t::avx2: return update_avx2;
+		case kernel_isa_t::avx512: return update_avx512;
+#ifndef STRICT_DETERMINISM
+		case kernel_isa_t::avx2_fma: return update_avx2_fma;
+#endif
+#endif
+		default: return update_scalar;
+	}
+}
+
+bool is_deterministic(kernel_isa_t isa)
+{
+#ifdef STRICT_DETERMINISM
+	// Built with -ffp-contract=off, so even AVX-512 (which implies FMA) rounds as scalar code
+	(void)isa;
+	return true;
+#else
+	return isa != kernel_isa_t::avx2_fma && isa != kernel_isa_t::avx512;
+#endif
+}
+
+bool verify_kernel(kernel_isa_t isa, size_t count, size_t steps)
+{
+	std::mt19937 generator(verification_seed);
+	std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> direction(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> time_delta(0.001f, 0.05f);
+	std::vector<Particle> reference;
+	reference.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		reference.emplace_back(point3{position(generator), position(generator), position(generator)},
+				point3{direction(generator), direction(generator), direction(generator)});
+	}
+	std::vector<Particle> tested = reference;
+	const update_kernel_t kernel = get_kernel(isa);
+	for (size_t step = 0; step < steps; ++step) {
+		const float delta = time_delta(generator);
+		for (auto& p: reference) {
+			p.update(delta);
+		}
+		kernel(tested.data(), tested.size(), delta);
+	}
+	return std::memcmp(reference.data(), tested.data(), count * sizeof(Particle)) == 0;
+}
+
+kernel_isa_t select_kernel(bool deterministic)
+{
+	if (deterministic) {
+		static const kernel_isa_t exact = pick_kernel(true);
+		return exact;
+	}
+	static const kernel_isa_t fastest = pick_kernel(false);
+	return fastest;
+}
+
+}
@@ -0,0 +1,68 @@
+/*!
+ * @file 		ParticleKernels.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		17.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef PARTICLEKERNELS_H_
+#define PARTICLEKERNELS_H_
+#include "Particle.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace CAVE {
+
+/*!
+ * Instruction set variants of the particle update loop.
+ *
+ * All variants are compiled from the same loop over Particle::update.
+ * Plain vector instructions give results identical to the scalar code,
+ * only contraction of a*b+c into FMA changes the rounding. AVX-512 implies
+ * FMA, so without STRICT_DETERMINISM (-ffp-contract=off) neither avx2_fma
+ * nor avx512 is used in deterministic mode. With it, the avx2_fma variant
+ * would be the same as avx2 and it is not compiled at all.
+ */
+enum class kernel_isa_t {
+	scalar,
+	avx2,
+	avx2_fma,
+	avx512
+};
+
+std::string to_string(kernel_isa_t isa);
+
+typedef void (*update_kernel_t)(Particle* particles, size_t count, float time_delta);
+
+/*!
+ * Variants compiled in and supported by the current CPU, fastest first
+ */
+std::vector<kernel_isa_t> available_kernels();
+
+update_kernel_t get_kernel(kernel_isa_t isa);
+
+//! Whether the variant rounds exactly as the scalar code
+bool is_deterministic(kernel_isa_t isa);
+
+/*!
+ * Compares results of the variant with Particle::update bit by bit.
+ * @param count Number of random particles to check
+ * @param steps Number of updates (with varying time deltas)
+ */
+bool verify_kernel(kernel_isa_t isa, size_t count = 4096, size_t steps = 100);
+
+/*!
+ * Returns the fastest usable variant.
+ * In deterministic mode the candidates are verified first (only once per process).
+ */
+kernel_isa_t select_kernel(bool deterministic);
+
+}
+
+
+
+#endif /* PARTICLEKERNELS_H_ */
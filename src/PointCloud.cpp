@@ -0,0 +1,172 @@
+/*!
+ * @file 		PointCloud.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		5.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "PointCloud.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sstream>
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cstring>
+
+namespace CAVE {
+
+namespace {
+//! The header has to fit into the first read
+const size_t header_read_size = 64 * 1024;
+//! Size of the reads of the vertex data
+const size_t chunk_size = 4 * 1024 * 1024;
+//! Fixed, so the order (and the subsets) are the same on all nodes
+const unsigned int shuffle_seed = 1;
+const uint8_t default_color[4] = {200, 200, 200, 255};
+
+size_t type_size(const std::string& type)
+{
+	if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+	if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+	if (type == "int" || type == "uint" || type == "float" || type == "int32" ||
+			type == "uint32" || type == "float32") return 4;
+	if (type == "double" || type == "float64") return 8;
+	return 0;
+}
+}
+
+PointCloud::PointCloud(AsyncIO& io, const std::string& path):
+io_(io),path_(path),fd_(open(path.c_str(), O_RDONLY)),state_(state_t::reading),
+format_(),pending_reads_(0)
+{
+	if (fd_ < 0) {
+		fail("can't open the file");
+		return;
+	}
+	read_header();
+}
+
+PointCloud::~PointCloud() noexcept
+{
+	// The reads write into raw_
+	while (pending_reads_) io_.poll(true);
+	if (converter_.joinable()) converter_.join();
+	if (fd_ >= 0) close(fd_);
+}
+
+void PointCloud::fail(const std::string& message)
+{
+	std::cerr << "Failed to load point cloud " << path_ << ": " << message << "\n";
+	state_ = state_t::failed;
+}
+
+void PointCloud::read_header()
+{
+	raw_.resize(header_read_size);
+	++pending_reads_;
+	io_.read(fd_, raw_.data(), raw_.size(), 0, io_priority_t::prefetch, [this](const io_result_t& result) {
+		--pending_reads_;
+		if (result.error) return fail(std::strerror(result.error));
+		const std::string text(raw_.data(), result.bytes);
+		const std::string end_marker = "end_header\n";
+		const size_t end = text.find(end_marker);
+		if (text.compare(0, 4, "ply\n") != 0 || end == std::string::npos) return fail("not a PLY file");
+
+		std::istringstream header(text.substr(0, end));
+		std::string line;
+		std::string element;
+		bool vertex_seen = false;
+		std::fill(format_.offsets, format_.offsets + 6, -1);
+		const char* names[6] = {"x", "y", "z", "red", "green", "blue"};
+		const char* types[6] = {"float", "float", "float", "uchar", "uchar", "uchar"};
+		// Alternative names of the same types
+		const char* aliases[6] = {"float32", "float32", "float32", "uint8", "uint8", "uint8"};
+		while (std::getline(header, line)) {
+			std::istringstream words(line);
+			std::string keyword;
+			words >> keyword;
+			if (keyword == "format") {
+				std::string format;
+				words >> format;
+				if (format != "binary_little_endian") return fail("only binary_little_endian is supported");
+			} else if (keyword == "element") {
+				size_t count = 0;
+				words >> element >> count;
+				if (element == "vertex") {
+					format_.count = count;
+					vertex_seen = true;
+				} else if (!vertex_seen) return fail("vertex has to be the first element");
+			} else if (keyword == "property" && element == "vertex") {
+				std::string type;
+				std::string name;
+				words >> type >> name;
+				const size_t size = type_size(type);
+				if (!size) return fail("unsupported property " + type + " " + name);
+				for (int i = 0; i < 6; ++i) {
+					if (name != names[i]) continue;
+					// Values are read as they are, so other types of the same size would be misread
+					if (type != types[i] && type != aliases[i]) return fail("unsupported property " + type + " " + name);
+					format_.offsets[i] = static_cast<int>(format_.stride);
+				}
+				format_.stride += size;
+			}
+		}
+		if (format_.offsets[0] < 0 || format_.offsets[1] < 0 || format_.offsets[2] < 0) {
+			return fail("missing float x, y or z");
+		}
+		read_body(end + end_marker.size());
+	});
+}
+
+void PointCloud::read_body(size_t header_size)
+{
+	const size_t size = format_.count * format_.stride;
+	raw_.assign(size, 0);
+	for (size_t offset = 0; offset < size; offset += chunk_size) {
+		const size_t bytes = std::min(chunk_size, size - offset);
+		++pending_reads_;
+		io_.read(fd_, raw_.data() + offset, bytes, header_size + offset, io_priority_t::prefetch,
+				[this, bytes](const io_result_t& result) {
+			--pending_reads_;
+			if (state_ == state_t::failed) return;
+			if (result.error) return fail(std::strerror(result.error));
+			if (result.bytes < bytes) return fail("unexpected end of file");
+			if (!pending_reads_) {
+				state_ = state_t::converting;
+				converter_ = std::thread([this](){convert();});
+			}
+		});
+	}
+	if (!size) state_ = state_t::loaded;
+}
+
+void PointCloud::convert()
+{
+	std::vector<cloud_point_t> points(format_.count);
+	const bool has_color = format_.offsets[3] >= 0 && format_.offsets[4] >= 0 && format_.offsets[5] >= 0;
+	for (size_t i = 0; i < points.size(); ++i) {
+		const char* vertex = raw_.data() + i * format_.stride;
+		cloud_point_t& point = points[i];
+		for (int axis = 0; axis < 3; ++axis) {
+			std::memcpy(&point.position[axis], vertex + format_.offsets[axis], sizeof(float));
+		}
+		if (has_color) {
+			for (int channel = 0; channel < 3; ++channel) {
+				point.color[channel] = static_cast<uint8_t>(vertex[format_.offsets[3 + channel]]);
+			}
+			point.color[3] = 255;
+		} else {
+			std::copy(default_color, default_color + 4, point.color);
+		}
+	}
+	std::vector<char>().swap(raw_);
+	std::shuffle(points.begin(), points.end(), std::mt19937(shuffle_seed));
+	points_.swap(points);
+	std::cout << "Point cloud " << path_ << " loaded, " << points_.size() << " points\n";
+	state_ = state_t::loaded;
+}
+
+}
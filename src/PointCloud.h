@@ -0,0 +1,85 @@
+/*!
+ * @file 		PointCloud.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		5.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef POINTCLOUD_H_
+#define POINTCLOUD_H_
+#include "AsyncIO.h"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+namespace CAVE {
+
+//! Vertex of the point cloud as uploaded to the GPU
+struct cloud_point_t {
+	float position[3];
+	uint8_t color[4];
+};
+
+/*!
+ * Static point cloud loaded from a binary little endian PLY file
+ * (vertex element with float x, y, z and optional uchar red, green, blue).
+ *
+ * The file is read in the background through AsyncIO (as prefetch), the callbacks
+ * run in the thread polling it. The points are then shuffled in a separate thread,
+ * so any prefix of points() is a random subset of the cloud.
+ *
+ * points() must not be used before loaded() returns true, it never changes afterwards.
+ */
+class PointCloud {
+public:
+	PointCloud(AsyncIO& io, const std::string& path);
+	//! Waits for the reads in flight (polling @em io)
+	~PointCloud() noexcept;
+	PointCloud(const PointCloud&) = delete;
+	PointCloud& operator=(const PointCloud&) = delete;
+
+	bool loaded() const { return state_ == state_t::loaded; }
+	bool failed() const { return state_ == state_t::failed; }
+	const std::vector<cloud_point_t>& points() const { return points_; }
+	const std::string& get_path() const { return path_; }
+private:
+	enum class state_t {
+		reading,
+		converting,
+		loaded,
+		failed
+	};
+	//! Layout of a vertex in the file
+	struct format_t {
+		size_t count;
+		size_t stride;
+		//! Offsets of x, y, z, red, green, blue (-1 if missing)
+		int offsets[6];
+	};
+
+	void read_header();
+	void read_body(size_t header_size);
+	void fail(const std::string& message);
+	void convert();
+
+	AsyncIO& io_;
+	const std::string path_;
+	int fd_;
+	std::atomic<state_t> state_;
+	format_t format_;
+	std::vector<char> raw_;
+	size_t pending_reads_;
+	std::vector<cloud_point_t> points_;
+	std::thread converter_;
+};
+
+}
+
+
+
+#endif /* POINTCLOUD_H_ */
@@ -0,0 +1,248 @@
+/*!
+ * @file 		ProgressiveRenderer.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		5.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "ProgressiveRenderer.h"
+#include "geometry.h"
+#include "platform.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace CAVE {
+
+namespace {
+
+const std::string point_vertex_shader = R"XXX(
+		#version 150
+		uniform mat4 matrix;
+		in vec3 position;
+		in vec4 color;
+		out vec4 point_color;
+		void main() {
+			gl_Position = matrix * vec4(position, 1.0);
+			point_color = color;
+		}
+)XXX";
+
+const std::string point_fragment_shader = R"XXX(
+		#version 150
+		in vec4 point_color;
+		out vec4 color;
+		void main() {
+			color = point_color;
+		}
+)XXX";
+
+//! A triangle covering the whole view, generated from gl_VertexID
+const std::string composite_vertex_shader = R"XXX(
+		#version 150
+		out vec2 texcoords;
+		void main() {
+			texcoords = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+			gl_Position = vec4(texcoords * 2.0 - 1.0, 0.0, 1.0);
+		}
+)XXX";
+
+//! Copies the accumulated color and depth, pixels without any point are left untouched
+const std::string composite_fragment_shader = R"XXX(
+		#version 150
+		uniform sampler2D color_texture;
+		uniform sampler2D depth_texture;
+		in vec2 texcoords;
+		out vec4 color;
+		void main() {
+			float depth = texture(depth_texture, texcoords).r;
+			if (depth >= 1.0) discard;
+			color = texture(color_texture, texcoords);
+			gl_FragDepth = depth;
+		}
+)XXX";
+
+//! Largest difference of matrix elements still considered the same view
+const GLfloat matrix_tolerance = 1e-5f;
+
+bool same_matrix(const GLfloat* a, const GLfloat* b)
+{
+	for (int i = 0; i < 16; ++i) {
+		if (std::abs(a[i] - b[i]) > matrix_tolerance) return false;
+	}
+	return true;
+}
+}
+
+ProgressiveRenderer::ProgressiveRenderer(const PointCloud& cloud, size_t points_per_frame):
+cloud_(cloud),points_per_frame_(std::max<size_t>(points_per_frame, 1))
+{
+
+}
+
+void ProgressiveRenderer::begin_frame()
+{
+	get_thread().view_index = 0;
+}
+
+void ProgressiveRenderer::render(const std::function<void()>& navigation)
+{
+	if (!cloud_.loaded()) return;
+	thread_t& thread = get_thread();
+	if (!thread.point_shader) prepare(thread);
+	{
+		// The views are read by converged() from another thread
+		std::unique_lock<std::mutex> _(mutex_);
+		if (thread.views.size() <= thread.view_index) thread.views.resize(thread.view_index + 1);
+	}
+	view_t& view = thread.views[thread.view_index++];
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLfloat projection[16];
+	GLfloat modelview[16];
+	GLfloat matrix[16];
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glPushMatrix();
+	navigation();
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	glPopMatrix();
+	multiply_matrices(projection, modelview, matrix);
+
+	// The view may be rendered into another framebuffer (e.g. by Reprojection)
+	GLint framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	const bool same_size = view.target.width() == viewport[2] && view.target.height() == viewport[3];
+	if (!same_size || !same_matrix(matrix, view.matrix)) {
+		if (!view.target.resize(viewport[2], viewport[3])) return;
+		view.target.bind();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		std::copy(matrix, matrix + 16, view.matrix);
+		std::unique_lock<std::mutex> _(mutex_);
+		view.drawn = 0;
+	}
+	if (view.drawn < cloud_.points().size()) {
+		view.target.bind();
+		refine(thread, view);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	composite(thread, view);
+}
+
+void ProgressiveRenderer::prepare(thread_t& thread)
+{
+	const std::vector<cloud_point_t>& points = cloud_.points();
+	glGenBuffers(1, &thread.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, thread.vbo);
+	glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(cloud_point_t), points.data(), GL_STATIC_DRAW);
+	glGenVertexArrays(1, &thread.vao);
+	glBindVertexArray(thread.vao);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(cloud_point_t),
+			reinterpret_cast<const GLvoid*>(offsetof(cloud_point_t, position)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(cloud_point_t),
+			reinterpret_cast<const GLvoid*>(offsetof(cloud_point_t, color)));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glGenVertexArrays(1, &thread.empty_vao);
+
+	thread.point_shader.reset(new ShaderProgram(point_vertex_shader, point_fragment_shader));
+	thread.point_shader->bind_attrib(0, "position");
+	thread.point_shader->bind_attrib(1, "color");
+	thread.point_shader->bind_frag_data(0, "color");
+	thread.point_shader->link();
+	thread.composite_shader.reset(new ShaderProgram(composite_vertex_shader, composite_fragment_shader));
+	thread.composite_shader->bind_frag_data(0, "color");
+	thread.composite_shader->link();
+}
+
+void ProgressiveRenderer::refine(thread_t& thread, view_t& view)
+{
+	// The points are shuffled, so the next range is a random subset
+	const size_t count = std::min(points_per_frame_, cloud_.points().size() - view.drawn);
+	const bool depth_test = glIsEnabled(GL_DEPTH_TEST);
+	const bool blend = glIsEnabled(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	thread.point_shader->bind();
+	thread.point_shader->set_uniform_matrix4("matrix", view.matrix);
+	glBindVertexArray(thread.vao);
+	glDrawArrays(GL_POINTS, static_cast<GLint>(view.drawn), static_cast<GLsizei>(count));
+	glBindVertexArray(0);
+	thread.point_shader->unbind();
+	if (!depth_test) glDisable(GL_DEPTH_TEST);
+	if (blend) glEnable(GL_BLEND);
+	std::unique_lock<std::mutex> _(mutex_);
+	view.drawn += count;
+}
+
+void ProgressiveRenderer::composite(thread_t& thread, const view_t& view)
+{
+	GLint depth_func = GL_LESS;
+	glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+	const bool depth_test = glIsEnabled(GL_DEPTH_TEST);
+	const bool blend = glIsEnabled(GL_BLEND);
+	// Depth is written only with the test enabled
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glDisable(GL_BLEND);
+	thread.composite_shader->bind();
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, view.target.depth_texture());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, view.target.color_texture());
+	thread.composite_shader->set_uniform_int("color_texture", 0);
+	thread.composite_shader->set_uniform_int("depth_texture", 1);
+	glBindVertexArray(thread.empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	thread.composite_shader->unbind();
+	glDepthFunc(depth_func);
+	if (!depth_test) glDisable(GL_DEPTH_TEST);
+	if (blend) glEnable(GL_BLEND);
+}
+
+void ProgressiveRenderer::release()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	auto it = threads_.find(get_thread_id());
+	if (it == threads_.end()) return;
+	thread_t& thread = it->second;
+	for (auto& view: thread.views) {
+		view.target.release();
+	}
+	if (thread.point_shader) thread.point_shader->release();
+	if (thread.composite_shader) thread.composite_shader->release();
+	if (thread.vbo) glDeleteBuffers(1, &thread.vbo);
+	if (thread.vao) glDeleteVertexArrays(1, &thread.vao);
+	if (thread.empty_vao) glDeleteVertexArrays(1, &thread.empty_vao);
+	threads_.erase(it);
+}
+
+bool ProgressiveRenderer::converged() const
+{
+	if (cloud_.failed()) return true;
+	if (!cloud_.loaded()) return false;
+	std::unique_lock<std::mutex> _(mutex_);
+	bool any_view = false;
+	for (const auto& thread: threads_) {
+		for (const auto& view: thread.second.views) {
+			if (view.drawn < cloud_.points().size()) return false;
+			any_view = true;
+		}
+	}
+	return any_view;
+}
+
+ProgressiveRenderer::thread_t& ProgressiveRenderer::get_thread()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	return threads_[get_thread_id()];
+}
+
+}
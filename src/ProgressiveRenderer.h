@@ -0,0 +1,88 @@
+/*!
+ * @file 		ProgressiveRenderer.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		5.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef PROGRESSIVERENDERER_H_
+#define PROGRESSIVERENDERER_H_
+#include "PointCloud.h"
+#include "Shader.h"
+#include "RenderTarget.h"
+#include <functional>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+
+namespace CAVE {
+
+/*!
+ * Renders a static PointCloud with progressive refinement.
+ *
+ * Every view (wall and eye) accumulates the cloud in its own RenderTarget,
+ * a fixed number of points per frame. The points are shuffled, so every frame
+ * adds a random subset and the view converges to the full cloud after
+ * size / points_per_frame frames. Any change of the matrices (navigation
+ * or head tracking) or of the viewport starts the view over.
+ *
+ * The accumulated view is composited over the framebuffer (with its depth).
+ *
+ * Like the other GL wrappers, it holds per-context data
+ * and release() has to be called from every thread.
+ */
+class ProgressiveRenderer {
+public:
+	ProgressiveRenderer(const PointCloud& cloud, size_t points_per_frame);
+	//! Starts a new frame in the current thread
+	void begin_frame();
+	/*!
+	 * Refines the current view and draws it. The matrices have to be set up for the view,
+	 * @em navigation is applied to the modelview matrix. Does nothing until the cloud is loaded.
+	 */
+	void render(const std::function<void()>& navigation);
+	//! Deletes GL objects of the current thread
+	void release();
+	//! Whether all the views rendered so far contain the whole cloud (or it failed to load)
+	bool converged() const;
+private:
+	struct view_t {
+		RenderTarget target;
+		//! Projection * modelview (including navigation) of the accumulated points
+		GLfloat matrix[16];
+		//! Points accumulated so far (written with mutex_ locked)
+		size_t drawn = 0;
+	};
+	struct thread_t {
+		thread_t(): vbo(0), vao(0), empty_vao(0), view_index(0) {}
+		//! Created once the cloud is loaded (in the context of the thread)
+		std::unique_ptr<ShaderProgram> point_shader;
+		std::unique_ptr<ShaderProgram> composite_shader;
+		GLuint vbo;
+		GLuint vao;
+		//! For the fullscreen triangle generated from gl_VertexID
+		GLuint empty_vao;
+		size_t view_index;
+		std::vector<view_t> views;
+	};
+
+	thread_t& get_thread();
+	void prepare(thread_t& thread);
+	void refine(thread_t& thread, view_t& view);
+	void composite(thread_t& thread, const view_t& view);
+
+	const PointCloud& cloud_;
+	const size_t points_per_frame_;
+	mutable std::mutex mutex_;
+	std::map<int, thread_t> threads_;
+};
+
+}
+
+
+
+#endif /* PROGRESSIVERENDERER_H_ */
@@ -0,0 +1,109 @@
+/*!
+ * @file 		RelayTree.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		16.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "RelayTree.h"
+#include "FrameClock.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <cstring>
+
+namespace CAVE {
+
+RelayTree::RelayTree(size_t nodes, size_t fanout):
+nodes_(std::max<size_t>(nodes, 1)),fanout_(fanout ? fanout : std::max<size_t>(nodes_ - 1, 1))
+{
+
+}
+
+std::vector<size_t> RelayTree::children(size_t node) const
+{
+	std::vector<size_t> nodes;
+	for (size_t child = node * fanout_ + 1; child <= node * fanout_ + fanout_ && child < nodes_; ++child) {
+		nodes.push_back(child);
+	}
+	return nodes;
+}
+
+size_t RelayTree::depth(size_t node) const
+{
+	size_t hops = 0;
+	for (; node; node = parent(node)) ++hops;
+	return hops;
+}
+
+LocalTransport::LocalTransport(size_t nodes, double link_time):
+link_time_(link_time)
+{
+	for (size_t i = 0; i < nodes; ++i) {
+		mailboxes_.emplace_back(new mailbox_t());
+	}
+}
+
+void LocalTransport::send(size_t node, const relay_message_t& message)
+{
+	if (link_time_ > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(link_time_));
+	mailbox_t& mailbox = *mailboxes_.at(node);
+	{
+		std::unique_lock<std::mutex> _(mailbox.mutex);
+		mailbox.messages.push_back(message);
+	}
+	mailbox.ready.notify_one();
+}
+
+relay_message_t LocalTransport::receive(size_t node)
+{
+	mailbox_t& mailbox = *mailboxes_.at(node);
+	std::unique_lock<std::mutex> lock(mailbox.mutex);
+	mailbox.ready.wait(lock, [&mailbox](){return !mailbox.messages.empty();});
+	relay_message_t message = std::move(mailbox.messages.front());
+	mailbox.messages.pop_front();
+	return message;
+}
+
+RelayNode::RelayNode(RelayTransport& transport, const RelayTree& tree, size_t node):
+transport_(transport),children_(tree.children(node)),node_(node),frame_(0)
+{
+
+}
+
+void RelayNode::send(const void* data, size_t size)
+{
+	const header_t header {frame_++, FrameClock::now()};
+	relay_message_t message(sizeof(header) + size);
+	std::memcpy(message.data(), &header, sizeof(header));
+	std::memcpy(message.data() + sizeof(header), data, size);
+	forward(message);
+}
+
+void RelayNode::receive(void* data, size_t size)
+{
+	const relay_message_t message = transport_.receive(node_);
+	// Delivered now, sending to the children is not a part of the latency
+	const double received = FrameClock::now();
+	// The subtree waits for the frame, so it is forwarded before anything else
+	forward(message);
+	header_t header;
+	if (message.size() != sizeof(header) + size) throw std::runtime_error("Relayed frame has unexpected size");
+	std::memcpy(&header, message.data(), sizeof(header));
+	latencies_.push_back(received - header.send_time);
+	if (header.frame != frame_) throw std::runtime_error("Relayed frame out of order");
+	++frame_;
+	std::memcpy(data, message.data() + sizeof(header), size);
+}
+
+void RelayNode::forward(const relay_message_t& message)
+{
+	for (size_t child: children_) {
+		transport_.send(child, message);
+	}
+}
+
+}
@@ -0,0 +1,121 @@
+/*!
+ * @file 		RelayTree.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		16.6.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef RELAYTREE_H_
+#define RELAYTREE_H_
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+namespace CAVE {
+
+/*!
+ * Distribution of the per-frame state through a tree of relays.
+ *
+ * The master (node 0) sends the state only to its children, every node forwards it
+ * to its own children. With fan-out k, node n receives from node (n - 1) / k,
+ * so the master sends k messages instead of one per node and the delivery
+ * takes log_k(nodes) hops.
+ */
+class RelayTree {
+public:
+	/*!
+	 * @param nodes Number of nodes including the master
+	 * @param fanout Children of a node, 0 for all the nodes directly from the master
+	 */
+	RelayTree(size_t nodes, size_t fanout);
+	size_t size() const { return nodes_; }
+	size_t get_fanout() const { return fanout_; }
+	//! Node sending to @em node (not for the master)
+	size_t parent(size_t node) const { return (node - 1) / fanout_; }
+	std::vector<size_t> children(size_t node) const;
+	//! Hops from the master to @em node
+	size_t depth(size_t node) const;
+	//! Hops to the deepest node
+	size_t height() const { return depth(nodes_ - 1); }
+private:
+	const size_t nodes_;
+	const size_t fanout_;
+};
+
+typedef std::vector<char> relay_message_t;
+
+//! Point-to-point messages between the nodes
+class RelayTransport {
+public:
+	virtual ~RelayTransport() = default;
+	virtual void send(size_t node, const relay_message_t& message) = 0;
+	//! Waits for the next message to @em node
+	virtual relay_message_t receive(size_t node) = 0;
+};
+
+/*!
+ * Stand-in for the network, with the nodes running as threads of one process.
+ * Every message occupies the sender for link_time, like serialization on a NIC,
+ * so sending to more nodes costs the sender more time as it does on the network.
+ */
+class LocalTransport: public RelayTransport {
+public:
+	//! @param link_time Time to send a message (s)
+	LocalTransport(size_t nodes, double link_time);
+	void send(size_t node, const relay_message_t& message);
+	relay_message_t receive(size_t node);
+private:
+	struct mailbox_t {
+		std::mutex mutex;
+		std::condition_variable ready;
+		std::deque<relay_message_t> messages;
+	};
+	const double link_time_;
+	std::vector<std::unique_ptr<mailbox_t>> mailboxes_;
+};
+
+/*!
+ * One node of the relay tree.
+ *
+ * Every message carries the frame number and the time the master started sending it,
+ * so the nodes measure the end-to-end delivery latency. The times are compared
+ * across the nodes, which needs clocks synchronized better than the latency
+ * (trivially true for LocalTransport).
+ */
+class RelayNode {
+public:
+	RelayNode(RelayTransport& transport, const RelayTree& tree, size_t node);
+	//! Sends a frame to the children (master only)
+	void send(const void* data, size_t size);
+	//! Waits for a frame, forwards it to the children and copies it to @em data (other nodes)
+	void receive(void* data, size_t size);
+	size_t get_node() const { return node_; }
+	//! Delivery latencies of the received frames (s)
+	const std::vector<double>& get_latencies() const { return latencies_; }
+private:
+	struct header_t {
+		uint64_t frame;
+		//! FrameClock::now() of the master when it started sending
+		double send_time;
+	};
+	void forward(const relay_message_t& message);
+
+	RelayTransport& transport_;
+	const std::vector<size_t> children_;
+	const size_t node_;
+	uint64_t frame_;
+	std::vector<double> latencies_;
+};
+
+}
+
+
+
+#endif /* RELAYTREE_H_ */
@@ -0,0 +1,99 @@
+/*!
+ * @file 		RenderTarget.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		10.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "RenderTarget.h"
+#include <iostream>
+
+namespace CAVE {
+
+namespace {
+void setup_texture(GLuint texture, GLint internal_format, GLenum format, GLenum type, GLsizei width, GLsizei height)
+{
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, nullptr);
+}
+}
+
+RenderTarget::RenderTarget():
+fbo_(0),color_(0),depth_(0),width_(0),height_(0)
+{
+
+}
+
+bool RenderTarget::resize(GLsizei width, GLsizei height)
+{
+	if (fbo_ && width == width_ && height == height_) return true;
+	release();
+	width_ = width;
+	height_ = height;
+	glGenFramebuffers(1, &fbo_);
+	glGenTextures(1, &color_);
+	glGenTextures(1, &depth_);
+	setup_texture(color_, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+	// With stencil for OverdrawMeter, sampling the texture still reads the depth
+	setup_texture(depth_, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_, 0);
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Framebuffer " << width << "x" << height << " is not complete (" << status << ")\n";
+		return false;
+	}
+	return true;
+}
+
+void RenderTarget::release()
+{
+	if (fbo_) glDeleteFramebuffers(1, &fbo_);
+	if (color_) glDeleteTextures(1, &color_);
+	if (depth_) glDeleteTextures(1, &depth_);
+	fbo_ = color_ = depth_ = 0;
+	width_ = height_ = 0;
+}
+
+void RenderTarget::bind() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+	glViewport(0, 0, width_, height_);
+}
+
+void RenderTarget::unbind() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderTarget::blit(GLint x, GLint y, GLsizei width, GLsizei height) const
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+	glBlitFramebuffer(0, 0, width_, height_, x, y, x + width, y + height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void RenderTarget::capture(GLint x, GLint y, GLsizei width, GLsizei height) const
+{
+	GLint framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	// Scissor of the source view would clip the copy
+	const bool scissor = glIsEnabled(GL_SCISSOR_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+	glBlitFramebuffer(x, y, x + width, y + height, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	if (scissor) glEnable(GL_SCISSOR_TEST);
+}
+
+}
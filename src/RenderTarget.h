@@ -0,0 +1,64 @@
+/*!
+ * @file 		RenderTarget.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		10.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef RENDERTARGET_H_
+#define RENDERTARGET_H_
+#include <GL/glew.h>
+
+namespace CAVE {
+
+/*!
+ * Offscreen framebuffer with color and depth-stencil textures.
+ *
+ * Like the rest of the GL wrappers, it doesn't delete anything in the destructor
+ * (there may be no context at that time), release() has to be called explicitly.
+ */
+class RenderTarget {
+public:
+	RenderTarget();
+	/*!
+	 * (Re)creates the textures, if the size differs from the current one.
+	 * @return false if the framebuffer is not complete
+	 */
+	bool resize(GLsizei width, GLsizei height);
+	void release();
+	//! Binds the framebuffer for drawing and sets the viewport to cover it
+	void bind() const;
+	//! Binds the default framebuffer back
+	void unbind() const;
+	/*!
+	 * Copies color buffer to the currently bound draw framebuffer
+	 * @param x, y, width, height Target rectangle
+	 */
+	void blit(GLint x, GLint y, GLsizei width, GLsizei height) const;
+	/*!
+	 * Copies a rectangle of the currently bound read framebuffer into the color buffer
+	 * @param x, y, width, height Source rectangle
+	 */
+	void capture(GLint x, GLint y, GLsizei width, GLsizei height) const;
+
+	GLuint color_texture() const { return color_; }
+	GLuint depth_texture() const { return depth_; }
+	GLuint framebuffer() const { return fbo_; }
+	GLsizei width() const { return width_; }
+	GLsizei height() const { return height_; }
+private:
+	GLuint fbo_;
+	GLuint color_;
+	GLuint depth_;
+	GLsizei width_;
+	GLsizei height_;
+};
+
+}
+
+
+
+#endif /* RENDERTARGET_H_ */
@@ -0,0 +1,240 @@
+/*!
+ * @file 		Reprojection.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		24.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "Reprojection.h"
+#include "FrameClock.h"
+#include "geometry.h"
+#include "platform.h"
+#include <algorithm>
+
+namespace CAVE {
+
+namespace {
+
+/*
+ * Grid of cells_x * cells_y cells (two triangles each) generated from gl_VertexID.
+ * Every vertex is moved to the place where the stored pixel appears in the current view.
+ */
+const std::string reprojection_vertex_shader = R"XXX(
+		#version 150
+		uniform sampler2D depth_texture;
+		uniform mat4 reprojection;
+		uniform ivec2 cells;
+		uniform float fallback_depth;
+		out vec2 texcoords;
+
+		const ivec2 corners[6] = ivec2[6](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1),
+										ivec2(0, 1), ivec2(1, 0), ivec2(1, 1));
+		void main() {
+			int cell = gl_VertexID / 6;
+			ivec2 point = ivec2(cell % cells.x, cell / cells.x) + corners[gl_VertexID % 6];
+			texcoords = vec2(point) / vec2(cells);
+			float depth = textureLod(depth_texture, texcoords, 0.0).r;
+			if (depth >= 1.0) depth = fallback_depth;
+			gl_Position = reprojection * vec4(texcoords * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+		}
+)XXX";
+
+const std::string reprojection_fragment_shader = R"XXX(
+		#version 150
+		uniform sampler2D color_texture;
+		in vec2 texcoords;
+		out vec4 color;
+		void main() {
+			color = texture(color_texture, texcoords);
+		}
+)XXX";
+
+//! Size of a grid cell in pixels
+const GLsizei cell_size = 8;
+//! Weight of the last measurement in the render time estimate
+const double estimate_weight = 0.25;
+}
+
+Reprojection::Reprojection(double frame_budget):
+frame_budget_(frame_budget)
+{
+
+}
+
+void Reprojection::begin_frame()
+{
+	thread_t& thread = get_thread();
+	thread.frame_start = FrameClock::now();
+	thread.view_index = 0;
+}
+
+bool Reprojection::render(const std::function<void()>& render_fun, const std::function<void()>& navigation)
+{
+	thread_t& thread = get_thread();
+	if (thread.views.size() <= thread.view_index) thread.views.resize(thread.view_index + 1);
+	view_t& view = thread.views[thread.view_index++];
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLfloat projection[16];
+	GLfloat modelview[16];
+	GLfloat matrix[16];
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glPushMatrix();
+	navigation();
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	glPopMatrix();
+	multiply_matrices(projection, modelview, matrix);
+
+	if (view.query_pending) {
+		GLint available = 0;
+		glGetQueryObjectiv(view.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(view.query, GL_QUERY_RESULT, &elapsed);
+			view.gpu_time = elapsed * 1e-9;
+			view.query_pending = false;
+		}
+	}
+
+	const bool same_size = view.target.width() == viewport[2] && view.target.height() == viewport[3];
+	const double estimate = std::max(view.cpu_time, view.gpu_time);
+	const bool late = FrameClock::now() + estimate > thread.frame_start + frame_budget_;
+	if (late && view.valid && same_size && !view.reprojected) {
+		reproject(thread, view, viewport, matrix);
+		view.reprojected = true;
+		++thread.stats.reprojected;
+		return true;
+	}
+	render_view(view, render_fun, viewport, matrix);
+	view.reprojected = false;
+	++thread.stats.rendered;
+	return false;
+}
+
+void Reprojection::render_view(view_t& view, const std::function<void()>& render_fun,
+		const GLint* viewport, const GLfloat* matrix)
+{
+	const double start = FrameClock::now();
+	if (!view.target.resize(viewport[2], viewport[3])) {
+		view.valid = false;
+		render_fun();
+		return;
+	}
+	const bool timed = GLEW_ARB_timer_query && !view.query_pending;
+	if (timed) {
+		if (!view.query) glGenQueries(1, &view.query);
+		glBeginQuery(GL_TIME_ELAPSED, view.query);
+	}
+	view.target.bind();
+	render_fun();
+	view.target.unbind();
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	view.target.blit(viewport[0], viewport[1], viewport[2], viewport[3]);
+	if (timed) {
+		glEndQuery(GL_TIME_ELAPSED);
+		view.query_pending = true;
+	}
+	std::copy(matrix, matrix + 16, view.matrix);
+	view.valid = true;
+	// CPU time is known now, GPU time arrives with the query later
+	const double cpu_time = FrameClock::now() - start;
+	view.cpu_time = (1.0 - estimate_weight) * view.cpu_time + estimate_weight * cpu_time;
+}
+
+void Reprojection::reproject(thread_t& thread, const view_t& view, const GLint* viewport, const GLfloat* matrix)
+{
+	if (!thread.shader) {
+		thread.shader.reset(new ShaderProgram(reprojection_vertex_shader, reprojection_fragment_shader));
+		thread.shader->bind_frag_data(0, "color");
+		thread.shader->link();
+		glGenVertexArrays(1, &thread.vao);
+	}
+	// Stored frame (NDC) -> world -> current view
+	GLfloat inverse[16];
+	GLfloat reprojection[16];
+	if (!invert_matrix(view.matrix, inverse)) return;
+	multiply_matrices(matrix, inverse, reprojection);
+
+	// Depth of the scene origin in the stored frame, for pixels without depth
+	const GLfloat* m = view.matrix;
+	const float origin_depth = m[15] != 0.0f ? (m[14] / m[15]) * 0.5f + 0.5f : 1.0f;
+	const float fallback_depth = std::max(0.0f, std::min(origin_depth, 1.0f));
+
+	const GLint cells_x = (viewport[2] + cell_size - 1) / cell_size;
+	const GLint cells_y = (viewport[3] + cell_size - 1) / cell_size;
+
+	// Only the area of the view, other walls may share the window
+	const bool scissor = glIsEnabled(GL_SCISSOR_TEST);
+	GLint scissor_box[4];
+	glGetIntegerv(GL_SCISSOR_BOX, scissor_box);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glScissor(scissor_box[0], scissor_box[1], scissor_box[2], scissor_box[3]);
+	if (!scissor) glDisable(GL_SCISSOR_TEST);
+	const bool blend = glIsEnabled(GL_BLEND);
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	thread.shader->bind();
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, view.target.depth_texture());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, view.target.color_texture());
+	thread.shader->set_uniform_int("color_texture", 0);
+	thread.shader->set_uniform_int("depth_texture", 1);
+	thread.shader->set_uniform_matrix4("reprojection", reprojection);
+	thread.shader->set_uniform_float("fallback_depth", fallback_depth);
+	thread.shader->set_uniform_int2("cells", cells_x, cells_y);
+	glBindVertexArray(thread.vao);
+	glDrawArrays(GL_TRIANGLES, 0, cells_x * cells_y * 6);
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	thread.shader->unbind();
+	if (blend) glEnable(GL_BLEND);
+}
+
+void Reprojection::release()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	auto it = threads_.find(get_thread_id());
+	if (it == threads_.end()) return;
+	thread_t& thread = it->second;
+	for (auto& view: thread.views) {
+		view.target.release();
+		if (view.query) glDeleteQueries(1, &view.query);
+	}
+	if (thread.shader) thread.shader->release();
+	if (thread.vao) glDeleteVertexArrays(1, &thread.vao);
+	threads_.erase(it);
+}
+
+reprojection_stats_t Reprojection::get_stats() const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	auto it = threads_.find(get_thread_id());
+	return it == threads_.end() ? reprojection_stats_t() : it->second.stats;
+}
+
+void Reprojection::report(std::ostream& os) const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	for (const auto& thread: threads_) {
+		const reprojection_stats_t& stats = thread.second.stats;
+		const size_t total = stats.rendered + stats.reprojected;
+		os << "Thread " << thread.first << ": " << stats.rendered << " views rendered, "
+				<< stats.reprojected << " reprojected";
+		if (total) os << " (" << 100.0 * stats.reprojected / total << " %)";
+		os << "\n";
+	}
+}
+
+Reprojection::thread_t& Reprojection::get_thread()
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	return threads_[get_thread_id()];
+}
+
+}
@@ -0,0 +1,105 @@
+/*!
+ * @file 		Reprojection.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		24.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef REPROJECTION_H_
+#define REPROJECTION_H_
+#include "Shader.h"
+#include "RenderTarget.h"
+#include <functional>
+#include <ostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+
+namespace CAVE {
+
+//! Frame statistics of one display thread
+struct reprojection_stats_t {
+	//! Views rendered normally
+	size_t rendered		= 0;
+	//! Views replaced by reprojection of the previous frame
+	size_t reprojected	= 0;
+};
+
+/*!
+ * Hides missed frames by reprojecting the previous one.
+ *
+ * Every view (wall and eye) is rendered to its own RenderTarget and then copied
+ * to the screen. When the view wouldn't be finished before the frame deadline,
+ * the last frame of the view is warped to the current matrices instead
+ * (a grid mesh displaced by the stored depth). The scene writes no depth,
+ * so empty pixels are placed at the depth of the scene origin.
+ *
+ * A view is never reprojected twice in a row, so the content keeps updating
+ * at least at half the frame rate.
+ *
+ * Like the other GL wrappers, it holds per-context data
+ * and release() has to be called from every thread.
+ */
+class Reprojection {
+public:
+	//! @param frame_budget Time for a whole frame (in seconds)
+	Reprojection(double frame_budget);
+	//! Starts a new frame in the current thread, the deadline is counted from now
+	void begin_frame();
+	/*!
+	 * Renders the current view with @em render_fun or reprojects its previous frame.
+	 * The matrices have to be set up for the view, @em navigation is applied
+	 * to the modelview matrix inside @em render_fun.
+	 * @return true if the view was reprojected
+	 */
+	bool render(const std::function<void()>& render_fun, const std::function<void()>& navigation);
+	//! Deletes GL objects of the current thread
+	void release();
+	reprojection_stats_t get_stats() const;
+	//! Prints statistics of all threads
+	void report(std::ostream& os) const;
+private:
+	struct view_t {
+		RenderTarget target;
+		//! Projection * modelview (including navigation) of the stored frame
+		GLfloat matrix[16];
+		bool valid = false;
+		bool reprojected = false;
+		//! Smoothed CPU time of rendering the view (s)
+		double cpu_time = 0.0;
+		//! GPU time of the last measured render (s)
+		double gpu_time = 0.0;
+		//! Query measuring the GPU time (GL_TIME_ELAPSED)
+		GLuint query = 0;
+		bool query_pending = false;
+	};
+	struct thread_t {
+		thread_t(): vao(0), frame_start(0.0), view_index(0) {}
+		//! Created on first use (in the context of the thread)
+		std::unique_ptr<ShaderProgram> shader;
+		GLuint vao;
+		double frame_start;
+		size_t view_index;
+		std::vector<view_t> views;
+		reprojection_stats_t stats;
+	};
+
+	thread_t& get_thread();
+	void render_view(view_t& view, const std::function<void()>& render_fun,
+			const GLint* viewport, const GLfloat* matrix);
+	void reproject(thread_t& thread, const view_t& view, const GLint* viewport, const GLfloat* matrix);
+
+	const double frame_budget_;
+	mutable std::mutex mutex_;
+	std::map<int, thread_t> threads_;
+};
+
+}
+
+
+
+#endif /* REPROJECTION_H_ */
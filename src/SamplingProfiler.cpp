@@ -0,0 +1,274 @@
+/*!
+ * @file 		SamplingProfiler.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		7.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "SamplingProfiler.h"
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace CAVE {
+
+namespace {
+//! Size of the sample ring of every thread
+const size_t samples_per_thread = 1024;
+//! How often the rings are emptied
+const std::chrono::milliseconds collect_interval(100);
+//! Frames of the signal handler and of the signal trampoline
+const int skipped_frames = 2;
+
+std::atomic<SamplingProfiler*> active_profiler(nullptr);
+std::atomic<size_t> profiler_ids(0);
+struct sigaction previous_action;
+
+/*!
+ * Everything the signal handler needs. Plain data only,
+ * so the access from the handler doesn't involve any initialization.
+ */
+struct current_thread_t {
+	size_t profiler;
+	SamplingProfiler::thread_t* thread;
+	const char* phase;
+};
+thread_local current_thread_t current_thread = {0, nullptr, nullptr};
+
+void handle_sample(int, siginfo_t*, void*)
+{
+	const int saved_errno = errno;
+	SamplingProfiler::thread_t* thread = current_thread.thread;
+	if (thread) {
+		const size_t head = thread->head.load(std::memory_order_relaxed);
+		if (head - thread->tail.load(std::memory_order_acquire) >= thread->samples.size()) {
+			thread->dropped.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			SamplingProfiler::sample_t& sample = thread->samples[head % thread->samples.size()];
+			sample.phase = current_thread.phase;
+			sample.depth = backtrace(sample.frames, SamplingProfiler::max_depth);
+			thread->head.store(head + 1, std::memory_order_release);
+		}
+	}
+	errno = saved_errno;
+}
+
+std::string symbol_name(void* address)
+{
+	Dl_info info;
+	if (!dladdr(address, &info)) {
+		std::ostringstream name;
+		name << address;
+		return name.str();
+	}
+	if (info.dli_sname) {
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+		const std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+		std::free(demangled);
+		return name;
+	}
+	const char* module = info.dli_fname ? info.dli_fname : "?";
+	if (const char* slash = std::strrchr(module, '/')) module = slash + 1;
+	std::ostringstream name;
+	name << module << "+0x" << std::hex
+			<< (static_cast<char*>(address) - static_cast<char*>(info.dli_fbase));
+	return name.str();
+}
+}
+
+SamplingProfiler::Phase::Phase(const char* name):
+previous_(current_thread.phase)
+{
+	SamplingProfiler* profiler = active_profiler.load(std::memory_order_acquire);
+	if (profiler && current_thread.profiler != profiler->id_) register_thread("worker");
+	current_thread.phase = name;
+}
+
+SamplingProfiler::Phase::~Phase() noexcept
+{
+	current_thread.phase = previous_;
+}
+
+bool SamplingProfiler::stack_key_t::operator<(const stack_key_t& other) const
+{
+	if (thread != other.thread) return thread < other.thread;
+	if (phase != other.phase) return phase < other.phase;
+	return frames < other.frames;
+}
+
+SamplingProfiler::SamplingProfiler(double frequency, bool wall_clock):
+frequency_(std::max(frequency, 1.0)),wall_clock_(wall_clock),id_(++profiler_ids),
+samples_(0),running_(true)
+{
+	SamplingProfiler* expected = nullptr;
+	if (!active_profiler.compare_exchange_strong(expected, this)) {
+		throw std::runtime_error("Only one sampling profiler can run at a time");
+	}
+	// The first call of backtrace() loads libgcc, which must not happen in the handler
+	void* frames[2];
+	backtrace(frames, 2);
+
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_sigaction = handle_sample;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGPROF, &action, &previous_action);
+	collector_ = std::thread([this](){collector();});
+}
+
+SamplingProfiler::~SamplingProfiler() noexcept
+{
+	stop();
+	// A signal may still be pending, so the default action (termination) can't be restored
+	if (previous_action.sa_handler == SIG_DFL) previous_action.sa_handler = SIG_IGN;
+	sigaction(SIGPROF, &previous_action, nullptr);
+	active_profiler = nullptr;
+}
+
+void SamplingProfiler::register_thread(const std::string& label)
+{
+	SamplingProfiler* profiler = active_profiler.load(std::memory_order_acquire);
+	if (!profiler || current_thread.profiler == profiler->id_) return;
+	profiler->add_thread(label);
+}
+
+void SamplingProfiler::add_thread(const std::string& label)
+{
+	// The thread is marked as registered even if the timer fails, so it's not retried in every Phase
+	current_thread.profiler = id_;
+	std::unique_ptr<thread_t> thread(new thread_t(label, samples_per_thread));
+	sigevent event;
+	std::memset(&event, 0, sizeof(event));
+	event.sigev_notify = SIGEV_THREAD_ID;
+	event.sigev_signo = SIGPROF;
+	event.sigev_notify_thread_id = syscall(SYS_gettid);
+	if (timer_create(wall_clock_ ? CLOCK_MONOTONIC : CLOCK_THREAD_CPUTIME_ID, &event, &thread->timer) != 0) {
+		std::cerr << "Failed to create profiling timer for thread " << label << ": " << std::strerror(errno) << "\n";
+		return;
+	}
+	const long interval = static_cast<long>(1e9 / frequency_);
+	itimerspec spec;
+	spec.it_interval.tv_sec = interval / 1000000000L;
+	spec.it_interval.tv_nsec = interval % 1000000000L;
+	spec.it_value = spec.it_interval;
+
+	std::unique_lock<std::mutex> _(mutex_);
+	if (!running_) {
+		timer_delete(thread->timer);
+		return;
+	}
+	current_thread.thread = thread.get();
+	timer_settime(thread->timer, 0, &spec, nullptr);
+	threads_.push_back(std::move(thread));
+}
+
+void SamplingProfiler::stop()
+{
+	{
+		std::unique_lock<std::mutex> _(mutex_);
+		if (!running_) return;
+		running_ = false;
+		for (auto& thread: threads_) {
+			timer_delete(thread->timer);
+		}
+	}
+	stop_cond_.notify_all();
+	if (collector_.joinable()) collector_.join();
+	std::unique_lock<std::mutex> _(mutex_);
+	collect();
+}
+
+void SamplingProfiler::collector()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (running_) {
+		stop_cond_.wait_for(lock, collect_interval);
+		collect();
+	}
+}
+
+void SamplingProfiler::collect()
+{
+	for (size_t i = 0; i < threads_.size(); ++i) {
+		thread_t& thread = *threads_[i];
+		const size_t head = thread.head.load(std::memory_order_acquire);
+		const size_t tail = thread.tail.load(std::memory_order_relaxed);
+		for (size_t index = tail; index < head; ++index) {
+			const sample_t& sample = thread.samples[index % thread.samples.size()];
+			stack_key_t key {i, sample.phase, {}};
+			// Stored from the leaf, folded stacks start at the root
+			for (int frame = sample.depth - 1; frame >= skipped_frames; --frame) {
+				key.frames.push_back(sample.frames[frame]);
+			}
+			++stacks_[key];
+		}
+		samples_ += head - tail;
+		thread.tail.store(head, std::memory_order_release);
+	}
+}
+
+bool SamplingProfiler::write(const std::string& path)
+{
+	std::map<std::string, size_t> folded;
+	{
+		std::unique_lock<std::mutex> _(mutex_);
+		collect();
+		std::map<void*, std::string> names;
+		for (const auto& stack: stacks_) {
+			std::string line = threads_[stack.first.thread]->label + ";" +
+					(stack.first.phase ? stack.first.phase : "other");
+			const auto& frames = stack.first.frames;
+			for (size_t i = 0; i < frames.size(); ++i) {
+				// Return addresses point after the call, possibly into the next function
+				void* address = i + 1 < frames.size() ? static_cast<char*>(frames[i]) - 1 : frames[i];
+				auto it = names.find(address);
+				if (it == names.end()) it = names.insert(std::make_pair(address, symbol_name(address))).first;
+				line += ";" + it->second;
+			}
+			folded[line] += stack.second;
+		}
+	}
+	std::ofstream file(path);
+	for (const auto& line: folded) {
+		file << line.first << " " << line.second << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+size_t SamplingProfiler::samples() const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	return samples_;
+}
+
+size_t SamplingProfiler::dropped() const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	size_t dropped = 0;
+	for (const auto& thread: threads_) {
+		dropped += thread->dropped;
+	}
+	return dropped;
+}
+
+}
@@ -0,0 +1,136 @@
+/*!
+ * @file 		SamplingProfiler.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		7.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef SAMPLINGPROFILER_H_
+#define SAMPLINGPROFILER_H_
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <ctime>
+
+namespace CAVE {
+
+/*!
+ * In-process sampling profiler.
+ *
+ * Every registered thread gets its own timer (timer_create) sending SIGPROF
+ * to just that thread. The signal handler stores the stack (backtrace)
+ * together with the current frame phase into a ring of the thread,
+ * a background thread aggregates the samples. write() then produces
+ * folded stacks (one line per unique stack, "thread;phase;root;...;leaf count"),
+ * usable directly by flamegraph.pl.
+ *
+ * By default the timers count CPU time of the thread, so a thread waiting
+ * in a barrier is not sampled at all. With wall clock timers the waiting
+ * shows up too, but the signals may interrupt system calls not restarted
+ * by SA_RESTART (e.g. sleeps).
+ *
+ * Only one profiler can run in a process. Function names are resolved
+ * through dladdr, so the executable has to export its symbols (-rdynamic),
+ * otherwise they are written as module+offset.
+ */
+class SamplingProfiler {
+public:
+	/*!
+	 * Installs the signal handler, the threads have to be registered separately
+	 * @param frequency  Samples per second of every thread
+	 * @param wall_clock Use wall clock instead of CPU time of the threads
+	 */
+	SamplingProfiler(double frequency, bool wall_clock = false);
+	~SamplingProfiler() noexcept;
+	SamplingProfiler(const SamplingProfiler&) = delete;
+	SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+	/*!
+	 * Starts sampling of the current thread (does nothing without a running profiler).
+	 * Threads entering a Phase are registered automatically as "worker".
+	 */
+	static void register_thread(const std::string& label);
+	//! Stops all timers, no samples are taken afterwards
+	void stop();
+	/*!
+	 * Writes folded stacks of all samples collected so far
+	 * @return false if the file couldn't be written
+	 */
+	bool write(const std::string& path);
+	//! Number of samples collected so far
+	size_t samples() const;
+	//! Number of samples lost because of full rings
+	size_t dropped() const;
+
+	/*!
+	 * Marks the current thread as being in a frame phase until destruction.
+	 * Phases nest, the innermost one is used. The name has to be a string literal.
+	 */
+	class Phase {
+	public:
+		Phase(const char* name);
+		~Phase() noexcept;
+		Phase(const Phase&) = delete;
+		Phase& operator=(const Phase&) = delete;
+	private:
+		const char* previous_;
+	};
+
+	//! Maximal number of frames stored for a sample
+	static const int max_depth = 48;
+	struct sample_t {
+		const char* phase;
+		int depth;
+		void* frames[max_depth];
+	};
+	struct thread_t {
+		thread_t(const std::string& label, size_t size):label(label),samples(size),head(0),tail(0),dropped(0),timer(nullptr) {}
+		const std::string label;
+		std::vector<sample_t> samples;
+		//! Written only by the signal handler
+		std::atomic<size_t> head;
+		//! Written only by the collector
+		std::atomic<size_t> tail;
+		std::atomic<size_t> dropped;
+		timer_t timer;
+	};
+
+private:
+	//! Sample aggregated by thread, phase and stack
+	struct stack_key_t {
+		size_t thread;
+		const char* phase;
+		std::vector<void*> frames;
+		bool operator<(const stack_key_t& other) const;
+	};
+
+	void add_thread(const std::string& label);
+	void collect();
+	void collector();
+
+	const double frequency_;
+	const bool wall_clock_;
+	const size_t id_;
+
+	mutable std::mutex mutex_;
+	std::vector<std::unique_ptr<thread_t>> threads_;
+	std::map<stack_key_t, size_t> stacks_;
+	size_t samples_;
+	bool running_;
+	std::condition_variable stop_cond_;
+	std::thread collector_;
+};
+
+}
+
+
+
+#endif /* SAMPLINGPROFILER_H_ */
@@ -10,6 +10,9 @@
 #include "platform.h"
 #include <stdexcept>
 #include <iostream>
+#include <cassert>
+#include <cstddef>
+#include <thread>
 #include <GL/glu.h>
 
 namespace CAVE {
@@ -63,7 +66,7 @@ const std::string vertex_shader = R"XXX(
 		vec4 cold = vec4(0.0f, 0.73f, .40f, 1.0f);
 		vec4 hot = vec4(0.8f, 0.0f, 0.0f, 1.0f);
 		in vec3 position;
-		in vec3 direction;
+		in float speed;
 
 		out vdata0 {
 			vec4 color;
@@ -71,7 +74,7 @@ const std::string vertex_shader = R"XXX(
 
 		void main() {
 			gl_Position = gl_ModelViewProjectionMatrix * vec4(position.xyz, 1.0);
-			vertex.color = mix(cold, hot, clamp(direction.y,-1.0,1.0)/2+0.5);
+			vertex.color = mix(cold, hot, clamp(speed,-1.0,1.0)/2+0.5);
 		}
 )XXX";
 
@@ -112,6 +115,310 @@ const std::string geometry_shader = R"XXX(
 		}
 )XXX";
 
+/*
+ * Point sprite variant of the shaders above, with texture coordinates from gl_PointCoord.
+ * It only approximates the geometry shader: sprites are square in pixels (the quads
+ * follow the aspect ratio of the viewport), limited by GL_POINT_SIZE_RANGE
+ * and clipped whole when their centre leaves the view.
+ */
+const std::string sprite_fragment_shader = R"XXX(
+		#version 150
+		in vsprite {
+			vec4 color;
+		} vtx;
+		out vec4 color;
+		void main() {
+			vec2 texcoords = vec2(gl_PointCoord.x, 1.0 - gl_PointCoord.y) * 2.0 - 1.0;
+			float dist = distance(texcoords, vec2(0.5,0.5));
+			if (dist > 0.5) {
+				discard;
+			} else {
+				float val = (1.0 - 2 * dist);
+				color = vec4(sqrt(val) * vtx.color.xyz, val*val*val);
+			}
+		}
+)XXX";
+const std::string sprite_vertex_shader = R"XXX(
+		#version 150 compatibility
+		vec4 cold = vec4(0.0f, 0.73f, .40f, 1.0f);
+		vec4 hot = vec4(0.8f, 0.0f, 0.0f, 1.0f);
+		in vec3 position;
+		in float speed;
+
+		uniform float size = 0.5;
+		uniform float viewport_height = 600.0;
+
+		out vsprite {
+			vec4 color;
+		} vertex;
+
+		void main() {
+			gl_Position = gl_ModelViewProjectionMatrix * vec4(position.xyz, 1.0);
+			// Quad from the geometry shader spans 2*size in clip space
+			gl_PointSize = size * viewport_height / gl_Position.w;
+			vertex.color = mix(cold, hot, clamp(speed,-1.0,1.0)/2+0.5);
+		}
+)XXX";
+
+/*
+ * Vertex pulling variants of the vertex shaders above. The particles are fetched
+ * from a buffer texture by gl_VertexID and the layout of every component is given
+ * by uniforms, so the buffer may hold them in any layout (Particle as it is,
+ * compact vertices or separate columns) and no vertex array is needed.
+ */
+const std::string pulling_common = R"XXX(
+		#version 150 compatibility
+		vec4 cold = vec4(0.0f, 0.73f, .40f, 1.0f);
+		vec4 hot = vec4(0.8f, 0.0f, 0.0f, 1.0f);
+		uniform samplerBuffer particles;
+		// Offset and stride (in floats) of the components
+		uniform ivec2 layout_x;
+		uniform ivec2 layout_y;
+		uniform ivec2 layout_z;
+		uniform ivec2 layout_speed;
+
+		float pull(ivec2 component) {
+			return texelFetch(particles, component.x + gl_VertexID * component.y).r;
+		}
+)XXX";
+
+const std::string pulling_vertex_shader = pulling_common + R"XXX(
+		out vdata0 {
+			vec4 color;
+		} vertex;
+
+		void main() {
+			vec3 position = vec3(pull(layout_x), pull(layout_y), pull(layout_z));
+			gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);
+			vertex.color = mix(cold, hot, clamp(pull(layout_speed),-1.0,1.0)/2+0.5);
+		}
+)XXX";
+
+const std::string pulling_sprite_vertex_shader = pulling_common + R"XXX(
+		uniform float size = 0.5;
+		uniform float viewport_height = 600.0;
+
+		out vsprite {
+			vec4 color;
+		} vertex;
+
+		void main() {
+			vec3 position = vec3(pull(layout_x), pull(layout_y), pull(layout_z));
+			gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);
+			gl_PointSize = size * viewport_height / gl_Position.w;
+			vertex.color = mix(cold, hot, clamp(pull(layout_speed),-1.0,1.0)/2+0.5);
+		}
+)XXX";
+
+/*
+ * Multi-viewport variant of the geometry shader path. The vertex shader passes
+ * the particles in world space and every geometry shader invocation projects them
+ * into one of the recorded views.
+ */
+const std::string multi_view_vertex_shader = R"XXX(
+		#version 150
+		vec4 cold = vec4(0.0f, 0.73f, .40f, 1.0f);
+		vec4 hot = vec4(0.8f, 0.0f, 0.0f, 1.0f);
+		in vec3 position;
+		in float speed;
+
+		out vdata0 {
+			vec4 color;
+		} vertex;
+
+		void main() {
+			gl_Position = vec4(position.xyz, 1.0);
+			vertex.color = mix(cold, hot, clamp(speed,-1.0,1.0)/2+0.5);
+		}
+)XXX";
+
+const std::string multi_view_geometry_shader = R"XXX(
+		#version 150
+		#extension GL_ARB_viewport_array : require
+		#extension GL_ARB_gpu_shader5 : require
+		layout (points, invocations = 16) in;
+		layout (triangle_strip, max_vertices=4) out;
+
+		uniform float size = 0.5;
+		uniform int view_count;
+		uniform mat4 view_matrices[16];
+
+		in vdata0 {
+			vec4 color;
+		} vertex[];
+
+		out vdata {
+			vec2 texcoords;
+			vec4 color;
+		} vtx;
+
+		void main() {
+			if (gl_InvocationID >= view_count) return;
+			vec4 center = view_matrices[gl_InvocationID] * gl_in[0].gl_Position;
+			for (int i = 0; i < 4; ++i) {
+				vtx.texcoords = vec2(i % 2 == 0 ? -1 : 1, i < 2 ? -1 : 1);
+				vtx.color = vertex[0].color;
+				gl_ViewportIndex = gl_InvocationID;
+				gl_Position = center + vec4(vtx.texcoords * size, 0.0,0.0);
+				EmitVertex();
+			}
+			EndPrimitive();
+		}
+)XXX";
+
+//! Number of views drawn by one call (invocations of the multi-view geometry shader)
+const size_t max_views_per_draw = 16;
+
+/*
+ * GPU culling. Three compute passes over the vertex buffer:
+ *  - count:   number of visible particles in every work group
+ *  - scan:    exclusive prefix sum of the counts (single work group),
+ *             writes the total to the indirect draw command
+ *  - compact: indices of visible particles, at the offset of their group
+ * The order of particles is preserved, so blending gives the same image as without culling.
+ */
+const std::string cull_shader_common = R"XXX(
+		#version 430
+		layout (local_size_x = 256) in;
+		const uint group_size = 256u;
+
+		layout (std430, binding = 0) readonly buffer vertex_data { float vertices[]; };
+		layout (std430, binding = 1) buffer group_data { uint group_offsets[]; };
+		layout (std430, binding = 2) writeonly buffer index_data { uint indices[]; };
+		layout (std430, binding = 3) writeonly buffer command_data {
+			uint count;
+			uint instance_count;
+			uint first_index;
+			int base_vertex;
+			uint base_instance;
+		} command;
+
+		uniform mat4 projection;
+		uniform mat4 modelview;
+		uniform uint first;
+		uniform uint vertex_count;
+		uniform uint stride;
+		uniform uint group_count;
+		// Half size of the sprites in clip space
+		uniform float margin = 0.5;
+
+		shared uint scan[group_size];
+
+		bool visible(uint i) {
+			if (i >= vertex_count) return false;
+			uint base = (first + i) * stride;
+			vec4 p = projection * modelview * vec4(vertices[base], vertices[base + 1], vertices[base + 2], 1.0);
+			float r = p.w + margin;
+			return abs(p.x) <= r && abs(p.y) <= r && abs(p.z) <= p.w;
+		}
+
+		// Inclusive prefix sum of scan[]
+		void scan_group(uint local) {
+			for (uint offset = 1u; offset < group_size; offset *= 2u) {
+				uint value = local >= offset ? scan[local - offset] : 0u;
+				barrier();
+				scan[local] += value;
+				barrier();
+			}
+		}
+)XXX";
+
+const std::string cull_count_shader = cull_shader_common + R"XXX(
+		void main() {
+			uint local = gl_LocalInvocationIndex;
+			scan[local] = visible(gl_GlobalInvocationID.x) ? 1u : 0u;
+			barrier();
+			scan_group(local);
+			if (local == group_size - 1u) group_offsets[gl_WorkGroupID.x] = scan[local];
+		}
+)XXX";
+
+const std::string cull_scan_shader = cull_shader_common + R"XXX(
+		void main() {
+			uint local = gl_LocalInvocationIndex;
+			uint per_thread = (group_count + group_size - 1u) / group_size;
+			uint begin = min(local * per_thread, group_count);
+			uint end = min(begin + per_thread, group_count);
+			uint sum = 0u;
+			for (uint i = begin; i < end; ++i) sum += group_offsets[i];
+			scan[local] = sum;
+			barrier();
+			scan_group(local);
+			uint offset = scan[local] - sum;
+			for (uint i = begin; i < end; ++i) {
+				uint group = group_offsets[i];
+				group_offsets[i] = offset;
+				offset += group;
+			}
+			if (local == group_size - 1u) {
+				command.count = scan[local];
+				command.instance_count = 1u;
+				command.first_index = 0u;
+				command.base_vertex = int(first);
+				command.base_instance = 0u;
+			}
+		}
+)XXX";
+
+const std::string cull_compact_shader = cull_shader_common + R"XXX(
+		void main() {
+			uint local = gl_LocalInvocationIndex;
+			bool is_visible = visible(gl_GlobalInvocationID.x);
+			scan[local] = is_visible ? 1u : 0u;
+			barrier();
+			scan_group(local);
+			if (is_visible) indices[group_offsets[gl_WorkGroupID.x] + scan[local] - 1u] = gl_GlobalInvocationID.x;
+		}
+)XXX";
+
+//! Work group size of the culling shaders
+const size_t cull_group_size = 256;
+//! Limit of glDispatchCompute guaranteed by the specification
+const size_t max_cull_groups = 65535;
+
+//! Attribute indices of the particle vertex format
+const GLuint index_vertices = 0;
+const GLuint index_speed = 1;
+
+//! Compact vertex, carries only the data used by the shaders
+struct compact_vertex_t {
+	point3 position;
+	float speed;
+};
+static_assert(sizeof(compact_vertex_t) == 4*sizeof(float),"Wrong padding of compact_vertex_t!");
+
+size_t vertex_size(vertex_format_t format)
+{
+	return format == vertex_format_t::full ? sizeof(Particle) : sizeof(compact_vertex_t);
+}
+
+//! Offset of a component in the vertex (in floats, as fetched by the pulling shaders)
+GLint float_offset(size_t bytes)
+{
+	return static_cast<GLint>(bytes / sizeof(float));
+}
+
+/*!
+ * Writes particles in specified format to @em target
+ * @param particles Particles to write
+ * @param format    Vertex format
+ * @param target    Pointer to memory large enough for all particles
+ */
+void write_vertices(const Particle* particles, size_t count, vertex_format_t format, char* target)
+{
+	if (format == vertex_format_t::full) {
+		std::copy(particles, particles + count, reinterpret_cast<Particle*>(target));
+		return;
+	}
+	compact_vertex_t* vertex = reinterpret_cast<compact_vertex_t*>(target);
+	for (const Particle* p = particles; p != particles + count; ++p) {
+		*vertex++ = {p->position, p->direction.y};
+	}
+}
+
+//! Counts @em call to @em stats as one GL call (even a helper issuing more of them)
+#define GL_COUNTED(stats, call) do { ++(stats).gl_calls; call; } while (0)
+
 bool check_gl_error(const std::string& file, size_t line) {
 	GLuint glerr;
 	if ((glerr=glGetError())) {
@@ -131,8 +438,9 @@ bool check_gl_error(const std::string& file, size_t line) {
 
 
 Scene::Scene(size_t particles_per_second):
-particles_per_second_(particles_per_second),
-distribution_position_(0.0, 1.0), distribution_direction_(-1.0, 1.0)
+particles_per_second_(particles_per_second),spawn_budget_(0.0),recorder_(nullptr),
+kernel_(select_kernel(config_.deterministic)),workers_(config_.workers),arena_(nullptr),shared_(nullptr),
+distribution_position_(0.0, 1.0), distribution_direction_(-1.0, 1.0),gpu_simulation_(false),first_step_(0)
 {
 
 }
@@ -140,20 +448,111 @@ distribution_position_(0.0, 1.0), distribution_direction_(-1.0, 1.0)
 
 void Scene::update(float time_delta)
 {
-	size_t particles_to_create = particles_per_second_ * time_delta;
-	for (size_t i = 0; i < particles_to_create; ++i) {
-		particles_.emplace_back(create_particle(distribution_position_, distribution_direction_, generator_));
+	if (shared_) shared_->sequence.fetch_add(1, std::memory_order_acq_rel);
+	// Frame boundary, no chunk of the previous update is running
+	if (behaviour_) behaviour_->poll();
+	spawn_budget_ += particles_per_second_ * static_cast<double>(time_delta);
+	const size_t particles_to_create = static_cast<size_t>(spawn_budget_);
+	spawn_budget_ -= particles_to_create;
+	// With the GPU simulation, the particles are spawned only to be uploaded by the contexts
+	std::vector<Particle> spawned;
+	{
+		FlightRecorder::Span _(recorder_, "spawn", particles_to_create);
+		SamplingProfiler::Phase phase("spawn");
+		for (size_t i = 0; i < particles_to_create; ++i) {
+			const Particle particle = create_particle(distribution_position_, distribution_direction_, generator_);
+			if (gpu_simulation_) spawned.push_back(particle);
+			else particles_.push_back(particle);
+		}
+	}
+	if (gpu_simulation_) {
+		push_step(population_.update(std::move(spawned), time_delta));
+		publish();
+		return;
 	}
-	for (auto& p: particles_) {
-		p.update(time_delta);
+	{
+		FlightRecorder::Span _(recorder_, "integrate", particles_.size());
+		const update_kernel_t kernel = CAVE::get_kernel(kernel_);
+		const Behaviour* behaviour = behaviour_.get();
+		// Particles are independent, so the split into chunks doesn't change the results
+		workers_.parallel_for(particles_.size(), config_.chunk_size,
+				[this, kernel, behaviour, time_delta](size_t begin, size_t end) {
+			// Chunks run in the worker threads too
+			SamplingProfiler::Phase phase("integrate");
+			if (behaviour) behaviour->update(particles_.data() + begin, end - begin, time_delta);
+			else kernel(particles_.data() + begin, end - begin, time_delta);
+		});
 	}
+	FlightRecorder::Span span(recorder_, "compact");
+	SamplingProfiler::Phase phase("compact");
+	const size_t count = particles_.size();
 	particles_.erase(std::remove_if(particles_.begin(), particles_.end(),
 			[](Particle& p){return p.dead();}), particles_.end());
+	span.set_value(count - particles_.size());
+	publish();
+}
+
+void Scene::push_step(gpu_step_t step)
+{
+	std::unique_lock<std::mutex> _(detail_mutex_);
+	steps_.push_back(std::make_shared<const gpu_step_t>(std::move(step)));
+	// Without any context yet, the steps are kept for the first one
+	if (details_.empty()) return;
+	size_t applied = first_step_ + steps_.size();
+	for (const auto& detail: details_) {
+		applied = std::min(applied, detail.second.simulated);
+	}
+	while (first_step_ < applied) {
+		steps_.pop_front();
+		++first_step_;
+	}
+}
+
+void Scene::set_shared_arena(SharedArena* arena)
+{
+	arena_ = arena;
+	particles_ = particle_vector_t(ArenaAllocator<Particle>(arena));
+	shared_ = arena ? new (arena->allocate(sizeof(shared_frame_t))) shared_frame_t() : nullptr;
+	publish();
+}
+
+void Scene::publish()
+{
+	if (!shared_) return;
+	shared_->offset = particles_.empty() ? 0 : arena_->offset_of(particles_.data());
+	shared_->count = particles_.size();
+	// Makes the sequence even again (a new one, if the update didn't make it odd)
+	shared_->sequence.fetch_add(shared_->sequence.load(std::memory_order_relaxed) % 2 ? 1 : 2,
+			std::memory_order_release);
+}
+
+Scene::particle_range_t Scene::get_particles() const
+{
+	if (!shared_) return {particles_.data(), particles_.size()};
+	/*
+	 * The frame structure (barrier after the update) makes sure the update is finished
+	 * before any display process starts to render, this only makes it visible.
+	 */
+	while (shared_->sequence.load(std::memory_order_acquire) % 2) {
+		std::this_thread::yield();
+	}
+	if (!shared_->count) return {nullptr, 0};
+	return {static_cast<const Particle*>(arena_->at(shared_->offset)), shared_->count};
 }
 
 void Scene::render(const point3& position, const float rotation_y) const
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	SamplingProfiler::Phase phase("draw");
+	gl_details_t& detail = get_detail();
+	render_stats_t& stats = detail.stats;
+	++detail.view_calls;
+	if (config_.multi_viewport && detail.expected_views && multi_view_supported()) {
+		record_view(detail, position, rotation_y);
+		if (detail.views.size() == detail.expected_views) render_views(detail);
+		return;
+	}
+	++stats.frames;
+	GL_COUNTED(stats, glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
 	/*
 	 * For the sake of simplicity, the old OpenGL matrix stack is used here.
@@ -172,31 +571,452 @@ void Scene::render(const point3& position, const float rotation_y) const
 	 *
 	 */
 
-	glRotatef(-rotation_y  * 180.0f / pi_constant, 0.0f, 1.0f, 0.0f);
-	glTranslatef(position.x, position.y, position.z);
-
+	GL_COUNTED(stats, apply_navigation(position, rotation_y));
 
-	const gl_details_t& detail = get_detail();
-	detail.shader.bind();
 
 	// The important part here is that particles are handled only through const references.
 	// And the vector is never modified.
 //	for (const auto& p: particles_) {
 //		draw_quad(p.position, p.get_color());
 //	}
-	glEnable(GL_BLEND);
-	glDisable(GL_DEPTH_TEST);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBindVertexArray(detail.vba);
-	glBindBuffer(GL_ARRAY_BUFFER, detail.fbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Particle)*particles_.size(), &particles_[0], GL_DYNAMIC_DRAW);
-	glDrawArrays(GL_POINTS, 0, particles_.size());
-	glBindVertexArray(0);
-	detail.shader.unbind();
+	GL_COUNTED(stats, glEnable(GL_BLEND));
+	GL_COUNTED(stats, glDisable(GL_DEPTH_TEST));
+	GL_COUNTED(stats, glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+	const size_t first = upload(detail);
+	const bool culled = config_.gpu_culling && cull(detail, first);
+
+	// Bound only after culling, which uses its own programs
+	const bool sprites = config_.backend == render_backend_t::point_sprite;
+	const bool pulling = config_.vertex_pulling && prepare_pulling(detail, first);
+	const ShaderProgram& shader = pulling ? detail.pulling_shaders[sprites ? 1 : 0] :
+			sprites ? detail.sprite_shader : detail.shader;
+	GL_COUNTED(stats, shader.bind());
+	if (sprites) {
+		GLint viewport[4];
+		GL_COUNTED(stats, glGetIntegerv(GL_VIEWPORT, viewport));
+		GL_COUNTED(stats, shader.set_uniform_float("viewport_height", static_cast<float>(viewport[3])));
+		GL_COUNTED(stats, glEnable(GL_PROGRAM_POINT_SIZE));
+	}
+	if (pulling) bind_pulling(detail, shader);
+	GL_COUNTED(stats, glBindVertexArray(detail.vba));
+	if (culled) {
+		// Count of the visible particles never leaves the GPU
+		GL_COUNTED(stats, glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, detail.cull_indices));
+		GL_COUNTED(stats, glBindBuffer(GL_DRAW_INDIRECT_BUFFER, detail.cull_command));
+		GL_COUNTED(stats, glDrawElementsIndirect(GL_POINTS, GL_UNSIGNED_INT, nullptr));
+		GL_COUNTED(stats, glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+	} else {
+		GL_COUNTED(stats, glDrawArrays(GL_POINTS, first, detail.uploaded_count));
+	}
+	++stats.draw_calls;
+	GL_COUNTED(stats, glBindVertexArray(0));
+	if (pulling) GL_COUNTED(stats, glBindTexture(GL_TEXTURE_BUFFER, 0));
+	fence_section(detail);
+	if (sprites) GL_COUNTED(stats, glDisable(GL_PROGRAM_POINT_SIZE));
+	GL_COUNTED(stats, shader.unbind());
+}
+
+void Scene::apply_navigation(const point3& position, const float rotation_y)
+{
+	glRotatef(-rotation_y  * 180.0f / pi_constant, 0.0f, 1.0f, 0.0f);
+	glTranslatef(position.x, position.y, position.z);
+}
+
+void Scene::begin_frame() const
+{
+	std::unique_lock<std::mutex> _(detail_mutex_);
+	auto it = details_.find(get_thread_id());
+	if (it == details_.end()) return;
+	gl_details_t& detail = it->second;
+	// Number of views is learned from the previous frame
+	detail.expected_views = detail.view_calls;
+	detail.view_calls = 0;
+	detail.views.clear();
+	++detail.frame;
+}
+
+bool Scene::multi_view_supported()
+{
+	return GLEW_ARB_viewport_array && GLEW_ARB_gpu_shader5;
+}
+
+void Scene::record_view(gl_details_t& detail, const point3& position, const float rotation_y) const
+{
+	render_stats_t& stats = detail.stats;
+	view_t view;
+	GLfloat projection[16];
+	GLfloat modelview[16];
+	GL_COUNTED(stats, glPushMatrix());
+	GL_COUNTED(stats, apply_navigation(position, rotation_y));
+	GL_COUNTED(stats, glGetFloatv(GL_MODELVIEW_MATRIX, modelview));
+	GL_COUNTED(stats, glPopMatrix());
+	GL_COUNTED(stats, glGetFloatv(GL_PROJECTION_MATRIX, projection));
+	multiply_matrices(projection, modelview, view.matrix);
+	GL_COUNTED(stats, glGetFloatv(GL_VIEWPORT, view.viewport));
+	GLint draw_buffer = GL_BACK;
+	GL_COUNTED(stats, glGetIntegerv(GL_DRAW_BUFFER, &draw_buffer));
+	view.draw_buffer = draw_buffer;
+	detail.views.push_back(view);
+}
+
+void Scene::render_views(gl_details_t& detail) const
+{
+	render_stats_t& stats = detail.stats;
+	++stats.frames;
+	if (detail.multi_view_shader.empty()) prepare_multi_view(detail);
+	const ShaderProgram& shader = detail.multi_view_shader.front();
+	const std::vector<view_t>& views = detail.views;
+
+	// glClear ignores viewports, but it would be limited by a scissor set up for the last view
+	const bool scissor = glIsEnabled(GL_SCISSOR_TEST);
+	GL_COUNTED(stats, glDisable(GL_SCISSOR_TEST));
+	GL_COUNTED(stats, glEnable(GL_BLEND));
+	GL_COUNTED(stats, glDisable(GL_DEPTH_TEST));
+	GL_COUNTED(stats, glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+	const size_t first = upload(detail);
+	GL_COUNTED(stats, shader.bind());
+	GL_COUNTED(stats, glBindVertexArray(detail.vba));
+
+	// Views are drawn in batches sharing the draw buffer (e.g. one per eye)
+	for (size_t begin = 0; begin < views.size();) {
+		size_t end = begin + 1;
+		while (end < views.size() && end - begin < max_views_per_draw &&
+				views[end].draw_buffer == views[begin].draw_buffer) ++end;
+		const GLsizei count = end - begin;
+		std::vector<GLfloat> matrices;
+		std::vector<GLfloat> viewports;
+		for (size_t i = begin; i < end; ++i) {
+			matrices.insert(matrices.end(), views[i].matrix, views[i].matrix + 16);
+			viewports.insert(viewports.end(), views[i].viewport, views[i].viewport + 4);
+		}
+		GL_COUNTED(stats, glDrawBuffer(views[begin].draw_buffer));
+		GL_COUNTED(stats, glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		GL_COUNTED(stats, glViewportArrayv(0, count, viewports.data()));
+		GL_COUNTED(stats, shader.set_uniform_int("view_count", count));
+		GL_COUNTED(stats, shader.set_uniform_matrix4("view_matrices", matrices.data(), count));
+		GL_COUNTED(stats, glDrawArrays(GL_POINTS, first, detail.uploaded_count));
+		++stats.draw_calls;
+		begin = end;
+	}
+
+	GL_COUNTED(stats, glBindVertexArray(0));
+	fence_section(detail);
+	GL_COUNTED(stats, shader.unbind());
+	// Restores state of the last view (glViewport resets all the viewports)
+	const view_t& last = views.back();
+	GL_COUNTED(stats, glDrawBuffer(last.draw_buffer));
+	GL_COUNTED(stats, glViewport(last.viewport[0], last.viewport[1], last.viewport[2], last.viewport[3]));
+	if (scissor) GL_COUNTED(stats, glEnable(GL_SCISSOR_TEST));
+}
+
+void Scene::prepare_multi_view(gl_details_t& detail) const
+{
+	// Shares the fragment stage with the geometry shader path
+	detail.multi_view_shader.push_back(make_program(detail.stages, multi_view_vertex_shader,
+			fragment_shader, multi_view_geometry_shader));
+	ShaderProgram& shader = detail.multi_view_shader.front();
+	shader.bind_attrib(index_vertices, "position");
+	shader.bind_attrib(index_speed, "speed");
+	shader.bind_frag_data(0, "color");
+	shader.link();
+	GL_CHECK_ERROR
+}
+
+void Scene::fence_section(gl_details_t& detail) const
+{
+	if (!detail.persistent) return;
+	render_stats_t& stats = detail.stats;
+	// The section may be rewritten only after GPU finished reading it
+	GLsync& fence = detail.fences[detail.section];
+	// The section may be drawn several times in a frame
+	if (fence) GL_COUNTED(stats, glDeleteSync(fence));
+	GL_COUNTED(stats, fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+size_t Scene::upload(gl_details_t& detail) const
+{
+	if (gpu_simulation_) return simulate(detail);
+	// With begin_frame() the particles are known to be the same for all views of a frame
+	if (detail.frame && detail.uploaded_frame == detail.frame &&
+			detail.format == config_.vertex_format) {
+		return detail.uploaded_first;
+	}
+	FlightRecorder::Span span(recorder_, "upload");
+	SamplingProfiler::Phase phase("upload");
+	const size_t uploaded = detail.stats.uploaded_bytes;
+	detail.uploaded_frame = detail.frame;
+	detail.uploaded_first = upload_buffer(detail);
+	detail.uploaded_count = get_particles().count;
+	span.set_value(detail.stats.uploaded_bytes - uploaded);
+	return detail.uploaded_first;
+}
+
+size_t Scene::upload_buffer(gl_details_t& detail) const
+{
+	render_stats_t& stats = detail.stats;
+	upload_strategy_t strategy = config_.upload;
+	if (strategy == upload_strategy_t::persistent && !GLEW_ARB_buffer_storage) {
+		strategy = upload_strategy_t::subdata;
+	}
+	if (detail.persistent != (strategy == upload_strategy_t::persistent) ||
+			detail.format != config_.vertex_format) {
+		// Switching from/to immutable storage or to other format requires new buffer
+		release_buffer(detail);
+	}
+	if (strategy == upload_strategy_t::persistent) {
+		return upload_persistent(detail);
+	}
+
+	const particle_range_t particles = get_particles();
+	const size_t count = particles.count;
+	const size_t vertex_bytes = vertex_size(detail.format);
+	GL_COUNTED(stats, glBindBuffer(GL_ARRAY_BUFFER, detail.fbo));
+	if (strategy == upload_strategy_t::orphan || count > detail.capacity) {
+		if (strategy == upload_strategy_t::subdata) {
+			// Grow geometrically, so the buffer gets reallocated only rarely
+			detail.capacity = std::max(count, 2 * detail.capacity);
+		} else {
+			detail.capacity = count;
+		}
+		GL_COUNTED(stats, glBufferData(GL_ARRAY_BUFFER, vertex_bytes*detail.capacity, nullptr, GL_STREAM_DRAW));
+	}
+	if (count) {
+		const void* data = particles.data;
+		if (detail.format != vertex_format_t::full) {
+			detail.staging.resize(vertex_bytes * count);
+			write_vertices(particles.data, count, detail.format, detail.staging.data());
+			data = detail.staging.data();
+		}
+		GL_COUNTED(stats, glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_bytes*count, data));
+		stats.uploaded_bytes += vertex_bytes*count;
+	}
+	GL_COUNTED(stats, glBindBuffer(GL_ARRAY_BUFFER, 0));
+	return 0;
+}
+
+size_t Scene::upload_persistent(gl_details_t& detail) const
+{
+	render_stats_t& stats = detail.stats;
+	const particle_range_t particles = get_particles();
+	const size_t count = particles.count;
+	const size_t vertex_bytes = vertex_size(detail.format);
+	if (count > detail.capacity || !detail.persistent) {
+		release_buffer(detail);
+		detail.capacity = std::max<size_t>(count * 2, 1024);
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		const GLsizeiptr size = vertex_bytes * detail.capacity * persistent_sections;
+		GL_COUNTED(stats, glBindBuffer(GL_ARRAY_BUFFER, detail.fbo));
+		GL_COUNTED(stats, glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags));
+		GL_COUNTED(stats, detail.mapped = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags)));
+		GL_COUNTED(stats, glBindBuffer(GL_ARRAY_BUFFER, 0));
+		GL_CHECK_ERROR
+		detail.persistent = true;
+		detail.section = 0;
+	} else {
+		detail.section = (detail.section + 1) % persistent_sections;
+	}
+	GLsync& fence = detail.fences[detail.section];
+	if (fence) {
+		GL_COUNTED(stats, glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED));
+		GL_COUNTED(stats, glDeleteSync(fence));
+		fence = 0;
+	}
+	const size_t first = detail.section * detail.capacity;
+	write_vertices(particles.data, count, detail.format, detail.mapped + first * vertex_bytes);
+	stats.uploaded_bytes += vertex_bytes * count;
+	return first;
 }
+
+void Scene::release_buffer(gl_details_t& detail) const
+{
+	for (auto& fence: detail.fences) {
+		if (fence) glDeleteSync(fence);
+		fence = 0;
+	}
+	if (detail.fbo) glDeleteBuffers(1, &detail.fbo);
+	// Immutable storage can't be resized, so we always start with a new buffer
+	glGenBuffers(1, &detail.fbo);
+	detail.source = detail.fbo;
+	// The new buffer may get the name of the deleted one
+	detail.pulling_buffer = 0;
+	detail.capacity = 0;
+	detail.persistent = false;
+	detail.mapped = nullptr;
+	detail.format = config_.vertex_format;
+	set_vertex_format(detail);
+}
+
+size_t Scene::simulate(gl_details_t& detail) const
+{
+	std::vector<std::shared_ptr<const gpu_step_t>> steps;
+	{
+		std::unique_lock<std::mutex> _(detail_mutex_);
+		if (detail.simulated < first_step_) {
+			throw std::runtime_error("Steps of the GPU simulation needed by a new context were discarded already");
+		}
+		steps.assign(steps_.begin() + (detail.simulated - first_step_), steps_.end());
+	}
+	if (!detail.simulation) {
+		if (!GpuSimulation::supported()) throw std::runtime_error("GPU simulation needs OpenGL 3.1");
+		detail.simulation.reset(new GpuSimulation());
+		GL_CHECK_ERROR
+	}
+	if (!steps.empty()) {
+		FlightRecorder::Span span(recorder_, "simulate", steps.size());
+		SamplingProfiler::Phase phase("simulate");
+		for (const auto& step: steps) {
+			detail.simulation->step(*step);
+			detail.stats.uploaded_bytes += step->spawned.size() * sizeof(Particle);
+		}
+		std::unique_lock<std::mutex> _(detail_mutex_);
+		detail.simulated += steps.size();
+	}
+	detail.uploaded_count = detail.simulation->size();
+	// The simulation swaps its buffers in every step
+	if (detail.source != detail.simulation->buffer()) {
+		detail.source = detail.simulation->buffer();
+		detail.format = vertex_format_t::full;
+		set_vertex_format(detail);
+	}
+	return 0;
+}
+
+render_stats_t Scene::get_render_stats() const
+{
+	return get_detail().stats;
+}
+
+void Scene::reset_render_stats() const
+{
+	get_detail().stats = render_stats_t();
+}
+
+bool Scene::cull(gl_details_t& detail, size_t first) const
+{
+	render_stats_t& stats = detail.stats;
+	const size_t count = detail.uploaded_count;
+	const size_t groups = (count + cull_group_size - 1) / cull_group_size;
+	if (!GLEW_VERSION_4_3 || !count || groups > max_cull_groups) return false;
+	FlightRecorder::Span _(recorder_, "cull", count);
+	if (detail.cull_programs.empty()) prepare_culling(detail);
+	if (count > detail.cull_capacity) {
+		detail.cull_capacity = std::max(count, 2 * detail.cull_capacity);
+		const size_t capacity_groups = (detail.cull_capacity + cull_group_size - 1) / cull_group_size;
+		GL_COUNTED(stats, glBindBuffer(GL_SHADER_STORAGE_BUFFER, detail.cull_indices));
+		GL_COUNTED(stats, glBufferData(GL_SHADER_STORAGE_BUFFER, detail.cull_capacity * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY));
+		GL_COUNTED(stats, glBindBuffer(GL_SHADER_STORAGE_BUFFER, detail.cull_groups));
+		GL_COUNTED(stats, glBufferData(GL_SHADER_STORAGE_BUFFER, capacity_groups * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY));
+		GL_COUNTED(stats, glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+	}
+
+	// Matrices of the current view (wall and eye), as set by CAVElib
+	GLfloat projection[16];
+	GLfloat modelview[16];
+	GL_COUNTED(stats, glGetFloatv(GL_PROJECTION_MATRIX, projection));
+	GL_COUNTED(stats, glGetFloatv(GL_MODELVIEW_MATRIX, modelview));
+
+	GL_COUNTED(stats, glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, detail.source));
+	GL_COUNTED(stats, glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, detail.cull_groups));
+	GL_COUNTED(stats, glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, detail.cull_indices));
+	GL_COUNTED(stats, glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, detail.cull_command));
+	for (size_t pass = 0; pass < detail.cull_programs.size(); ++pass) {
+		const ShaderProgram& program = detail.cull_programs[pass];
+		GL_COUNTED(stats, program.bind());
+		GL_COUNTED(stats, program.set_uniform_matrix4("projection", projection));
+		GL_COUNTED(stats, program.set_uniform_matrix4("modelview", modelview));
+		GL_COUNTED(stats, program.set_uniform_uint("first", first));
+		GL_COUNTED(stats, program.set_uniform_uint("vertex_count", count));
+		GL_COUNTED(stats, program.set_uniform_uint("stride", vertex_size(detail.format) / sizeof(float)));
+		GL_COUNTED(stats, program.set_uniform_uint("group_count", groups));
+		// The scan pass runs as a single work group
+		GL_COUNTED(stats, glDispatchCompute(pass == 1 ? 1 : groups, 1, 1));
+		GL_COUNTED(stats, glMemoryBarrier(pass + 1 < detail.cull_programs.size() ?
+				GL_SHADER_STORAGE_BARRIER_BIT : GL_ELEMENT_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT));
+	}
+	for (GLuint index = 0; index < 4; ++index) {
+		GL_COUNTED(stats, glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, 0));
+	}
+	return true;
+}
+
+void Scene::prepare_culling(gl_details_t& detail) const
+{
+	for (const std::string* text: {&cull_count_shader, &cull_scan_shader, &cull_compact_shader}) {
+		detail.cull_programs.emplace_back(GL_COMPUTE_SHADER, *text);
+	}
+	for (auto& program: detail.cull_programs) {
+		program.link();
+	}
+	glGenBuffers(1, &detail.cull_indices);
+	glGenBuffers(1, &detail.cull_groups);
+	glGenBuffers(1, &detail.cull_command);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, detail.cull_command);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, 5 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	GL_CHECK_ERROR
+	detail.cull_capacity = 0;
+}
+
+bool Scene::prepare_pulling(gl_details_t& detail, size_t first) const
+{
+	if (!GLEW_VERSION_3_1) return false;
+	if (detail.pulling_shaders.empty()) {
+		// Only the vertex stage differs, the rest is shared with the vertex array path
+		detail.pulling_shaders.push_back(make_program(detail.stages, pulling_vertex_shader,
+				fragment_shader, geometry_shader));
+		detail.pulling_shaders.push_back(make_program(detail.stages, pulling_sprite_vertex_shader,
+				sprite_fragment_shader));
+		for (auto& shader: detail.pulling_shaders) {
+			shader.bind_frag_data(0, "color");
+			shader.link();
+		}
+		glGenTextures(1, &detail.pulling_texture);
+		GLint max_texels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+		detail.max_pulled_floats = max_texels;
+		GL_CHECK_ERROR
+	}
+	const size_t floats = (first + detail.uploaded_count) * vertex_size(detail.format) / sizeof(float);
+	if (floats > detail.max_pulled_floats) return false;
+	// The buffer changes with reallocation, or in every step of the GPU simulation
+	if (detail.pulling_buffer != detail.source) {
+		render_stats_t& stats = detail.stats;
+		GL_COUNTED(stats, glBindTexture(GL_TEXTURE_BUFFER, detail.pulling_texture));
+		GL_COUNTED(stats, glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, detail.source));
+		GL_COUNTED(stats, glBindTexture(GL_TEXTURE_BUFFER, 0));
+		detail.pulling_buffer = detail.source;
+	}
+	return true;
+}
+
+void Scene::bind_pulling(gl_details_t& detail, const ShaderProgram& shader) const
+{
+	render_stats_t& stats = detail.stats;
+	GL_COUNTED(stats, glActiveTexture(GL_TEXTURE0));
+	GL_COUNTED(stats, glBindTexture(GL_TEXTURE_BUFFER, detail.pulling_texture));
+	GL_COUNTED(stats, shader.set_uniform_int("particles", 0));
+	const bool full = detail.format == vertex_format_t::full;
+	const GLint stride = float_offset(vertex_size(detail.format));
+	const GLint x = float_offset(full ? offsetof(Particle, position.x) : offsetof(compact_vertex_t, position.x));
+	const GLint speed = float_offset(full ? offsetof(Particle, direction.y) : offsetof(compact_vertex_t, speed));
+	GL_COUNTED(stats, shader.set_uniform_int2("layout_x", x, stride));
+	GL_COUNTED(stats, shader.set_uniform_int2("layout_y", x + 1, stride));
+	GL_COUNTED(stats, shader.set_uniform_int2("layout_z", x + 2, stride));
+	GL_COUNTED(stats, shader.set_uniform_int2("layout_speed", speed, stride));
+}
+
+size_t Scene::get_buffer_bytes() const
+{
+	const gl_details_t& detail = get_detail();
+	return detail.capacity * vertex_size(detail.format) * (detail.persistent ? persistent_sections : 1);
+}
+
 void Scene::reset()
 {
+	if (gpu_simulation_) push_step(population_.clear());
 	particles_.clear();
+	spawn_budget_ = 0.0;
+	publish();
 }
 
 void Scene::set_seed(unsigned int seed)
@@ -204,51 +1024,112 @@ void Scene::set_seed(unsigned int seed)
 	generator_.seed(seed);
 }
 
+void Scene::set_config(const scene_config_t& config)
+{
+	config_ = config;
+	kernel_ = select_kernel(config_.deterministic);
+	workers_.resize(config_.workers);
+}
+
 void Scene::prepare_details()
 {
-	const GLuint index_vertices = 0;
-	const GLuint index_directions = 1;
 	const std::string name_vertices = "position";
-	const std::string name_direction = "direction";
+	const std::string name_speed = "speed";
 
 
 	gl_details_t& detail = new_detail();
 
+	for (ShaderProgram* shader: {&detail.shader, &detail.sprite_shader}) {
+		shader->bind_attrib(index_vertices, name_vertices);
+		GL_CHECK_ERROR
+		shader->bind_attrib(index_speed, name_speed);
+		GL_CHECK_ERROR
+		shader->bind_frag_data(0, "color");
+		GL_CHECK_ERROR
+		shader->link();
+		GL_CHECK_ERROR
+	}
 
-	detail.shader.bind_attrib(index_vertices, name_vertices);
-	GL_CHECK_ERROR
-	detail.shader.bind_attrib(index_directions, name_direction);
-	GL_CHECK_ERROR
-	detail.shader.bind_frag_data(0, "color");
+	glGenVertexArrays(1, &detail.vba);
 	GL_CHECK_ERROR
-	detail.shader.link();
+	glGenBuffers(1, &detail.fbo);
 	GL_CHECK_ERROR
+	detail.source = detail.fbo;
+	set_vertex_format(detail);
+}
 
+void Scene::set_vertex_format(const gl_details_t& detail) const
+{
 	static_assert(sizeof(Particle) == 7*sizeof(float),"Wrong padding of Particle!");
 
-	glGenVertexArrays(1, &detail.vba);
-	GL_CHECK_ERROR
 	glBindVertexArray(detail.vba);
 	GL_CHECK_ERROR
 
-	glGenBuffers(1, &detail.fbo);
-
-	glBindBuffer(GL_ARRAY_BUFFER, detail.fbo);
+	glBindBuffer(GL_ARRAY_BUFFER, detail.source);
 	GL_CHECK_ERROR
-	glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
 
+	const GLsizei stride = vertex_size(detail.format);
+	const size_t speed_offset = detail.format == vertex_format_t::full ?
+			offsetof(Particle, direction.y) : offsetof(compact_vertex_t, speed);
 
 	glEnableVertexAttribArray(index_vertices);
 	GL_CHECK_ERROR
-	glVertexAttribPointer(index_vertices, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), 0);
+	glVertexAttribPointer(index_vertices, 3, GL_FLOAT, GL_FALSE, stride, 0);
 	GL_CHECK_ERROR
 
-	glEnableVertexAttribArray(index_directions);
+	glEnableVertexAttribArray(index_speed);
 	GL_CHECK_ERROR
-	glVertexAttribPointer(index_directions, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), reinterpret_cast<const void*>(3*sizeof(float)));
+	glVertexAttribPointer(index_speed, 1, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(speed_offset));
 	GL_CHECK_ERROR
 
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Scene::release_details()
+{
+	std::unique_lock<std::mutex> _(detail_mutex_);
+	auto it = details_.find(get_thread_id());
+	if (it == details_.end()) return;
+	gl_details_t& detail = it->second;
+	release_buffer(detail);
+	glDeleteBuffers(1, &detail.fbo);
+	glDeleteVertexArrays(1, &detail.vba);
+	detail.shader.release();
+	detail.sprite_shader.release();
+	for (auto& shader: detail.multi_view_shader) {
+		shader.release();
+	}
+	if (detail.simulation) detail.simulation->release();
+	for (auto& shader: detail.pulling_shaders) {
+		shader.release();
+	}
+	if (detail.pulling_texture) glDeleteTextures(1, &detail.pulling_texture);
+	if (!detail.cull_programs.empty()) {
+		for (auto& program: detail.cull_programs) {
+			program.release();
+		}
+		for (GLuint* buffer: {&detail.cull_indices, &detail.cull_groups, &detail.cull_command}) {
+			glDeleteBuffers(1, buffer);
+		}
+	}
+	details_.erase(it);
+}
+
+ShaderProgram Scene::make_program(stage_cache_t& stages, const std::string& vs,
+		const std::string& fs, const std::string& gs)
+{
+	if (!ShaderProgram::separable_supported()) return ShaderProgram(vs, fs, gs);
+	std::vector<std::shared_ptr<ShaderProgram>> pipeline;
+	const std::pair<GLenum, const std::string*> sources[] = {
+			{GL_VERTEX_SHADER, &vs}, {GL_GEOMETRY_SHADER, &gs}, {GL_FRAGMENT_SHADER, &fs}};
+	for (const auto& source: sources) {
+		if (source.second->empty()) continue;
+		std::shared_ptr<ShaderProgram>& stage = stages[*source.second];
+		if (!stage) stage = ShaderProgram::make_stage(source.first, *source.second);
+		pipeline.push_back(stage);
+	}
+	return ShaderProgram(pipeline);
 }
 
 Scene::gl_details_t& Scene::new_detail()
@@ -259,12 +1140,13 @@ Scene::gl_details_t& Scene::new_detail()
 		throw std::runtime_error("Attemt to initialize already initialized detail!");
 	}
 
-	auto res = details_.insert(std::make_pair(thread_id, gl_details_t(fragment_shader, vertex_shader, geometry_shader)));
+	auto res = details_.insert(std::make_pair(thread_id, gl_details_t(fragment_shader, vertex_shader, geometry_shader,
+			sprite_fragment_shader, sprite_vertex_shader)));
 	assert(res.second);
 	return res.first->second;
 }
 
-const Scene::gl_details_t& Scene::get_detail() const
+Scene::gl_details_t& Scene::get_detail() const
 {
 	std::unique_lock<std::mutex> _(detail_mutex_);
 	return details_.at(get_thread_id());
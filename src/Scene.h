@@ -12,12 +12,35 @@
 #define SCENE_H_
 #include "Particle.h"
 #include "Shader.h"
+#include "SceneConfig.h"
+#include "ParticleKernels.h"
+#include "WorkerPool.h"
+#include "FlightRecorder.h"
+#include "SamplingProfiler.h"
+#include "SharedArena.h"
+#include "GpuSimulation.h"
+#include "Behaviour.h"
+#include <atomic>
 #include <random>
 #include <vector>
+#include <deque>
 #include <map>
 #include <mutex>
+#include <memory>
 
 namespace CAVE {
+	//! Counters of work done in Scene::render
+	struct render_stats_t {
+		size_t frames			= 0;
+		/*!
+		 * Call sites of GL in the render path. A helper (navigation, shader bind, uniform)
+		 * counts as one, though it issues a few GL calls, so this is a lower bound.
+		 */
+		size_t gl_calls			= 0;
+		size_t draw_calls		= 0;
+		size_t uploaded_bytes	= 0;
+	};
+
 	class Scene {
 	public:
 		Scene(size_t particles_per_second);
@@ -27,28 +50,236 @@ namespace CAVE {
 		void reset();
 		void set_seed(unsigned int seed);
 		void prepare_details();
+		/*!
+		 * Deletes GL objects of the current thread.
+		 * Useful only for temporary scenes, the main scene lives as long as the contexts.
+		 */
+		void release_details();
+		void set_config(const scene_config_t& config);
+		const scene_config_t& get_config() const { return config_; }
+		//! Variant of the update loop selected for the current config
+		kernel_isa_t get_kernel() const { return kernel_; }
+		size_t get_particles_per_second() const { return particles_per_second_; }
+		void set_particles_per_second(size_t particles_per_second) { particles_per_second_ = particles_per_second; }
+		size_t get_particle_count() const { return gpu_simulation_ ? population_.size() : get_particles().count; }
+		//! Returns statistics of render() for the current thread
+		render_stats_t get_render_stats() const;
+		void reset_render_stats() const;
+		/*!
+		 * Starts a new frame in the current thread. Optional, but with it the particles
+		 * are uploaded only once per frame and the multi-viewport mode gets enabled.
+		 */
+		void begin_frame() const;
+		/*!
+		 * Moves the particles to @em arena and publishes them there after every update,
+		 * so scenes in processes forked later render what this one simulates.
+		 * Has to be called before the fork, with an empty scene.
+		 */
+		void set_shared_arena(SharedArena* arena);
+		/*!
+		 * Simulates the particles on the GPU (GpuSimulation), in every context separately.
+		 * update() then only spawns the particles and records the step, every context
+		 * replays the steps it missed before it renders. Has to be called before the first update.
+		 */
+		void set_gpu_simulation(bool enabled) { gpu_simulation_ = enabled; }
+		bool get_gpu_simulation() const { return gpu_simulation_; }
+		/*!
+		 * Updates the particles with @em behaviour instead of the update kernel (nullptr restores it).
+		 * Its native kernel is polled at the start of every update.
+		 */
+		void set_behaviour(std::shared_ptr<Behaviour> behaviour) { behaviour_ = behaviour; }
+		const std::shared_ptr<Behaviour>& get_behaviour() const { return behaviour_; }
+		//! Events of update and render are recorded to @em recorder (nullptr disables it)
+		void set_recorder(FlightRecorder* recorder) { recorder_ = recorder; }
+		//! Multiplies the modelview matrix by the navigation transform used in render()
+		static void apply_navigation(const point3& position, const float rotation_y);
+		//! Viewport arrays and geometry shader instancing are available
+		static bool multi_view_supported();
+		//! Size of the vertex buffer allocated by the current thread
+		size_t get_buffer_bytes() const;
 	private:
+		typedef std::vector<Particle, ArenaAllocator<Particle>> particle_vector_t;
+		//! Particles to render (those of the last published update)
+		struct particle_range_t {
+			const Particle* data;
+			size_t count;
+		};
+		/*!
+		 * Last update published in the shared arena.
+		 * The sequence is odd while an update is running (a seqlock), lock-free atomics
+		 * work across processes.
+		 */
+		struct shared_frame_t {
+			std::atomic<size_t> sequence;
+			size_t offset;
+			size_t count;
+		};
+
+		particle_range_t get_particles() const;
+		//! Publishes the particles to the other processes (end of the update)
+		void publish();
+		//! Queues a step of the GPU simulation for all the contexts
+		void push_step(gpu_step_t step);
+
 		size_t particles_per_second_;
-		std::vector<Particle> particles_;
+		//! Fractional part of particles to spawn, carried over to the next update
+		double spawn_budget_;
+		FlightRecorder* recorder_;
+		scene_config_t config_;
+		kernel_isa_t kernel_;
+		WorkerPool workers_;
+		particle_vector_t particles_;
+		SharedArena* arena_;
+		shared_frame_t* shared_;
 		std::mt19937 generator_;
 		std::uniform_real_distribution<float> distribution_position_;
 		std::uniform_real_distribution<float> distribution_direction_;
+		bool gpu_simulation_;
+		GpuPopulation population_;
+		/*!
+		 * Steps of the GPU simulation not applied by all the contexts yet,
+		 * first_step_ is the number of the front one (guarded by detail_mutex_).
+		 */
+		std::deque<std::shared_ptr<const gpu_step_t>> steps_;
+		size_t first_step_;
+		std::shared_ptr<Behaviour> behaviour_;
+
+		//! Number of sections in the persistently mapped buffer
+		static const size_t persistent_sections = 3;
+
+		//! View recorded for the multi-viewport rendering
+		struct view_t {
+			//! Projection and modelview matrix
+			GLfloat matrix[16];
+			GLfloat viewport[4];
+			GLenum draw_buffer;
+		};
+
+		//! Separable stage programs by their source, shared by the pipelines of a context
+		typedef std::map<std::string, std::shared_ptr<ShaderProgram>> stage_cache_t;
 
 		struct gl_details_t{
-			gl_details_t(const std::string& fs, const std::string& vs, const std::string& gs=std::string()):
-			shader(vs,fs,gs),vba(0),fbo(0) {	}
+			gl_details_t(const std::string& fs, const std::string& vs, const std::string& gs,
+					const std::string& sprite_fs, const std::string& sprite_vs):
+			stages(),shader(make_program(stages, vs, fs, gs)),sprite_shader(make_program(stages, sprite_vs, sprite_fs)),
+			vba(0),fbo(0),source(0),
+			capacity(0),format(vertex_format_t::full),persistent(false),mapped(nullptr),section(0),fences(),
+			cull_indices(0),cull_groups(0),cull_command(0),cull_capacity(0),
+			pulling_texture(0),pulling_buffer(0),max_pulled_floats(0),
+			frame(0),view_calls(0),expected_views(0),uploaded_frame(0),uploaded_first(0),uploaded_count(0),
+			simulated(0) {	}
 
+			//! Has to be initialized before the programs using it
+			stage_cache_t stages;
 			ShaderProgram shader;
+			ShaderProgram sprite_shader;
 			GLuint vba;
 			GLuint fbo;
+			//! Buffer read by vba (fbo, or the current buffer of the GPU simulation)
+			GLuint source;
+
+			//! Capacity of fbo (of one section for persistent buffer) in vertices
+			size_t capacity;
+			//! Format of the vertices in fbo
+			vertex_format_t format;
+			//! fbo was created with glBufferStorage
+			bool persistent;
+			char* mapped;
+			size_t section;
+			GLsync fences[persistent_sections];
+			//! Repacked vertices for formats other than vertex_format_t::full
+			std::vector<char> staging;
+
+			//! Compute programs of GPU culling, created on first use
+			std::vector<ShaderProgram> cull_programs;
+			//! Indices of the visible particles
+			GLuint cull_indices;
+			//! Visible particles per work group, then offsets of the groups
+			GLuint cull_groups;
+			//! Arguments of glDrawElementsIndirect
+			GLuint cull_command;
+			//! Capacity of cull_indices (in indices)
+			size_t cull_capacity;
+
+			//! Vertex pulling variants of shader and sprite_shader (empty until first use)
+			std::vector<ShaderProgram> pulling_shaders;
+			//! Buffer texture over pulling_buffer
+			GLuint pulling_texture;
+			GLuint pulling_buffer;
+			//! GL_MAX_TEXTURE_BUFFER_SIZE
+			size_t max_pulled_floats;
 
+			//! Program drawing all the views at once (empty until first use)
+			std::vector<ShaderProgram> multi_view_shader;
+			//! Frames started by begin_frame()
+			size_t frame;
+			//! Calls of render() in the current frame
+			size_t view_calls;
+			//! Calls of render() in the previous frame
+			size_t expected_views;
+			//! Views recorded in the current frame
+			std::vector<view_t> views;
+			//! Frame of the last upload and the first vertex of its data
+			size_t uploaded_frame;
+			size_t uploaded_first;
+			//! Number of particles in the buffer
+			size_t uploaded_count;
+			//! GPU simulation of the context, created on first use
+			std::unique_ptr<GpuSimulation> simulation;
+			//! Number of steps of the GPU simulation applied
+			size_t simulated;
+			render_stats_t stats;
 		};
-		std::map<int, gl_details_t> details_;
+		/*
+		 * Details are per-context caches, so they may change during render(),
+		 * which is otherwise const.
+		 */
+		mutable std::map<int, gl_details_t> details_;
 		mutable std::mutex detail_mutex_;
 
 
+		/*!
+		 * Program from the given stages, a pipeline of separable programs from @em stages
+		 * if they are supported (so every stage is compiled only once per context).
+		 */
+		static ShaderProgram make_program(stage_cache_t& stages, const std::string& vs,
+				const std::string& fs, const std::string& gs = std::string());
 		gl_details_t& new_detail();
-		const gl_details_t& get_detail() const;
+		gl_details_t& get_detail() const;
+		void set_vertex_format(const gl_details_t& detail) const;
+		/*!
+		 * Transfers particles to detail.fbo.
+		 * @return Index of the first particle in the buffer
+		 */
+		size_t upload(gl_details_t& detail) const;
+		size_t upload_buffer(gl_details_t& detail) const;
+		size_t upload_persistent(gl_details_t& detail) const;
+		//! Places a fence after the draws from the current persistent section
+		void fence_section(gl_details_t& detail) const;
+		void release_buffer(gl_details_t& detail) const;
+		/*!
+		 * Applies the pending steps of the GPU simulation and points vba to its buffer.
+		 * @return Index of the first particle in the buffer
+		 */
+		size_t simulate(gl_details_t& detail) const;
+		/*!
+		 * Culls the uploaded particles against the current view with compute shaders
+		 * and prepares the indirect draw.
+		 * @return false if GPU culling is not available (draw everything then)
+		 */
+		bool cull(gl_details_t& detail, size_t first) const;
+		void prepare_culling(gl_details_t& detail) const;
+		/*!
+		 * Creates the objects of vertex pulling on first use and attaches the uploaded buffer to the texture.
+		 * @return false if the particles can't be pulled (draw them from the vertex array then)
+		 */
+		bool prepare_pulling(gl_details_t& detail, size_t first) const;
+		//! Binds the buffer texture and describes the layout of the particles to @em shader
+		void bind_pulling(gl_details_t& detail, const ShaderProgram& shader) const;
+		void record_view(gl_details_t& detail, const point3& position, const float rotation_y) const;
+		//! Draws all recorded views with viewport arrays
+		void render_views(gl_details_t& detail) const;
+		void prepare_multi_view(gl_details_t& detail) const;
 	};
 
 
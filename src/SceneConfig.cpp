@@ -0,0 +1,121 @@
+/*!
+ * @file 		SceneConfig.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "SceneConfig.h"
+#include <sstream>
+#include <cstdlib>
+
+namespace CAVE {
+
+std::string to_string(upload_strategy_t upload)
+{
+	switch (upload) {
+	case upload_strategy_t::orphan: return "orphan";
+	case upload_strategy_t::subdata: return "subdata";
+	case upload_strategy_t::persistent: return "persistent";
+	}
+	return "unknown";
+}
+
+std::string to_string(render_backend_t backend)
+{
+	switch (backend) {
+	case render_backend_t::geometry_shader: return "geometry_shader";
+	case render_backend_t::point_sprite: return "point_sprite";
+	}
+	return "unknown";
+}
+
+std::string to_string(vertex_format_t format)
+{
+	switch (format) {
+	case vertex_format_t::full: return "full";
+	case vertex_format_t::compact: return "compact";
+	}
+	return "unknown";
+}
+
+bool from_string(const std::string& name, upload_strategy_t& upload)
+{
+	for (auto u: {upload_strategy_t::orphan, upload_strategy_t::subdata, upload_strategy_t::persistent}) {
+		if (name == to_string(u)) {
+			upload = u;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool from_string(const std::string& name, render_backend_t& backend)
+{
+	for (auto b: {render_backend_t::geometry_shader, render_backend_t::point_sprite}) {
+		if (name == to_string(b)) {
+			backend = b;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool from_string(const std::string& name, vertex_format_t& format)
+{
+	for (auto f: {vertex_format_t::full, vertex_format_t::compact}) {
+		if (name == to_string(f)) {
+			format = f;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string to_string(const scene_config_t& config)
+{
+	std::ostringstream os;
+	os << "workers=" << config.workers << " chunk_size=" << config.chunk_size
+			<< " upload=" << to_string(config.upload) << " backend=" << to_string(config.backend)
+			<< " vertex_format=" << to_string(config.vertex_format) << " gpu_culling=" << config.gpu_culling
+			<< " vertex_pulling=" << config.vertex_pulling
+			<< " multi_viewport=" << config.multi_viewport << " deterministic=" << config.deterministic;
+	return os.str();
+}
+
+namespace {
+bool parse_size(const std::string& text, size_t& value)
+{
+	char* end = nullptr;
+	const unsigned long parsed = std::strtoul(text.c_str(), &end, 10);
+	if (text.empty() || *end || !parsed) return false;
+	value = parsed;
+	return true;
+}
+
+bool parse_bool(const std::string& text, bool& value)
+{
+	if (text == "1" || text == "on" || text == "true") value = true;
+	else if (text == "0" || text == "off" || text == "false") value = false;
+	else return false;
+	return true;
+}
+}
+
+bool set_option(scene_config_t& config, const std::string& name, const std::string& value)
+{
+	if (name == "workers") return parse_size(value, config.workers);
+	if (name == "chunk_size") return parse_size(value, config.chunk_size);
+	if (name == "upload") return from_string(value, config.upload);
+	if (name == "backend") return from_string(value, config.backend);
+	if (name == "vertex_format") return from_string(value, config.vertex_format);
+	if (name == "gpu_culling") return parse_bool(value, config.gpu_culling);
+	if (name == "vertex_pulling") return parse_bool(value, config.vertex_pulling);
+	if (name == "multi_viewport") return parse_bool(value, config.multi_viewport);
+	if (name == "deterministic") return parse_bool(value, config.deterministic);
+	return false;
+}
+
+}
@@ -0,0 +1,97 @@
+/*!
+ * @file 		SceneConfig.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef SCENECONFIG_H_
+#define SCENECONFIG_H_
+#include <string>
+#include <cstddef>
+
+namespace CAVE {
+
+/*!
+ * Way the particle data are transferred to the GPU every frame
+ */
+enum class upload_strategy_t {
+	orphan,		//!< glBufferData(nullptr) followed by glBufferSubData
+	subdata,	//!< glBufferSubData into a buffer that only grows
+	persistent	//!< Persistently mapped ring buffer (needs ARB_buffer_storage)
+};
+
+/*!
+ * Way the particles are expanded to sprites
+ */
+enum class render_backend_t {
+	geometry_shader,	//!< Quads generated in the geometry shader
+	point_sprite		//!< Rasterized as GL points with gl_PointSize (approximates the quads, never chosen by the autotuner)
+};
+
+/*!
+ * Layout of the vertex buffer
+ */
+enum class vertex_format_t {
+	full,		//!< Particle as it is (28 B)
+	compact		//!< Position and vertical speed only (16 B), needs repacking
+};
+
+struct scene_config_t {
+	//! Number of threads used for Scene::update (including the calling one)
+	size_t workers				= 1;
+	//! Number of particles processed by a worker at once
+	size_t chunk_size			= 4096;
+	upload_strategy_t upload	= upload_strategy_t::orphan;
+	render_backend_t backend	= render_backend_t::geometry_shader;
+	vertex_format_t vertex_format = vertex_format_t::full;
+	//! Cull particles outside of the view in a compute pass (needs OpenGL 4.3)
+	bool gpu_culling			= false;
+	/*!
+	 * Fetch the particles in the vertex shader from a buffer texture by gl_VertexID
+	 * instead of the vertex array (needs OpenGL 3.1). Not used by multi_viewport.
+	 */
+	bool vertex_pulling			= false;
+	/*!
+	 * Draw all views of a context (walls sharing a GPU) at once with viewport arrays.
+	 * Always uses the geometry shader and no culling. Needs Scene::begin_frame().
+	 */
+	bool multi_viewport			= false;
+	/*!
+	 * Use only update kernels giving bit-identical results on all nodes.
+	 * Every CAVE instance simulates its own particles, so there the FMA kernels are opt-in.
+	 */
+#if defined(STRICT_DETERMINISM) || defined(CAVE_VERSION)
+	bool deterministic			= true;
+#else
+	bool deterministic			= false;
+#endif
+};
+
+std::string to_string(upload_strategy_t upload);
+std::string to_string(render_backend_t backend);
+std::string to_string(vertex_format_t format);
+/*!
+ * Parses name of the strategy.
+ * @return false if @em name is not a known strategy (@em upload is left untouched)
+ */
+bool from_string(const std::string& name, upload_strategy_t& upload);
+bool from_string(const std::string& name, render_backend_t& backend);
+bool from_string(const std::string& name, vertex_format_t& format);
+
+//! Describes all the options as name=value pairs (the names used by set_option())
+std::string to_string(const scene_config_t& config);
+/*!
+ * Sets option @em name (as in to_string()) from text.
+ * @return false if the name or the value is not valid (@em config is left untouched)
+ */
+bool set_option(scene_config_t& config, const std::string& name, const std::string& value);
+
+}
+
+
+
+#endif /* SCENECONFIG_H_ */
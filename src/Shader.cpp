@@ -12,7 +12,7 @@
 
 namespace CAVE {
 
-ShaderProgram::Shader::Shader(const std::string& text, GLenum type):shader(0)
+ShaderProgram::Shader::Shader(const std::string& text, GLenum type):shader(0),type(type)
 {
 	if (text.empty()) return;
 	shader = glCreateShader(type);
@@ -21,6 +21,11 @@ ShaderProgram::Shader::Shader(const std::string& text, GLenum type):shader(0)
 	glShaderSource(shader,1,reinterpret_cast<const GLchar**>(&source),&text_size);
 	//shader_text.resize(shader_size);
 	glCompileShader(shader);
+}
+
+bool ShaderProgram::Shader::compiled() const
+{
+	if (!shader) return true;
 	GLint compiled;
 	glGetObjectParameterivARB(shader, GL_COMPILE_STATUS, &compiled);
 	if (!compiled) {
@@ -33,33 +38,99 @@ ShaderProgram::Shader::Shader(const std::string& text, GLenum type):shader(0)
 		 glGetInfoLogARB(shader, blen, &slen, &compiler_log[0]);
 		 std::cerr << "compiler_log:" <<  compiler_log <<"\n";
 		}
-		throw std::runtime_error("Failed to compile shader");
+		return false;
 	}
+	return true;
 }
 
 ShaderProgram::ShaderProgram(const std::string& vertex_shader_text,
 							const std::string& fragment_shader_text,
-							const std::string& geometry_shader_text)
+							const std::string& geometry_shader_text):
+linked_(false),pipeline_(0)
+{
+	shaders_.emplace_back(vertex_shader_text, GL_VERTEX_SHADER);
+	shaders_.emplace_back(fragment_shader_text, GL_FRAGMENT_SHADER);
+	shaders_.emplace_back(geometry_shader_text, GL_GEOMETRY_SHADER);
+	program_ = glCreateProgram();
+	for (const auto& shader: shaders_) {
+		if (shader.shader) glAttachShader(program_, shader.shader);
+	}
+}
+
+ShaderProgram::ShaderProgram(GLenum type, const std::string& shader_text):
+linked_(false),pipeline_(0)
 {
-	Shader vertex_shader(vertex_shader_text, GL_VERTEX_SHADER);
-	Shader fragment_shader(fragment_shader_text, GL_FRAGMENT_SHADER);
-	Shader geometry_shader(geometry_shader_text, GL_GEOMETRY_SHADER);
+	shaders_.emplace_back(shader_text, type);
 	program_ = glCreateProgram();
-	if (vertex_shader.shader) glAttachShader(program_, vertex_shader.shader);
-	if (fragment_shader.shader) glAttachShader(program_, fragment_shader.shader);
-	if (geometry_shader.shader) glAttachShader(program_, geometry_shader.shader);
+	glAttachShader(program_, shaders_.back().shader);
+}
+
+ShaderProgram::ShaderProgram(const std::vector<std::shared_ptr<ShaderProgram>>& stages):
+program_(0),linked_(false),pipeline_(0),stages_(stages)
+{
+	glGenProgramPipelines(1, &pipeline_);
+}
+
+std::shared_ptr<ShaderProgram> ShaderProgram::make_stage(GLenum type, const std::string& shader_text)
+{
+	std::shared_ptr<ShaderProgram> stage = std::make_shared<ShaderProgram>(type, shader_text);
+	glProgramParameteri(stage->program_, GL_PROGRAM_SEPARABLE, GL_TRUE);
+	return stage;
+}
+
+bool ShaderProgram::separable_supported()
+{
+	return GLEW_ARB_separate_shader_objects;
 }
 
 void ShaderProgram::bind() const
 {
-	glUseProgram(program_);
+	if (pipeline_) {
+		// A program bound by glUseProgram would take precedence
+		glUseProgram(0);
+		glBindProgramPipeline(pipeline_);
+	} else {
+		glUseProgram(program_);
+	}
 }
 void ShaderProgram::unbind() const
 {
-	glUseProgram(0);
+	if (pipeline_) glBindProgramPipeline(0);
+	else glUseProgram(0);
+}
+void ShaderProgram::release()
+{
+	if (program_) glDeleteProgram(program_);
+	program_ = 0;
+	if (pipeline_) glDeleteProgramPipelines(1, &pipeline_);
+	pipeline_ = 0;
+	// Shared stages are released by the first pipeline, the rest does nothing
+	for (auto& stage: stages_) {
+		stage->release();
+	}
 }
 bool ShaderProgram::link()
 {
+	if (pipeline_) {
+		bool linked = true;
+		for (auto& stage: stages_) {
+			if (!stage->linked_) linked = stage->link() && linked;
+			GLbitfield bits = 0;
+			switch (stage->shaders_.front().type) {
+			case GL_VERTEX_SHADER: bits = GL_VERTEX_SHADER_BIT; break;
+			case GL_GEOMETRY_SHADER: bits = GL_GEOMETRY_SHADER_BIT; break;
+			case GL_FRAGMENT_SHADER: bits = GL_FRAGMENT_SHADER_BIT; break;
+			default: throw std::runtime_error("Unsupported stage of a program pipeline");
+			}
+			glUseProgramStages(pipeline_, bits, stage->program_);
+		}
+		return linked;
+	}
+	linked_ = true;
+	// Querying the status is the first point where we have to wait for the compiler
+	for (const auto& shader: shaders_) {
+		if (!shader.compiled()) throw std::runtime_error("Failed to compile shader");
+	}
 	glLinkProgram(program_);
 	GLint linked;
 	glGetProgramiv(program_, GL_LINK_STATUS, &linked);
@@ -80,11 +151,25 @@ bool ShaderProgram::link()
 
 void ShaderProgram::bind_attrib(GLuint index, const std::string& name)
 {
-	glBindAttribLocation(program_,index,name.c_str());
+	for (auto& stage: stages_) {
+		stage->bind_attrib(index, name);
+	}
+	if (program_) glBindAttribLocation(program_,index,name.c_str());
 }
 void ShaderProgram::bind_frag_data(GLuint index, const std::string& name)
 {
-	glBindFragDataLocation(program_, index, name.c_str());
+	for (auto& stage: stages_) {
+		stage->bind_frag_data(index, name);
+	}
+	if (program_) glBindFragDataLocation(program_, index, name.c_str());
+}
+void ShaderProgram::set_feedback_varyings(const std::vector<std::string>& names)
+{
+	std::vector<const GLchar*> varyings;
+	for (const auto& name: names) {
+		varyings.push_back(name.c_str());
+	}
+	glTransformFeedbackVaryings(program_, varyings.size(), varyings.data(), GL_INTERLEAVED_ATTRIBS);
 }
 
 namespace {
@@ -100,9 +185,52 @@ bool set_uniform_generic(const std::string& name, GLuint program, F execute) {
 }
 }
 
-bool ShaderProgram::set_uniform_matrix4(const std::string& name,const glm::mat4& matrix)
+template<class F>
+bool ShaderProgram::set_uniform(const std::string& name, F execute) const
+{
+	if (!pipeline_) return set_uniform_generic(name, program_, execute);
+	// glUniform* goes to the active program of the bound pipeline
+	bool found = false;
+	for (const auto& stage: stages_) {
+		glActiveShaderProgram(pipeline_, stage->program_);
+		found = stage->set_uniform(name, execute) || found;
+	}
+	return found;
+}
+
+bool ShaderProgram::set_uniform_matrix4(const std::string& name,const glm::mat4& matrix) const
+{
+	return set_uniform(name, [matrix](GLint loc){glUniformMatrix4fv(loc,1,GL_FALSE,&matrix[0][0]);});
+}
+
+bool ShaderProgram::set_uniform_matrix4(const std::string& name, const GLfloat* matrix, GLsizei count) const
+{
+	return set_uniform(name, [matrix, count](GLint loc){glUniformMatrix4fv(loc,count,GL_FALSE,matrix);});
+}
+
+bool ShaderProgram::set_uniform_float(const std::string& name, float value) const
+{
+	return set_uniform(name, [value](GLint loc){glUniform1f(loc,value);});
+}
+
+bool ShaderProgram::set_uniform_float3(const std::string& name, float x, float y, float z) const
+{
+	return set_uniform(name, [x, y, z](GLint loc){glUniform3f(loc,x,y,z);});
+}
+
+bool ShaderProgram::set_uniform_int(const std::string& name, GLint value) const
+{
+	return set_uniform(name, [value](GLint loc){glUniform1i(loc,value);});
+}
+
+bool ShaderProgram::set_uniform_int2(const std::string& name, GLint x, GLint y) const
+{
+	return set_uniform(name, [x, y](GLint loc){glUniform2i(loc,x,y);});
+}
+
+bool ShaderProgram::set_uniform_uint(const std::string& name, GLuint value) const
 {
-	return set_uniform_generic(name, program_, [matrix](GLint loc){glUniformMatrix4fv(loc,1,GL_FALSE,&matrix[0][0]);});
+	return set_uniform(name, [value](GLint loc){glUniform1ui(loc,value);});
 }
 
 }
@@ -13,26 +13,71 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <string>
+#include <vector>
+#include <memory>
 
 namespace CAVE {
 
 
+/*!
+ * Shaders are compiled in the constructor, but their status is checked
+ * only in link(). Drivers may then compile all the shaders in parallel.
+ *
+ * The program may also be a pipeline of separable single stage programs
+ * (ARB_separate_shader_objects). The stages may be shared by several pipelines,
+ * so every variant of a stage is compiled and linked only once, regardless
+ * of the number of combinations it is used in. The interface stays the same,
+ * uniforms are set in all the stages having them.
+ */
 class ShaderProgram {
 	struct Shader {
 		Shader(const std::string& text, GLenum type);
+		//! Checks compilation status, prints the log on failure
+		bool compiled() const;
 		GLuint shader;
+		GLenum type;
 	};
 public:
 	ShaderProgram(const std::string& vertex_shader_text, const std::string& fragment_shader_text, const std::string& geometry_shader_text = std::string());
+	//! Program with a single stage (e.g. GL_COMPUTE_SHADER)
+	ShaderProgram(GLenum type, const std::string& shader_text);
+	/*!
+	 * Pipeline of separable programs created by make_stage(). Attributes and fragment data
+	 * are bound in all the stages, link() links the stages not linked yet.
+	 */
+	ShaderProgram(const std::vector<std::shared_ptr<ShaderProgram>>& stages);
+	//! Separable single stage program for pipelines
+	static std::shared_ptr<ShaderProgram> make_stage(GLenum type, const std::string& shader_text);
+	//! Whether pipelines of separable programs are supported
+	static bool separable_supported();
 	bool link();
 	void bind_attrib(GLuint index, const std::string& name);
 	void bind_frag_data(GLuint index, const std::string& name);
+	//! Captures the outputs @em names of the vertex stage interleaved in one buffer (before link())
+	void set_feedback_varyings(const std::vector<std::string>& names);
 	void bind() const;
 	void unbind() const;
+	//! Deletes the program, the object can't be used afterwards
+	void release();
 
-	bool set_uniform_matrix4(const std::string& name,const glm::mat4& matrix);
+	bool set_uniform_matrix4(const std::string& name,const glm::mat4& matrix) const;
+	//! Sets @em count matrices given in column major order (as returned by glGetFloatv)
+	bool set_uniform_matrix4(const std::string& name, const GLfloat* matrix, GLsizei count = 1) const;
+	bool set_uniform_float(const std::string& name, float value) const;
+	bool set_uniform_float3(const std::string& name, float x, float y, float z) const;
+	bool set_uniform_int(const std::string& name, GLint value) const;
+	bool set_uniform_int2(const std::string& name, GLint x, GLint y) const;
+	bool set_uniform_uint(const std::string& name, GLuint value) const;
 private:
+	template<class F>
+	bool set_uniform(const std::string& name, F execute) const;
+
 	GLuint program_;
+	std::vector<Shader> shaders_;
+	bool linked_;
+	//! Program pipeline object (0 for ordinary programs)
+	GLuint pipeline_;
+	std::vector<std::shared_ptr<ShaderProgram>> stages_;
 
 };
 
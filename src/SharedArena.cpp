@@ -0,0 +1,161 @@
+/*!
+ * @file 		SharedArena.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		28.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "SharedArena.h"
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+namespace CAVE {
+
+namespace {
+//! Alignment of the blocks (and of the returned memory), a cache line
+const size_t alignment = 64;
+//! Free rest of a block smaller than this is not split off
+const size_t min_block = 4 * alignment;
+//! Offset meaning "no block" (the header is at 0)
+const size_t no_block = 0;
+
+size_t align(size_t size)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+}
+
+//! Placed at the start of the arena, shared by all processes
+struct SharedArena::header_t {
+	pthread_mutex_t mutex;
+	//! Offset of the first free block, the list is sorted by offsets
+	size_t free_list;
+	size_t used;
+};
+
+//! Precedes every block, the data follow after alignment bytes
+struct SharedArena::block_t {
+	//! Size including this header
+	size_t size;
+	//! Next free block (free blocks only)
+	size_t next;
+};
+
+SharedArena::SharedArena(size_t capacity):
+capacity_(align(capacity) + align(sizeof(header_t))),memory_(nullptr),header_(nullptr)
+{
+	void* memory = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (memory == MAP_FAILED) {
+		throw std::runtime_error(std::string("Failed to map shared arena: ") + std::strerror(errno));
+	}
+	memory_ = static_cast<char*>(memory);
+	header_ = new (memory_) header_t;
+	pthread_mutexattr_t attributes;
+	pthread_mutexattr_init(&attributes);
+	pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&header_->mutex, &attributes);
+	pthread_mutexattr_destroy(&attributes);
+
+	// Everything after the header is one free block
+	const size_t first = align(sizeof(header_t));
+	block_t* block = block_at(first);
+	block->size = capacity_ - first;
+	block->next = no_block;
+	header_->free_list = first;
+	header_->used = 0;
+}
+
+SharedArena::~SharedArena() noexcept
+{
+	pthread_mutex_destroy(&header_->mutex);
+	munmap(memory_, capacity_);
+}
+
+SharedArena::block_t* SharedArena::block_at(size_t offset) const
+{
+	return reinterpret_cast<block_t*>(memory_ + offset);
+}
+
+void* SharedArena::allocate(size_t bytes)
+{
+	static_assert(sizeof(block_t) <= alignment, "Block header has to fit into the alignment");
+	const size_t size = align(bytes) + alignment;
+	pthread_mutex_lock(&header_->mutex);
+	size_t* link = &header_->free_list;
+	while (*link != no_block && block_at(*link)->size < size) {
+		link = &block_at(*link)->next;
+	}
+	if (*link == no_block) {
+		pthread_mutex_unlock(&header_->mutex);
+		throw std::bad_alloc();
+	}
+	const size_t offset = *link;
+	block_t* block = block_at(offset);
+	if (block->size - size >= min_block) {
+		block_t* rest = block_at(offset + size);
+		rest->size = block->size - size;
+		rest->next = block->next;
+		block->size = size;
+		*link = offset + size;
+	} else {
+		*link = block->next;
+	}
+	header_->used += block->size;
+	pthread_mutex_unlock(&header_->mutex);
+	return memory_ + offset + alignment;
+}
+
+void SharedArena::deallocate(void* pointer) noexcept
+{
+	if (!pointer) return;
+	const size_t offset = offset_of(pointer) - alignment;
+	block_t* block = block_at(offset);
+	pthread_mutex_lock(&header_->mutex);
+	header_->used -= block->size;
+	size_t previous = no_block;
+	size_t next = header_->free_list;
+	while (next != no_block && next < offset) {
+		previous = next;
+		next = block_at(next)->next;
+	}
+	block->next = next;
+	if (next != no_block && offset + block->size == next) {
+		block->size += block_at(next)->size;
+		block->next = block_at(next)->next;
+	}
+	if (previous == no_block) {
+		header_->free_list = offset;
+	} else if (previous + block_at(previous)->size == offset) {
+		block_at(previous)->size += block->size;
+		block_at(previous)->next = block->next;
+	} else {
+		block_at(previous)->next = offset;
+	}
+	pthread_mutex_unlock(&header_->mutex);
+}
+
+size_t SharedArena::offset_of(const void* pointer) const
+{
+	return static_cast<const char*>(pointer) - memory_;
+}
+
+void* SharedArena::at(size_t offset) const
+{
+	return memory_ + offset;
+}
+
+size_t SharedArena::used() const
+{
+	pthread_mutex_lock(&header_->mutex);
+	const size_t used = header_->used;
+	pthread_mutex_unlock(&header_->mutex);
+	return used;
+}
+
+}
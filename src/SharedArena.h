@@ -0,0 +1,99 @@
+/*!
+ * @file 		SharedArena.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		28.4.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef SHAREDARENA_H_
+#define SHAREDARENA_H_
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace CAVE {
+
+/*!
+ * Memory shared by all processes forked after its creation.
+ *
+ * In the multi-process display mode of CAVElib, every display runs in its own
+ * process forked in CAVEInit. Data allocated here before (or after) the fork
+ * is visible to all of them at the same address, so the display processes can
+ * read what the master display process wrote without any copies.
+ *
+ * Allocation is first fit with coalescing, guarded by a process-shared mutex,
+ * so any of the processes may allocate and free. The pages are reserved
+ * lazily, unused capacity costs only address space.
+ */
+class SharedArena {
+public:
+	//! @param capacity Size of the arena in bytes (throws std::runtime_error if it can't be mapped)
+	SharedArena(size_t capacity);
+	~SharedArena() noexcept;
+	SharedArena(const SharedArena&) = delete;
+	SharedArena& operator=(const SharedArena&) = delete;
+
+	//! Throws std::bad_alloc when there is no free block large enough
+	void* allocate(size_t bytes);
+	void deallocate(void* pointer) noexcept;
+
+	//! Offset of @em pointer from the start of the arena (for data shared with processes mapping it elsewhere)
+	size_t offset_of(const void* pointer) const;
+	void* at(size_t offset) const;
+
+	size_t capacity() const { return capacity_; }
+	//! Bytes allocated (including the block headers)
+	size_t used() const;
+private:
+	struct header_t;
+	struct block_t;
+	block_t* block_at(size_t offset) const;
+
+	const size_t capacity_;
+	char* memory_;
+	header_t* header_;
+};
+
+/*!
+ * Allocator for standard containers placing their data into a SharedArena.
+ * Without an arena it uses the ordinary heap.
+ */
+template<typename T>
+struct ArenaAllocator {
+	typedef T value_type;
+	// The arena goes along with the data
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	ArenaAllocator(SharedArena* arena = nullptr) noexcept:arena(arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) noexcept:arena(other.arena) {}
+
+	T* allocate(size_t count)
+	{
+		const size_t bytes = count * sizeof(T);
+		return static_cast<T*>(arena ? arena->allocate(bytes) : ::operator new(bytes));
+	}
+	void deallocate(T* pointer, size_t) noexcept
+	{
+		if (arena) arena->deallocate(pointer);
+		else ::operator delete(pointer);
+	}
+
+	SharedArena* arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+}
+
+
+
+#endif /* SHAREDARENA_H_ */
@@ -0,0 +1,81 @@
+/*!
+ * @file 		StartupTimeline.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "StartupTimeline.h"
+#include <unistd.h>
+#include <algorithm>
+#include <iomanip>
+
+namespace CAVE {
+
+StartupTimeline::Span::Span(StartupTimeline& timeline, const std::string& name, int thread_id):
+timeline_(&timeline),name_(name),thread_id_(thread_id),start_(clock::now())
+{
+
+}
+
+StartupTimeline::Span::Span(Span&& other):
+timeline_(other.timeline_),name_(std::move(other.name_)),thread_id_(other.thread_id_),start_(other.start_)
+{
+	other.timeline_ = nullptr;
+}
+
+StartupTimeline::Span::~Span() noexcept
+{
+	if (timeline_) timeline_->record(name_, thread_id_, start_, clock::now());
+}
+
+StartupTimeline::StartupTimeline():
+launch_(clock::now())
+{
+
+}
+
+StartupTimeline::Span StartupTimeline::span(const std::string& name, int thread_id)
+{
+	return Span(*this, name, thread_id);
+}
+
+void StartupTimeline::mark(const std::string& name, int thread_id)
+{
+	const auto now = clock::now();
+	record(name, thread_id, now, now);
+}
+
+void StartupTimeline::record(const std::string& name, int thread_id, clock::time_point start, clock::time_point end)
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	steps_.push_back({name, thread_id,
+		std::chrono::duration<double>(start - launch_).count(),
+		std::chrono::duration<double>(end - launch_).count()});
+}
+
+void StartupTimeline::report(std::ostream& os) const
+{
+	std::vector<step_t> steps;
+	{
+		std::unique_lock<std::mutex> _(mutex_);
+		steps = steps_;
+	}
+	std::stable_sort(steps.begin(), steps.end(), [](const step_t& a, const step_t& b){return a.start < b.start;});
+	char host[256] = {0};
+	gethostname(host, sizeof(host) - 1);
+
+	os << "Startup timeline of " << host << " (ms since launch)\n" << std::fixed << std::setprecision(1);
+	double total = 0.0;
+	for (const auto& step: steps) {
+		os << "  " << std::setw(8) << step.start * 1000.0 << " " << std::setw(8) << (step.end - step.start) * 1000.0
+				<< "  " << (step.thread_id == main_thread ? std::string("main") : "thread " + std::to_string(step.thread_id))
+				<< "  " << step.name << "\n";
+		total = std::max(total, step.end);
+	}
+	os << "Launch to last recorded step: " << total * 1000.0 << " ms\n" << std::defaultfloat;
+}
+
+}
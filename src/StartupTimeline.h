@@ -0,0 +1,73 @@
+/*!
+ * @file 		StartupTimeline.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.3.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef STARTUPTIMELINE_H_
+#define STARTUPTIMELINE_H_
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+
+namespace CAVE {
+
+/*!
+ * Records durations of the startup steps on all threads of an instance.
+ *
+ * Times are relative to the construction of the timeline,
+ * which should happen as early as possible.
+ */
+class StartupTimeline {
+	typedef std::chrono::steady_clock clock;
+public:
+	//! Thread id used for steps done outside of CAVElib threads
+	static const int main_thread = -1;
+
+	/*!
+	 * Records the step from its construction to its destruction
+	 */
+	class Span {
+	public:
+		Span(StartupTimeline& timeline, const std::string& name, int thread_id);
+		Span(Span&& other);
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+		~Span() noexcept;
+	private:
+		StartupTimeline* timeline_;
+		std::string name_;
+		int thread_id_;
+		clock::time_point start_;
+	};
+
+	StartupTimeline();
+	Span span(const std::string& name, int thread_id = main_thread);
+	//! Records an instant event
+	void mark(const std::string& name, int thread_id = main_thread);
+	void report(std::ostream& os) const;
+private:
+	struct step_t {
+		std::string name;
+		int thread_id;
+		double start;
+		double end;
+	};
+	void record(const std::string& name, int thread_id, clock::time_point start, clock::time_point end);
+
+	const clock::time_point launch_;
+	mutable std::mutex mutex_;
+	std::vector<step_t> steps_;
+};
+
+}
+
+
+
+#endif /* STARTUPTIMELINE_H_ */
@@ -0,0 +1,151 @@
+/*!
+ * @file 		Statistics.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		17.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "Statistics.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+namespace CAVE {
+
+double percentile(std::vector<double> values, double p)
+{
+	if (values.empty()) return 0.0;
+	p = std::max(0.0, std::min(p, 100.0));
+	const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+	const size_t index = rank ? rank - 1 : 0;
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+summary_t summarize(const std::vector<double>& values)
+{
+	summary_t summary;
+	if (values.empty()) return summary;
+	summary.count = values.size();
+	summary.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+	summary.p50 = percentile(values, 50.0);
+	summary.p95 = percentile(values, 95.0);
+	summary.p99 = percentile(values, 99.0);
+	summary.max = *std::max_element(values.begin(), values.end());
+	return summary;
+}
+
+double mean(const std::vector<double>& values)
+{
+	if (values.empty()) return 0.0;
+	return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+double stddev(const std::vector<double>& values)
+{
+	if (values.size() < 2) return 0.0;
+	const double m = mean(values);
+	double sum = 0.0;
+	for (double v: values) {
+		sum += (v - m) * (v - m);
+	}
+	return std::sqrt(sum / (values.size() - 1));
+}
+
+namespace {
+/*!
+ * Quantile of standard normal distribution for p in [0.5, 1)
+ * (Abramowitz & Stegun 26.2.23, error below 4.5e-4)
+ */
+double normal_quantile(double p)
+{
+	const double t = std::sqrt(-2.0 * std::log(1.0 - p));
+	return t - (2.515517 + 0.802853 * t + 0.010328 * t * t) /
+			(1.0 + 1.432788 * t + 0.189269 * t * t + 0.001308 * t * t * t);
+}
+}
+
+double student_t_quantile(double p, double df)
+{
+	p = std::max(0.5, std::min(p, 0.999999));
+	const double z = normal_quantile(p);
+	if (df <= 0.0) return z;
+	// Cornish-Fisher expansion (Abramowitz & Stegun 26.7.5)
+	const double z2 = z * z;
+	const double z3 = z2 * z;
+	const double z5 = z3 * z2;
+	const double z7 = z5 * z2;
+	return z + (z3 + z) / (4.0 * df)
+			+ (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * df * df)
+			+ (3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * df * df * df);
+}
+
+double confidence_interval(const std::vector<double>& values, double confidence)
+{
+	if (values.size() < 2) return 0.0;
+	const double q = student_t_quantile(0.5 + confidence / 2.0, values.size() - 1);
+	return q * stddev(values) / std::sqrt(static_cast<double>(values.size()));
+}
+
+t_test_t welch_t_test(double mean_reference, double stddev_reference, size_t count_reference,
+		double mean_current, double stddev_current, size_t count_current, double confidence)
+{
+	t_test_t result;
+	if (!count_reference || !count_current) return result;
+	const double var_reference = stddev_reference * stddev_reference / count_reference;
+	const double var_current = stddev_current * stddev_current / count_current;
+	const double var = var_reference + var_current;
+	if (var <= 0.0) {
+		// No noise at all, any difference is significant
+		result.greater = mean_current > mean_reference;
+		result.less = mean_current < mean_reference;
+		return result;
+	}
+	result.t = (mean_current - mean_reference) / std::sqrt(var);
+	double denominator = 0.0;
+	if (count_reference > 1) denominator += var_reference * var_reference / (count_reference - 1);
+	if (count_current > 1) denominator += var_current * var_current / (count_current - 1);
+	result.df = denominator > 0.0 ? var * var / denominator : 0.0;
+	const double critical = student_t_quantile(confidence, result.df);
+	result.greater = result.t > critical;
+	result.less = result.t < -critical;
+	return result;
+}
+
+trend_t linear_trend(const std::vector<double>& xs, const std::vector<double>& ys, double confidence)
+{
+	trend_t trend;
+	const size_t n = std::min(xs.size(), ys.size());
+	if (n < 2) return trend;
+	const std::vector<double> x(xs.begin(), xs.begin() + n);
+	const std::vector<double> y(ys.begin(), ys.begin() + n);
+	const double mean_x = mean(x);
+	const double mean_y = mean(y);
+	double sxx = 0.0;
+	double sxy = 0.0;
+	for (size_t i = 0; i < n; ++i) {
+		sxx += (x[i] - mean_x) * (x[i] - mean_x);
+		sxy += (x[i] - mean_x) * (y[i] - mean_y);
+	}
+	if (sxx <= 0.0) return trend;
+	trend.slope = sxy / sxx;
+	trend.intercept = mean_y - trend.slope * mean_x;
+	if (n < 3) return trend;
+	double residuals = 0.0;
+	for (size_t i = 0; i < n; ++i) {
+		const double r = y[i] - trend.intercept - trend.slope * x[i];
+		residuals += r * r;
+	}
+	trend.slope_error = std::sqrt(residuals / (n - 2) / sxx);
+	if (trend.slope_error <= 0.0) {
+		// Perfect line, any growth is significant
+		trend.increasing = trend.slope > 0.0;
+	} else {
+		trend.increasing = trend.slope / trend.slope_error > student_t_quantile(confidence, n - 2);
+	}
+	return trend;
+}
+
+}
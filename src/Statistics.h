@@ -0,0 +1,91 @@
+/*!
+ * @file 		Statistics.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		17.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef STATISTICS_H_
+#define STATISTICS_H_
+#include <vector>
+#include <cstddef>
+
+namespace CAVE {
+
+//! Basic description of a set of samples
+struct summary_t {
+	size_t count	= 0;
+	double mean		= 0.0;
+	double p50		= 0.0;
+	double p95		= 0.0;
+	double p99		= 0.0;
+	double max		= 0.0;
+};
+
+/*!
+ * Returns @em p-th percentile (0 - 100) of @em values (nearest rank).
+ * Returns 0 for empty set.
+ */
+double percentile(std::vector<double> values, double p);
+
+summary_t summarize(const std::vector<double>& values);
+
+double mean(const std::vector<double>& values);
+//! Sample standard deviation (0 for less than two values)
+double stddev(const std::vector<double>& values);
+
+/*!
+ * Quantile of Student's t distribution.
+ * @param p  Probability (0.5 - 1)
+ * @param df Degrees of freedom
+ */
+double student_t_quantile(double p, double df);
+
+/*!
+ * Half width of the confidence interval of the mean of @em values
+ * @param confidence Confidence level (e.g. 0.95)
+ */
+double confidence_interval(const std::vector<double>& values, double confidence);
+
+//! Result of Welch's t-test comparing mean of @em current with @em reference
+struct t_test_t {
+	double t		= 0.0;
+	double df		= 0.0;
+	//! Current mean is significantly higher than the reference one
+	bool greater	= false;
+	//! Current mean is significantly lower than the reference one
+	bool less		= false;
+};
+
+/*!
+ * One-sided Welch's t-test on the means of two samples given by their descriptions.
+ * @param confidence Confidence level of the test (e.g. 0.99)
+ */
+t_test_t welch_t_test(double mean_reference, double stddev_reference, size_t count_reference,
+		double mean_current, double stddev_current, size_t count_current, double confidence);
+
+//! Least squares line through a series of samples
+struct trend_t {
+	double slope			= 0.0;
+	double intercept		= 0.0;
+	//! Standard error of the slope
+	double slope_error		= 0.0;
+	//! The slope is significantly positive
+	bool increasing			= false;
+};
+
+/*!
+ * Fits a line to samples @em ys taken at @em xs and tests whether it grows
+ * (one-sided t-test on the slope with n - 2 degrees of freedom).
+ * @param confidence Confidence level of the test (e.g. 0.99)
+ */
+trend_t linear_trend(const std::vector<double>& xs, const std::vector<double>& ys, double confidence);
+
+}
+
+
+
+#endif /* STATISTICS_H_ */
@@ -0,0 +1,148 @@
+/*!
+ * @file 		StressRamp.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		17.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "StressRamp.h"
+#include "Statistics.h"
+#include "Particle.h"
+#include <unistd.h>
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace CAVE {
+
+namespace {
+//! Window over which the population has to be stable
+const double stability_window = 1.0;
+//! Allowed relative change of the population within stability_window
+const double stability_tolerance = 0.02;
+//! Steps that don't stabilize in this time (in particle lifes) are measured anyway
+const double max_settle_lifes = 3.0;
+//! Duration of the measurement in every step (seconds)
+const double measure_time = 5.0;
+}
+
+StressRamp::StressRamp(size_t start_rate, size_t rate_step, double target_fps, double frame_percentile):
+start_rate_(start_rate),rate_step_(rate_step),target_fps_(target_fps),frame_percentile_(frame_percentile),
+rate_(start_rate),measuring_(false),finished_(false),step_start_(-1.0),measure_start_(0.0),
+recorded_rate_(start_rate),recorded_measuring_(false)
+{
+
+}
+
+void StressRamp::start_step(double time)
+{
+	step_start_ = time;
+	measuring_ = false;
+	history_.clear();
+}
+
+void StressRamp::control(double time, size_t population, size_t& rate, bool& measuring, bool& done)
+{
+	if (step_start_ < 0.0) start_step(time);
+	if (!finished_) {
+		history_.emplace_back(time, population);
+		while (history_.size() > 1 && history_.front().first < time - stability_window) {
+			history_.pop_front();
+		}
+		if (!measuring_) {
+			const double settled = time - step_start_;
+			const double change = std::abs(static_cast<double>(population) - history_.front().second);
+			const bool stable = settled >= Particle::default_life &&
+					change <= stability_tolerance * std::max<size_t>(population, 1);
+			if (stable || settled >= max_settle_lifes * Particle::default_life) {
+				measuring_ = true;
+				measure_start_ = time;
+			}
+		} else if (time - measure_start_ >= measure_time) {
+			bool passed = false;
+			{
+				std::unique_lock<std::mutex> _(mutex_);
+				passed = step_passed(steps_[rate_]);
+			}
+			if (passed) {
+				rate_ += rate_step_;
+				start_step(time);
+			} else {
+				finished_ = true;
+				measuring_ = false;
+			}
+		}
+	}
+	// After the ramp, the scene goes back to the original rate
+	rate = finished_ ? start_rate_ : rate_;
+	measuring = measuring_;
+	done = finished_;
+}
+
+void StressRamp::record_frame(size_t rate, bool measuring, double frame_time, size_t population)
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	recorded_rate_ = rate;
+	recorded_measuring_ = measuring;
+	if (!measuring) return;
+	step_t& step = steps_[rate];
+	step.frame_times.push_back(frame_time);
+	step.populations.push_back(population);
+}
+
+void StressRamp::record_render(int thread_id, double render_time)
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	if (!recorded_measuring_) return;
+	steps_[recorded_rate_].render_times[thread_id].push_back(render_time);
+}
+
+bool StressRamp::step_passed(const step_t& step) const
+{
+	return percentile(step.frame_times, frame_percentile_) <= 1.0 / target_fps_;
+}
+
+void StressRamp::report(std::ostream& os) const
+{
+	std::unique_lock<std::mutex> _(mutex_);
+	char host[256] = {0};
+	gethostname(host, sizeof(host) - 1);
+	size_t walls = 0;
+	for (const auto& step: steps_) {
+		walls = std::max(walls, step.second.render_times.size());
+	}
+
+	std::ostringstream label;
+	label << "p" << frame_percentile_;
+	os << "Stress ramp report for " << host << " (" << walls << " walls), target "
+			<< target_fps_ << " fps at " << label.str() << "\n";
+	os << std::fixed << std::setprecision(2);
+	double max_population = 0.0;
+	size_t max_rate = 0;
+	bool failed = false;
+	for (const auto& it: steps_) {
+		const step_t& step = it.second;
+		const summary_t frames = summarize(step.frame_times);
+		const summary_t population = summarize(step.populations);
+		const bool passed = step_passed(step);
+		os << "  rate " << std::setw(8) << it.first << "  population " << std::setw(10) << population.mean
+				<< "  frame p50/p95/" << label.str() << " " << frames.p50 * 1000.0 << "/" << frames.p95 * 1000.0
+				<< "/" << percentile(step.frame_times, frame_percentile_) * 1000.0 << " ms";
+		for (const auto& wall: step.render_times) {
+			os << "  wall " << wall.first << " render p99 " << percentile(wall.second, 99.0) * 1000.0 << " ms";
+		}
+		os << (passed ? "  ok" : "  MISSED") << "\n";
+		if (!passed) failed = true;
+		if (passed && !failed) {
+			max_population = population.mean;
+			max_rate = it.first;
+		}
+	}
+	os << "Maximum sustainable population on " << host << ": " << static_cast<size_t>(max_population)
+			<< " particles (" << max_rate << " particles/s)\n";
+}
+
+}
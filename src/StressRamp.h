@@ -0,0 +1,87 @@
+/*!
+ * @file 		StressRamp.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		17.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef STRESSRAMP_H_
+#define STRESSRAMP_H_
+#include <map>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <ostream>
+
+namespace CAVE {
+
+/*!
+ * Finds the maximal particle count the node can render at the target frame rate.
+ *
+ * The spawn rate is raised in steps. In every step, the system is left to reach
+ * steady state (the population stops changing), then the frame times are measured.
+ * The ramp stops at the first step where the chosen percentile of frame times
+ * misses the target.
+ *
+ * Only the master instance decides about the steps (control()), all instances
+ * record their own frame and render times, so every node reports its own limits.
+ */
+class StressRamp {
+public:
+	StressRamp(size_t start_rate, size_t rate_step, double target_fps, double frame_percentile);
+
+	/*!
+	 * Decides about the spawn rate for the next frame. Master instance only.
+	 * @param time       Current time in seconds
+	 * @param population Current number of particles
+	 * @param rate       [out] Spawn rate for the next frame
+	 * @param measuring  [out] Whether the next frame should be measured
+	 * @param done       [out] Whether the ramp is finished
+	 */
+	void control(double time, size_t population, size_t& rate, bool& measuring, bool& done);
+
+	/*!
+	 * Records duration of a frame simulated with spawn rate @em rate
+	 */
+	void record_frame(size_t rate, bool measuring, double frame_time, size_t population);
+	//! Records duration of Scene::render on a display thread (thread safe)
+	void record_render(int thread_id, double render_time);
+
+	void report(std::ostream& os) const;
+private:
+	struct step_t {
+		std::vector<double> frame_times;
+		std::vector<double> populations;
+		std::map<int, std::vector<double>> render_times;
+	};
+	void start_step(double time);
+	bool step_passed(const step_t& step) const;
+
+	const size_t start_rate_;
+	const size_t rate_step_;
+	const double target_fps_;
+	const double frame_percentile_;
+
+	// State of the controller (master only)
+	size_t rate_;
+	bool measuring_;
+	bool finished_;
+	double step_start_;
+	double measure_start_;
+	std::deque<std::pair<double, size_t>> history_;
+
+	// Recorded data (all nodes)
+	mutable std::mutex mutex_;
+	std::map<size_t, step_t> steps_;
+	size_t recorded_rate_;
+	bool recorded_measuring_;
+};
+
+}
+
+
+
+#endif /* STRESSRAMP_H_ */
@@ -0,0 +1,103 @@
+/*!
+ * @file 		WorkerPool.cpp
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace CAVE {
+
+WorkerPool::WorkerPool(size_t workers):
+quit_(false),generation_(0),busy_(0),job_(nullptr),count_(0),chunk_size_(1),next_chunk_(0)
+{
+	resize(workers);
+}
+
+WorkerPool::~WorkerPool() noexcept
+{
+	stop();
+}
+
+void WorkerPool::resize(size_t workers)
+{
+	workers = std::max<size_t>(workers, 1);
+	if (workers == size()) return;
+	stop();
+	quit_ = false;
+	const size_t generation = generation_;
+	for (size_t i = 1; i < workers; ++i) {
+		threads_.emplace_back([this, generation](){worker(generation);});
+	}
+}
+
+void WorkerPool::stop()
+{
+	{
+		std::unique_lock<std::mutex> _(mutex_);
+		quit_ = true;
+	}
+	start_cond_.notify_all();
+	for (auto& t: threads_) {
+		t.join();
+	}
+	threads_.clear();
+}
+
+void WorkerPool::parallel_for(size_t count, size_t chunk_size, const range_function_t& fun)
+{
+	if (!count) return;
+	chunk_size = std::max<size_t>(chunk_size, 1);
+	if (threads_.empty() || count <= chunk_size) {
+		// Nothing to distribute
+		fun(0, count);
+		return;
+	}
+	{
+		std::unique_lock<std::mutex> _(mutex_);
+		job_ = &fun;
+		count_ = count;
+		chunk_size_ = chunk_size;
+		next_chunk_ = 0;
+		busy_ = threads_.size();
+		++generation_;
+	}
+	start_cond_.notify_all();
+	process_chunks();
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_cond_.wait(lock, [this](){return busy_ == 0;});
+	job_ = nullptr;
+}
+
+void WorkerPool::process_chunks()
+{
+	const size_t chunks = (count_ + chunk_size_ - 1) / chunk_size_;
+	for (size_t chunk = next_chunk_++; chunk < chunks; chunk = next_chunk_++) {
+		const size_t begin = chunk * chunk_size_;
+		(*job_)(begin, std::min(begin + chunk_size_, count_));
+	}
+}
+
+void WorkerPool::worker(size_t seen_generation)
+{
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			start_cond_.wait(lock, [&](){return quit_ || generation_ != seen_generation;});
+			if (quit_) return;
+			seen_generation = generation_;
+		}
+		process_chunks();
+		{
+			std::unique_lock<std::mutex> _(mutex_);
+			--busy_;
+		}
+		done_cond_.notify_one();
+	}
+}
+
+}
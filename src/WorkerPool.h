@@ -0,0 +1,73 @@
+/*!
+ * @file 		WorkerPool.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		3.2.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace CAVE {
+
+/*!
+ * Small pool of persistent worker threads for data parallel loops.
+ *
+ * The calling thread always takes part in the work, so a pool of size 1
+ * runs everything inline and starts no threads at all.
+ */
+class WorkerPool {
+public:
+	typedef std::function<void(size_t, size_t)> range_function_t;
+
+	WorkerPool(size_t workers = 1);
+	~WorkerPool() noexcept;
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	/*!
+	 * Changes number of workers (including the calling thread).
+	 * Must not be called while parallel_for is running.
+	 */
+	void resize(size_t workers);
+	size_t size() const { return threads_.size() + 1; }
+
+	/*!
+	 * Splits range [0, count) into chunks of @em chunk_size elements
+	 * and calls @em fun(begin, end) for each of them.
+	 * Returns after all chunks were processed.
+	 */
+	void parallel_for(size_t count, size_t chunk_size, const range_function_t& fun);
+private:
+	void stop();
+	void worker(size_t seen_generation);
+	void process_chunks();
+
+	std::vector<std::thread> threads_;
+	std::mutex mutex_;
+	std::condition_variable start_cond_;
+	std::condition_variable done_cond_;
+	bool quit_;
+	size_t generation_;
+	size_t busy_;
+
+	const range_function_t* job_;
+	size_t count_;
+	size_t chunk_size_;
+	std::atomic<size_t> next_chunk_;
+};
+
+}
+
+
+
+#endif /* WORKERPOOL_H_ */
@@ -12,6 +12,7 @@
 #define GEOMETRY_H_
 #include <algorithm>
 #include <type_traits>
+#include <cmath>
 namespace CAVE {
 
 //! PI constant
@@ -60,6 +61,55 @@ inline color4 color_grad(const color4& start, const color4 end, float val)
 	};
 }
 
+//! Product of two column major 4x4 matrices (as used by OpenGL)
+inline void multiply_matrices(const float* a, const float* b, float* result)
+{
+	for (int column = 0; column < 4; ++column) {
+		for (int row = 0; row < 4; ++row) {
+			float sum = 0.0f;
+			for (int k = 0; k < 4; ++k) {
+				sum += a[k * 4 + row] * b[column * 4 + k];
+			}
+			result[column * 4 + row] = sum;
+		}
+	}
+}
+
+/*!
+ * Inverse of a 4x4 matrix (Gauss-Jordan elimination with partial pivoting)
+ * @return false if the matrix is singular
+ */
+inline bool invert_matrix(const float* matrix, float* result)
+{
+	double a[4][8];
+	for (int row = 0; row < 4; ++row) {
+		for (int column = 0; column < 4; ++column) {
+			a[row][column] = matrix[column * 4 + row];
+			a[row][column + 4] = row == column ? 1.0 : 0.0;
+		}
+	}
+	for (int column = 0; column < 4; ++column) {
+		int pivot = column;
+		for (int row = column + 1; row < 4; ++row) {
+			if (std::abs(a[row][column]) > std::abs(a[pivot][column])) pivot = row;
+		}
+		if (std::abs(a[pivot][column]) < 1e-12) return false;
+		for (int k = 0; k < 8; ++k) std::swap(a[column][k], a[pivot][k]);
+		const double scale = 1.0 / a[column][column];
+		for (int k = 0; k < 8; ++k) a[column][k] *= scale;
+		for (int row = 0; row < 4; ++row) {
+			if (row == column) continue;
+			const double factor = a[row][column];
+			for (int k = 0; k < 8; ++k) a[row][k] -= factor * a[column][k];
+		}
+	}
+	for (int row = 0; row < 4; ++row) {
+		for (int column = 0; column < 4; ++column) {
+			result[column * 4 + row] = static_cast<float>(a[row][column + 4]);
+		}
+	}
+	return true;
+}
 
 }
 
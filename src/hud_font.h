@@ -0,0 +1,132 @@
+/*!
+ * @file 		hud_font.h
+ * @author 		Zdenek Travnicek <travnicek@iim.cz>
+ * @date 		12.5.2014
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ * Bitmap font for the HUD, rasterized from DejaVu Sans Mono at 12 px
+ * (Bitstream Vera license, see https://dejavu-fonts.github.io/License.html).
+ */
+
+
+#ifndef HUD_FONT_H_
+#define HUD_FONT_H_
+
+namespace CAVE {
+namespace hud_font {
+
+//! Code of the first glyph
+const int first_char = 32;
+//! Printable ASCII and a solid block (used for the graphs and the background)
+const int glyph_count = 96;
+const int solid_glyph = glyph_count - 1;
+const int glyph_width = 8;
+const int glyph_height = 14;
+
+//! One byte per row from the top, the most significant bit is the leftmost pixel
+const unsigned char glyphs[glyph_count][glyph_height] = {
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, // space
+	{0x00,0x00,0x10,0x10,0x10,0x10,0x10,0x10,0x00,0x10,0x10,0x00,0x00,0x00}, // !
+	{0x00,0x00,0x28,0x28,0x28,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, // "
+	{0x00,0x00,0x00,0x14,0x14,0x7e,0x2c,0x28,0xfe,0x48,0x50,0x00,0x00,0x00}, // #
+	{0x00,0x00,0x10,0x38,0x74,0x50,0x30,0x1c,0x16,0x54,0x3c,0x10,0x10,0x00}, // $
+	{0x00,0x00,0x60,0x90,0x90,0x66,0x18,0x4c,0x12,0x12,0x0c,0x00,0x00,0x00}, // %
+	{0x00,0x00,0x38,0x60,0x60,0x20,0x70,0xda,0xce,0x44,0x7e,0x00,0x00,0x00}, // &
+	{0x00,0x00,0x10,0x10,0x10,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, // '
+	{0x00,0x08,0x18,0x10,0x10,0x30,0x30,0x30,0x10,0x10,0x18,0x08,0x00,0x00}, // (
+	{0x00,0x20,0x10,0x10,0x18,0x18,0x18,0x18,0x18,0x10,0x10,0x20,0x00,0x00}, // )
+	{0x00,0x00,0x10,0x54,0x38,0x38,0x54,0x10,0x00,0x00,0x00,0x00,0x00,0x00}, // *
+	{0x00,0x00,0x00,0x00,0x10,0x10,0x10,0xfe,0x10,0x10,0x10,0x00,0x00,0x00}, // +
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x18,0x10,0x30,0x00,0x00}, // ,
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x38,0x00,0x00,0x00,0x00,0x00,0x00}, // -
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x10,0x10,0x00,0x00,0x00}, // .
+	{0x00,0x00,0x04,0x0c,0x08,0x18,0x10,0x10,0x20,0x20,0x60,0x40,0x00,0x00}, // /
+	{0x00,0x00,0x38,0x6c,0x44,0x46,0x56,0x46,0x44,0x6c,0x38,0x00,0x00,0x00}, // 0
+	{0x00,0x00,0x78,0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x7e,0x00,0x00,0x00}, // 1
+	{0x00,0x00,0x38,0x4c,0x04,0x04,0x08,0x18,0x30,0x60,0x7c,0x00,0x00,0x00}, // 2
+	{0x00,0x00,0x38,0x4c,0x04,0x0c,0x38,0x04,0x04,0x44,0x78,0x00,0x00,0x00}, // 3
+	{0x00,0x00,0x0c,0x1c,0x3c,0x2c,0x6c,0x4c,0xfe,0x0c,0x0c,0x00,0x00,0x00}, // 4
+	{0x00,0x00,0x7c,0x40,0x40,0x78,0x0c,0x04,0x04,0x4c,0x78,0x00,0x00,0x00}, // 5
+	{0x00,0x00,0x38,0x64,0x40,0x78,0x64,0x44,0x44,0x64,0x38,0x00,0x00,0x00}, // 6
+	{0x00,0x00,0x7c,0x04,0x0c,0x08,0x08,0x18,0x10,0x30,0x20,0x00,0x00,0x00}, // 7
+	{0x00,0x00,0x38,0x64,0x44,0x64,0x38,0x44,0x46,0x64,0x3c,0x00,0x00,0x00}, // 8
+	{0x00,0x00,0x38,0x6c,0x44,0x44,0x6c,0x3c,0x04,0x4c,0x38,0x00,0x00,0x00}, // 9
+	{0x00,0x00,0x00,0x00,0x00,0x10,0x10,0x00,0x00,0x10,0x10,0x00,0x00,0x00}, // :
+	{0x00,0x00,0x00,0x00,0x00,0x10,0x10,0x00,0x00,0x18,0x10,0x30,0x00,0x00}, // ;
+	{0x00,0x00,0x00,0x00,0x06,0x1c,0x60,0x60,0x1c,0x06,0x00,0x00,0x00,0x00}, // <
+	{0x00,0x00,0x00,0x00,0x00,0x00,0xfe,0x00,0xfe,0x00,0x00,0x00,0x00,0x00}, // =
+	{0x00,0x00,0x00,0x00,0xc0,0x70,0x0e,0x0e,0x70,0xc0,0x00,0x00,0x00,0x00}, // >
+	{0x00,0x00,0x38,0x4c,0x04,0x08,0x10,0x10,0x00,0x10,0x10,0x00,0x00,0x00}, // ?
+	{0x00,0x00,0x00,0x3c,0x66,0x42,0x9e,0xb2,0xb2,0x9e,0x40,0x60,0x3c,0x00}, // @
+	{0x00,0x00,0x18,0x38,0x28,0x28,0x6c,0x64,0x7c,0x46,0xc2,0x00,0x00,0x00}, // A
+	{0x00,0x00,0x78,0x44,0x44,0x44,0x7c,0x44,0x46,0x46,0x7c,0x00,0x00,0x00}, // B
+	{0x00,0x00,0x3c,0x64,0x40,0x40,0x40,0x40,0x40,0x64,0x3c,0x00,0x00,0x00}, // C
+	{0x00,0x00,0x78,0x4c,0x44,0x46,0x46,0x46,0x44,0x4c,0x78,0x00,0x00,0x00}, // D
+	{0x00,0x00,0x7c,0x40,0x40,0x40,0x7c,0x40,0x40,0x40,0x7e,0x00,0x00,0x00}, // E
+	{0x00,0x00,0x7e,0x60,0x60,0x60,0x7c,0x60,0x60,0x60,0x60,0x00,0x00,0x00}, // F
+	{0x00,0x00,0x3c,0x64,0x40,0x40,0x4e,0x46,0x46,0x66,0x3c,0x00,0x00,0x00}, // G
+	{0x00,0x00,0x46,0x46,0x46,0x46,0x7e,0x46,0x46,0x46,0x46,0x00,0x00,0x00}, // H
+	{0x00,0x00,0x7c,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x7c,0x00,0x00,0x00}, // I
+	{0x00,0x00,0x3c,0x0c,0x0c,0x0c,0x0c,0x0c,0x0c,0x48,0x78,0x00,0x00,0x00}, // J
+	{0x00,0x00,0x46,0x4c,0x58,0x70,0x70,0x58,0x4c,0x44,0x46,0x00,0x00,0x00}, // K
+	{0x00,0x00,0x60,0x60,0x60,0x60,0x60,0x60,0x60,0x60,0x7e,0x00,0x00,0x00}, // L
+	{0x00,0x00,0xc6,0xe6,0xee,0xea,0xda,0xd2,0xc2,0xc2,0xc2,0x00,0x00,0x00}, // M
+	{0x00,0x00,0x66,0x66,0x66,0x56,0x56,0x5e,0x4e,0x4e,0x46,0x00,0x00,0x00}, // N
+	{0x00,0x00,0x38,0x6c,0x44,0x46,0x46,0x46,0x44,0x6c,0x38,0x00,0x00,0x00}, // O
+	{0x00,0x00,0x7c,0x46,0x46,0x46,0x7c,0x40,0x40,0x40,0x40,0x00,0x00,0x00}, // P
+	{0x00,0x00,0x38,0x6c,0x44,0x46,0x46,0x46,0x44,0x6c,0x38,0x0c,0x04,0x00}, // Q
+	{0x00,0x00,0x78,0x4c,0x44,0x4c,0x78,0x4c,0x44,0x46,0x42,0x00,0x00,0x00}, // R
+	{0x00,0x00,0x38,0x64,0x40,0x60,0x38,0x04,0x06,0x44,0x3c,0x00,0x00,0x00}, // S
+	{0x00,0x00,0xfe,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x00,0x00,0x00}, // T
+	{0x00,0x00,0x44,0x44,0x44,0x44,0x44,0x44,0x44,0x64,0x38,0x00,0x00,0x00}, // U
+	{0x00,0x00,0xc6,0x46,0x44,0x64,0x2c,0x28,0x28,0x38,0x18,0x00,0x00,0x00}, // V
+	{0x00,0x00,0x82,0x82,0xd2,0xda,0x7e,0x6e,0x6c,0x6c,0x64,0x00,0x00,0x00}, // W
+	{0x00,0x00,0x46,0x64,0x28,0x38,0x18,0x38,0x2c,0x44,0xc6,0x00,0x00,0x00}, // X
+	{0x00,0x00,0xc6,0x44,0x2c,0x38,0x18,0x10,0x10,0x10,0x10,0x00,0x00,0x00}, // Y
+	{0x00,0x00,0x7e,0x04,0x0c,0x08,0x18,0x30,0x20,0x60,0x7e,0x00,0x00,0x00}, // Z
+	{0x00,0x18,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x18,0x00,0x00}, // [
+	{0x00,0x00,0x40,0x60,0x20,0x20,0x10,0x10,0x18,0x08,0x0c,0x04,0x00,0x00}, // backslash
+	{0x00,0x38,0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x38,0x00,0x00}, // ]
+	{0x00,0x00,0x18,0x2c,0x44,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, // ^
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xfe}, // _
+	{0x00,0x20,0x10,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, // `
+	{0x00,0x00,0x00,0x00,0x78,0x04,0x04,0x3c,0x44,0x4c,0x7c,0x00,0x00,0x00}, // a
+	{0x00,0x40,0x40,0x40,0x78,0x64,0x46,0x46,0x46,0x64,0x78,0x00,0x00,0x00}, // b
+	{0x00,0x00,0x00,0x00,0x3c,0x20,0x60,0x40,0x60,0x20,0x3c,0x00,0x00,0x00}, // c
+	{0x00,0x04,0x04,0x04,0x3c,0x6c,0x44,0x44,0x44,0x6c,0x3c,0x00,0x00,0x00}, // d
+	{0x00,0x00,0x00,0x00,0x38,0x64,0x46,0x7e,0x40,0x64,0x3c,0x00,0x00,0x00}, // e
+	{0x00,0x1c,0x10,0x10,0x7c,0x10,0x10,0x10,0x10,0x10,0x10,0x00,0x00,0x00}, // f
+	{0x00,0x00,0x00,0x00,0x3c,0x6c,0x44,0x44,0x44,0x6c,0x3c,0x04,0x4c,0x38}, // g
+	{0x00,0x40,0x40,0x40,0x7c,0x64,0x44,0x44,0x44,0x44,0x44,0x00,0x00,0x00}, // h
+	{0x00,0x10,0x00,0x00,0x70,0x10,0x10,0x10,0x10,0x10,0x7e,0x00,0x00,0x00}, // i
+	{0x00,0x18,0x00,0x00,0x38,0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x70}, // j
+	{0x00,0x60,0x60,0x60,0x64,0x68,0x70,0x78,0x68,0x64,0x66,0x00,0x00,0x00}, // k
+	{0x00,0x70,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x1c,0x00,0x00,0x00}, // l
+	{0x00,0x00,0x00,0x00,0x7c,0x56,0x52,0x52,0x52,0x52,0x52,0x00,0x00,0x00}, // m
+	{0x00,0x00,0x00,0x00,0x7c,0x64,0x44,0x44,0x44,0x44,0x44,0x00,0x00,0x00}, // n
+	{0x00,0x00,0x00,0x00,0x38,0x64,0x44,0x44,0x44,0x64,0x38,0x00,0x00,0x00}, // o
+	{0x00,0x00,0x00,0x00,0x78,0x64,0x44,0x46,0x44,0x64,0x78,0x40,0x40,0x40}, // p
+	{0x00,0x00,0x00,0x00,0x3c,0x6c,0x44,0x44,0x44,0x6c,0x3c,0x04,0x04,0x04}, // q
+	{0x00,0x00,0x00,0x00,0x3e,0x30,0x20,0x20,0x20,0x20,0x20,0x00,0x00,0x00}, // r
+	{0x00,0x00,0x00,0x00,0x38,0x64,0x60,0x38,0x04,0x44,0x38,0x00,0x00,0x00}, // s
+	{0x00,0x00,0x30,0x30,0x7c,0x30,0x30,0x30,0x30,0x10,0x1c,0x00,0x00,0x00}, // t
+	{0x00,0x00,0x00,0x00,0x44,0x44,0x44,0x44,0x44,0x6c,0x3c,0x00,0x00,0x00}, // u
+	{0x00,0x00,0x00,0x00,0x46,0x44,0x64,0x2c,0x28,0x38,0x18,0x00,0x00,0x00}, // v
+	{0x00,0x00,0x00,0x00,0x82,0x82,0xd2,0x5e,0x6c,0x6c,0x6c,0x00,0x00,0x00}, // w
+	{0x00,0x00,0x00,0x00,0x44,0x2c,0x38,0x18,0x38,0x6c,0x46,0x00,0x00,0x00}, // x
+	{0x00,0x00,0x00,0x00,0x46,0x44,0x64,0x2c,0x28,0x38,0x18,0x10,0x30,0x60}, // y
+	{0x00,0x00,0x00,0x00,0x7c,0x0c,0x08,0x10,0x30,0x60,0x7c,0x00,0x00,0x00}, // z
+	{0x00,0x0c,0x18,0x10,0x10,0x10,0x70,0x10,0x10,0x10,0x18,0x0c,0x00,0x00}, // {
+	{0x00,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x00}, // |
+	{0x00,0x70,0x10,0x10,0x10,0x18,0x0c,0x18,0x10,0x10,0x10,0x70,0x00,0x00}, // }
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x72,0x1c,0x00,0x00,0x00,0x00,0x00,0x00}, // ~
+	{0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff}  // solid
+};
+
+}
+}
+
+
+
+#endif /* HUD_FONT_H_ */
@@ -26,6 +26,24 @@ inline int get_thread_id() {
 	return 0;
 #endif
 
+}
+
+//! Whether this is the one display thread of the instance doing per-instance work
+inline bool is_master_display() {
+#ifdef CAVE_VERSION
+	return CAVEMasterDisplay();
+#else
+	return true;
+#endif
+}
+
+//! Wall rendered in the current display callback (CAVElib wall id, 0 with GLUT)
+inline int get_wall_id() {
+#ifdef CAVE_VERSION
+	return static_cast<int>(*CAVEWall);
+#else
+	return 0;
+#endif
 }
 }
 